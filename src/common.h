@@ -20,6 +20,7 @@ typedef unsigned int uint;
 #endif
 
 #include "util/logger.h"
+#include "util/profiler.h"
 using namespace util;
 
 #include <glm/glm.hpp>
@@ -0,0 +1,184 @@
+#version 330
+#extension GL_ARB_compute_shader : require
+#extension GL_ARB_shader_storage_buffer_object : require
+#extension GL_ARB_shader_image_load_store : require
+
+#ifdef CULL
+// One invocation per instance of the frame.
+layout (local_size_x = 64) in;
+
+struct Instance {
+    mat4 model;
+    mat4 normalmatrix;
+};
+
+// Model space bounds of the mesh of one draw, GpuCuller::DrawBounds.
+struct DrawBounds {
+    vec3 center;
+    uint first_instance;
+    vec3 half_extents;
+    uint cullable;
+};
+
+layout (std430) readonly buffer instance_block {
+    Instance instances[];
+};
+layout (std430) readonly buffer draw_block {
+    DrawBounds draws[];
+};
+// Indirect draw commands of five uints, one per draw for the full meshes,
+// then one per draw for their position-only streams. Instance counts start
+// at zero and are counted up here.
+layout (std430) buffer command_block {
+    uint commands[];
+};
+// Instances that passed, at their draw's base instance onwards.
+layout (std430) writeonly buffer visible_block {
+    Instance visible[];
+};
+
+uniform uint num_instances;
+uniform uint num_draws;
+// World space planes as (nx, ny, nz, d), normals pointing inwards.
+uniform vec4 frustum_planes[6];
+
+// Farthest depth of last frame's scene, each level half the size of the
+// previous one, the first half the size of the depth buffer.
+uniform bool occlusion_culling;
+uniform sampler2D depth_pyramid;
+uniform int depth_pyramid_levels;
+uniform mat4 previous_viewprojection;
+// Pixels of the depth buffer last frame's scene was rendered to.
+uniform ivec2 previous_viewport;
+
+bool outsideFrustum(vec3 center, vec3 half_extents)
+{
+    for (int p = 0; p < 6; p++) {
+        float distance = dot(frustum_planes[p].xyz, center) + frustum_planes[p].w;
+        float radius = dot(abs(frustum_planes[p].xyz), half_extents);
+        if (distance + radius < 0.0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Whether the box was behind last frame's depth. Boxes that weren't wholly
+// on screen last frame are kept, there's no depth to test them against.
+bool occluded(vec3 center, vec3 half_extents)
+{
+    vec2 ndc_min = vec2(1.0);
+    vec2 ndc_max = vec2(-1.0);
+    float nearest = 1.0;
+    for (int corner = 0; corner < 8; corner++) {
+        vec3 signs = vec3((corner & 1) != 0 ? 1.0 : -1.0,
+                          (corner & 2) != 0 ? 1.0 : -1.0,
+                          (corner & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = previous_viewprojection *
+                    vec4(center + signs * half_extents, 1.0);
+        if (clip.w <= 0.0) { // Reaches behind the camera.
+            return false;
+        }
+        vec3 ndc = clip.xyz / clip.w;
+        ndc_min = min(ndc_min, ndc.xy);
+        ndc_max = max(ndc_max, ndc.xy);
+        nearest = min(nearest, ndc.z);
+    }
+    if (any(lessThan(ndc_min, vec2(-1.0))) || any(greaterThan(ndc_max, vec2(1.0)))) {
+        return false;
+    }
+
+    // Covered pixels of the depth buffer, then the first level where they
+    // fall into at most two by two texels.
+    vec2 viewport = vec2(previous_viewport);
+    ivec2 pixel_min = ivec2((ndc_min * 0.5 + 0.5) * viewport);
+    ivec2 pixel_max = min(ivec2((ndc_max * 0.5 + 0.5) * viewport),
+                          previous_viewport - 1);
+    int level = 0;
+    ivec2 texel_min = pixel_min >> 1;
+    ivec2 texel_max = pixel_max >> 1;
+    while (level < depth_pyramid_levels - 1 &&
+           any(greaterThan(texel_max - texel_min, ivec2(1)))) {
+        level++;
+        texel_min >>= 1;
+        texel_max >>= 1;
+    }
+    float farthest = max(
+        max(texelFetch(depth_pyramid, texel_min, level).r,
+            texelFetch(depth_pyramid, ivec2(texel_max.x, texel_min.y), level).r),
+        max(texelFetch(depth_pyramid, ivec2(texel_min.x, texel_max.y), level).r,
+            texelFetch(depth_pyramid, texel_max, level).r));
+    return nearest * 0.5 + 0.5 > farthest;
+}
+
+void main()
+{
+    uint instance = gl_GlobalInvocationID.x;
+    if (instance >= num_instances) {
+        return;
+    }
+
+    // The draw of the instance, the last one starting at or before it.
+    uint low = 0u;
+    uint high = num_draws - 1u;
+    while (low < high) {
+        uint middle = (low + high + 1u) / 2u;
+        if (draws[middle].first_instance <= instance) {
+            low = middle;
+        } else {
+            high = middle - 1u;
+        }
+    }
+    uint draw = low;
+
+    if (draws[draw].cullable != 0u) {
+        // Box transformed to world space like BoundingVolume::transform().
+        mat4 model = instances[instance].model;
+        vec3 center = (model * vec4(draws[draw].center, 1.0)).xyz;
+        vec3 extents = draws[draw].half_extents;
+        vec3 half_extents = abs(model[0].xyz) * extents.x +
+                            abs(model[1].xyz) * extents.y +
+                            abs(model[2].xyz) * extents.z;
+        if (outsideFrustum(center, half_extents)) {
+            return;
+        }
+        if (occlusion_culling && occluded(center, half_extents)) {
+            return;
+        }
+    }
+
+    // The second field of a command is its instance count.
+    uint slot = atomicAdd(commands[draw * 5u + 1u], 1u);
+    atomicAdd(commands[(num_draws + draw) * 5u + 1u], 1u);
+    visible[draws[draw].first_instance + slot] = instances[instance];
+}
+#endif // CULL
+
+#ifdef DEPTH_PYRAMID
+// One invocation per texel of the level written.
+layout (local_size_x = 8, local_size_y = 8) in;
+
+// The depth buffer, or the previous level of the pyramid.
+uniform sampler2D source;
+uniform int source_level;
+uniform ivec2 source_size;
+layout (r32f) uniform writeonly image2D destination;
+uniform ivec2 destination_size;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(texel, destination_size))) {
+        return;
+    }
+    // The last texel of an odd size covers the source's last one alone.
+    ivec2 first = texel * 2;
+    ivec2 last = min(first + 1, source_size - 1);
+    float farthest = max(
+        max(texelFetch(source, first, source_level).r,
+            texelFetch(source, ivec2(last.x, first.y), source_level).r),
+        max(texelFetch(source, ivec2(first.x, last.y), source_level).r,
+            texelFetch(source, last, source_level).r));
+    imageStore(destination, texel, vec4(farthest));
+}
+#endif // DEPTH_PYRAMID
@@ -0,0 +1,93 @@
+#include "boundingvolume.h"
+
+using namespace gamefw;
+
+BoundingVolume::BoundingVolume()
+:
+m_aabb_min(0.0f, 0.0f, 0.0f),
+m_aabb_max(0.0f, 0.0f, 0.0f),
+m_sphere_radius(0.0f)
+{
+}
+
+BoundingVolume::BoundingVolume(const float* positions,
+                               const size_t num_positions,
+                               const size_t stride)
+:
+m_aabb_min(0.0f, 0.0f, 0.0f),
+m_aabb_max(0.0f, 0.0f, 0.0f),
+m_sphere_radius(0.0f)
+{
+    if (num_positions == 0) {
+        return;
+    }
+
+    const char* bytes = (const char*) positions;
+
+    // First pass for the box.
+    m_aabb_min = glm::vec3(positions[0], positions[1], positions[2]);
+    m_aabb_max = m_aabb_min;
+    for (size_t i = 1; i < num_positions; i++) {
+        const float* p = (const float*) (bytes + i * stride);
+        glm::vec3 position(p[0], p[1], p[2]);
+        m_aabb_min = glm::min(m_aabb_min, position);
+        m_aabb_max = glm::max(m_aabb_max, position);
+    }
+
+    // Second pass for the sphere around the box center. Tighter than the
+    // half diagonal for round meshes.
+    glm::vec3 center = getCenter();
+    float max_distance_squared = 0.0f;
+    for (size_t i = 0; i < num_positions; i++) {
+        const float* p = (const float*) (bytes + i * stride);
+        glm::vec3 to_position = glm::vec3(p[0], p[1], p[2]) - center;
+        max_distance_squared = glm::max(max_distance_squared,
+                                        glm::dot(to_position, to_position));
+    }
+    m_sphere_radius = glm::sqrt(max_distance_squared);
+}
+
+void BoundingVolume::makeRotationInvariant()
+{
+    // Sphere around the origin enclosing the current sphere.
+    float radius = glm::length(getCenter()) + m_sphere_radius;
+    m_aabb_min = glm::vec3(-radius, -radius, -radius);
+    m_aabb_max = glm::vec3(radius, radius, radius);
+    m_sphere_radius = radius;
+}
+
+void BoundingVolume::scale(const float factor)
+{
+    m_aabb_min *= factor;
+    m_aabb_max *= factor;
+    m_sphere_radius *= factor;
+}
+
+float BoundingVolume::transform(const glm::mat4& model, glm::vec3& center,
+                                glm::vec3& half_extents) const
+{
+    center = glm::vec3(model * glm::vec4(getCenter(), 1.0f));
+
+    // Box extents transformed by the absolute rotation-scale part (Arvo).
+    glm::vec3 axis_x(model[0]), axis_y(model[1]), axis_z(model[2]);
+    glm::vec3 extents = getHalfExtents();
+    half_extents = glm::abs(axis_x) * extents.x +
+                   glm::abs(axis_y) * extents.y +
+                   glm::abs(axis_z) * extents.z;
+
+    // The sphere grows with the largest axis scale.
+    float max_scale = glm::max(glm::length(axis_x),
+                               glm::max(glm::length(axis_y),
+                                        glm::length(axis_z)));
+    return m_sphere_radius * max_scale;
+}
+
+glm::vec3 BoundingVolume::getCenter() const
+{
+    return (m_aabb_min + m_aabb_max) * 0.5f;
+}
+
+glm::vec3 BoundingVolume::getHalfExtents() const
+{
+    return (m_aabb_max - m_aabb_min) * 0.5f;
+}
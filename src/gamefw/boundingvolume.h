@@ -0,0 +1,75 @@
+#ifndef BOUNDINGVOLUME_H
+#define BOUNDINGVOLUME_H
+
+#include "../common.h"
+
+namespace gamefw {
+
+/**
+ * @brief Model space bounds of a mesh.
+ *
+ * Holds both an axis aligned bounding box and a bounding sphere. The sphere is
+ * centered on the box so that culling can test both volumes against the same
+ * transformed center.
+ **/
+class BoundingVolume
+{
+public:
+    /**
+     * @brief Creates an empty volume at the origin.
+     **/
+    BoundingVolume();
+
+    /**
+     * @brief Computes the bounds of a set of vertex positions.
+     *
+     * @param positions Pointer to the first position's x-coordinate.
+     * @param num_positions Number of positions.
+     * @param stride Distance in bytes between consecutive positions.
+     **/
+    BoundingVolume(const float* positions, const size_t num_positions,
+                   const size_t stride);
+
+    /**
+     * @brief Grows the volume to stay valid when the mesh is rotated around
+     * its origin, as done by the billboard shaders.
+     **/
+    void makeRotationInvariant();
+
+    /**
+     * @brief Scales the volume about the origin.
+     *
+     * @param factor Uniform scale factor.
+     **/
+    void scale(const float factor);
+
+    /**
+     * @brief Transforms the box to a world space axis aligned box.
+     *
+     * @param model Model transform.
+     * @param center Receives the world space center.
+     * @param half_extents Receives the world space half extents.
+     * @return The world space radius of the sphere.
+     **/
+    float transform(const glm::mat4& model, glm::vec3& center,
+                    glm::vec3& half_extents) const;
+
+    /// Returns the center of both the box and the sphere.
+    glm::vec3 getCenter() const;
+
+    /// Returns the half extents of the box.
+    glm::vec3 getHalfExtents() const;
+
+    /// Minimum corner of the axis aligned bounding box.
+    glm::vec3 m_aabb_min;
+
+    /// Maximum corner of the axis aligned bounding box.
+    glm::vec3 m_aabb_max;
+
+    /// Radius of the bounding sphere centered at getCenter().
+    float m_sphere_radius;
+};
+
+}
+
+#endif // BOUNDINGVOLUME_H
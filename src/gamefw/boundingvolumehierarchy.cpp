@@ -0,0 +1,305 @@
+#include "boundingvolumehierarchy.h"
+
+#include <cfloat>
+#include <algorithm>
+
+#include "renderjob.h"
+
+using namespace gamefw;
+
+/// Nodes with at most this many entities become leaves.
+const uint MAX_LEAF_SIZE = 4;
+/// Number of bins the centroids are sorted into when searching a split.
+const uint NUM_BINS = 16;
+
+const uint ALL_PLANES = (1 << Frustum::NUM_PLANES) - 1;
+
+/// Makes copies hold the render state of the entities in source, reusing them.
+static void copyEntities(const vector<shared_ptr<Entity> >& source,
+                         vector<shared_ptr<Entity> >& copies)
+{
+    while (copies.size() < source.size()) {
+        copies.push_back(shared_ptr<Entity>(new Entity));
+    }
+    copies.resize(source.size());
+    for (uint i = 0; i < source.size(); i++) {
+        copies[i]->copyRenderState(*source[i]);
+    }
+}
+
+static float surfaceArea(const glm::vec3& aabb_min, const glm::vec3& aabb_max)
+{
+    glm::vec3 d = aabb_max - aabb_min;
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy()
+{
+}
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy(
+    const vector<shared_ptr<Entity> >& entities)
+{
+    build(entities);
+}
+
+void BoundingVolumeHierarchy::build(const vector<shared_ptr<Entity> >& entities)
+{
+    m_nodes.clear();
+    m_entities.clear();
+    m_uncullable.clear();
+
+    foreach (shared_ptr<Entity> entity, entities) {
+        if (entity->getRenderJob()->m_cullable) {
+            m_entities.push_back(entity);
+        } else {
+            m_uncullable.push_back(entity);
+        }
+    }
+
+    m_aabb_min.resize(m_entities.size());
+    m_aabb_max.resize(m_entities.size());
+    for (uint i = 0; i < m_entities.size(); i++) {
+        updateEntityBox(i);
+    }
+
+    if (m_entities.empty()) {
+        return;
+    }
+
+    // A binary tree with n leaves at most has 2n - 1 nodes.
+    m_nodes.reserve(2 * m_entities.size() - 1);
+    m_nodes.push_back(Node());
+    buildNode(0, 0, m_entities.size());
+}
+
+void BoundingVolumeHierarchy::refit()
+{
+    for (uint i = 0; i < m_entities.size(); i++) {
+        updateEntityBox(i);
+    }
+
+    // Children always come after their parent, so refit in reverse.
+    for (int i = (int) m_nodes.size() - 1; i >= 0; i--) {
+        Node& node = m_nodes[i];
+        if (node.left == 0) {
+            fitNode(node);
+        } else {
+            const Node& left = m_nodes[node.left];
+            const Node& right = m_nodes[node.left + 1];
+            node.aabb_min = glm::min(left.aabb_min, right.aabb_min);
+            node.aabb_max = glm::max(left.aabb_max, right.aabb_max);
+        }
+    }
+}
+
+void BoundingVolumeHierarchy::copy(const BoundingVolumeHierarchy& other)
+{
+    m_nodes = other.m_nodes;
+    m_aabb_min = other.m_aabb_min;
+    m_aabb_max = other.m_aabb_max;
+    copyEntities(other.m_entities, m_entities);
+    copyEntities(other.m_uncullable, m_uncullable);
+}
+
+uint BoundingVolumeHierarchy::cull(const Frustum& frustum,
+                                   vector<shared_ptr<Entity> >& visible) const
+{
+    uint num_culled = 0;
+    visible.insert(visible.end(), m_uncullable.begin(), m_uncullable.end());
+    if (!m_nodes.empty()) {
+        cullNode(0, frustum, ALL_PLANES, visible, num_culled);
+    }
+    return num_culled;
+}
+
+uint BoundingVolumeHierarchy::size() const
+{
+    return m_entities.size() + m_uncullable.size();
+}
+
+uint BoundingVolumeHierarchy::getNumNodes() const
+{
+    return m_nodes.size();
+}
+
+void BoundingVolumeHierarchy::buildNode(const uint node_index, const uint first,
+                                        const uint count)
+{
+    {
+        Node& node = m_nodes[node_index];
+        node.first = first;
+        node.count = count;
+        node.left = 0;
+        fitNode(node);
+    }
+
+    // Larger nodes are always split to keep culling fine grained, the surface
+    // area heuristic only chooses where.
+    if (count <= MAX_LEAF_SIZE) {
+        return;
+    }
+
+    // Split along the axis where the centroids are most spread out.
+    glm::vec3 centroid_min(FLT_MAX, FLT_MAX, FLT_MAX);
+    glm::vec3 centroid_max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (uint i = first; i < first + count; i++) {
+        glm::vec3 centroid = (m_aabb_min[i] + m_aabb_max[i]) * 0.5f;
+        centroid_min = glm::min(centroid_min, centroid);
+        centroid_max = glm::max(centroid_max, centroid);
+    }
+    glm::vec3 centroid_extent = centroid_max - centroid_min;
+    int axis = 0;
+    if (centroid_extent.y > centroid_extent[axis]) axis = 1;
+    if (centroid_extent.z > centroid_extent[axis]) axis = 2;
+
+    uint split = first + count / 2; // Median split if binning fails.
+
+    if (centroid_extent[axis] > 0.0f) {
+        const float bin_scale = NUM_BINS / centroid_extent[axis] * 0.9999f;
+
+        // Sort boxes into bins.
+        uint bin_count[NUM_BINS];
+        glm::vec3 bin_min[NUM_BINS], bin_max[NUM_BINS];
+        for (uint b = 0; b < NUM_BINS; b++) {
+            bin_count[b] = 0;
+            bin_min[b] = glm::vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+            bin_max[b] = glm::vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        }
+        for (uint i = first; i < first + count; i++) {
+            float centroid = (m_aabb_min[i][axis] + m_aabb_max[i][axis]) * 0.5f;
+            uint b = (uint) ((centroid - centroid_min[axis]) * bin_scale);
+            bin_count[b]++;
+            bin_min[b] = glm::min(bin_min[b], m_aabb_min[i]);
+            bin_max[b] = glm::max(bin_max[b], m_aabb_max[i]);
+        }
+
+        // Sweep from the right to get the cost of each right hand side.
+        float right_cost[NUM_BINS];
+        glm::vec3 sweep_min(FLT_MAX, FLT_MAX, FLT_MAX);
+        glm::vec3 sweep_max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        uint sweep_count = 0;
+        for (uint b = NUM_BINS - 1; b > 0; b--) {
+            sweep_min = glm::min(sweep_min, bin_min[b]);
+            sweep_max = glm::max(sweep_max, bin_max[b]);
+            sweep_count += bin_count[b];
+            right_cost[b] = sweep_count == 0 ? 0.0f :
+                            surfaceArea(sweep_min, sweep_max) * sweep_count;
+        }
+
+        // Sweep from the left and pick the cheapest split plane.
+        float best_cost = FLT_MAX;
+        uint best_bin = 0, best_left_count = 0;
+        sweep_min = glm::vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+        sweep_max = glm::vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        sweep_count = 0;
+        for (uint b = 0; b < NUM_BINS - 1; b++) {
+            sweep_min = glm::min(sweep_min, bin_min[b]);
+            sweep_max = glm::max(sweep_max, bin_max[b]);
+            sweep_count += bin_count[b];
+            if (sweep_count == 0 || sweep_count == count) {
+                continue;
+            }
+            float cost = surfaceArea(sweep_min, sweep_max) * sweep_count +
+                         right_cost[b + 1];
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_bin = b;
+                best_left_count = sweep_count;
+            }
+        }
+
+        if (best_left_count > 0) {
+            // Partition the entities of bins <= best_bin to the left.
+            uint left_end = first;
+            for (uint i = first; i < first + count; i++) {
+                float centroid = (m_aabb_min[i][axis] + m_aabb_max[i][axis]) * 0.5f;
+                uint b = (uint) ((centroid - centroid_min[axis]) * bin_scale);
+                if (b <= best_bin) {
+                    std::swap(m_entities[i], m_entities[left_end]);
+                    std::swap(m_aabb_min[i], m_aabb_min[left_end]);
+                    std::swap(m_aabb_max[i], m_aabb_max[left_end]);
+                    left_end++;
+                }
+            }
+            split = left_end;
+        }
+    }
+
+    uint left = m_nodes.size();
+    m_nodes.push_back(Node());
+    m_nodes.push_back(Node());
+    m_nodes[node_index].left = left;
+    buildNode(left, first, split - first);
+    buildNode(left + 1, split, first + count - split);
+}
+
+void BoundingVolumeHierarchy::cullNode(const uint node_index,
+                                       const Frustum& frustum,
+                                       uint plane_mask,
+                                       vector<shared_ptr<Entity> >& visible,
+                                       uint& num_culled) const
+{
+    const Node& node = m_nodes[node_index];
+    glm::vec3 center = (node.aabb_min + node.aabb_max) * 0.5f;
+    glm::vec3 half_extents = (node.aabb_max - node.aabb_min) * 0.5f;
+
+    for (int p = 0; p < Frustum::NUM_PLANES; p++) {
+        if (!(plane_mask & (1 << p))) { // Parent already inside this plane.
+            continue;
+        }
+        const glm::vec4& plane = frustum.getPlane(p);
+        const glm::vec3 normal(plane);
+        float distance = glm::dot(normal, center) + plane.w;
+        float radius = glm::dot(glm::abs(normal), half_extents);
+        if (distance + radius < 0.0f) { // Completely outside.
+            num_culled += node.count;
+            return;
+        }
+        if (distance - radius >= 0.0f) { // Completely inside.
+            plane_mask &= ~(1 << p);
+        }
+    }
+
+    if (plane_mask == 0) { // Whole subtree inside the frustum.
+        visible.insert(visible.end(), m_entities.begin() + node.first,
+                       m_entities.begin() + node.first + node.count);
+        return;
+    }
+
+    if (node.left == 0) { // Leaf straddling a plane, test the entities.
+        for (uint i = node.first; i < node.first + node.count; i++) {
+            glm::vec3 entity_center = (m_aabb_min[i] + m_aabb_max[i]) * 0.5f;
+            glm::vec3 entity_extents = (m_aabb_max[i] - m_aabb_min[i]) * 0.5f;
+            if (frustum.intersects(entity_center, entity_extents)) {
+                visible.push_back(m_entities[i]);
+            } else {
+                num_culled++;
+            }
+        }
+        return;
+    }
+
+    cullNode(node.left, frustum, plane_mask, visible, num_culled);
+    cullNode(node.left + 1, frustum, plane_mask, visible, num_culled);
+}
+
+void BoundingVolumeHierarchy::updateEntityBox(const uint index)
+{
+    const Entity& entity = *m_entities[index];
+    glm::vec3 center, half_extents;
+    entity.getRenderJob()->m_bounds.transform(entity.getModelMatrix(),
+                                              center, half_extents);
+    m_aabb_min[index] = center - half_extents;
+    m_aabb_max[index] = center + half_extents;
+}
+
+void BoundingVolumeHierarchy::fitNode(Node& node) const
+{
+    node.aabb_min = glm::vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+    node.aabb_max = glm::vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (uint i = node.first; i < node.first + node.count; i++) {
+        node.aabb_min = glm::min(node.aabb_min, m_aabb_min[i]);
+        node.aabb_max = glm::max(node.aabb_max, m_aabb_max[i]);
+    }
+}
@@ -0,0 +1,109 @@
+#ifndef BOUNDINGVOLUMEHIERARCHY_H
+#define BOUNDINGVOLUMEHIERARCHY_H
+
+#include "../common.h"
+
+#include "entity.h"
+#include "frustum.h"
+
+namespace gamefw {
+
+/**
+ * @brief Tree of world space boxes over mostly static entities.
+ *
+ * Built with a binned surface area heuristic. Culling walks the tree against a
+ * frustum, so whole subtrees outside it are rejected with a single test and
+ * subtrees completely inside are accepted without testing their entities.
+ *
+ * The boxes are computed from each entity's RenderJob bounds and model matrix
+ * when built. If entities move, call refit() to update the boxes while keeping
+ * the topology, or build() again if they have moved far.
+ **/
+class BoundingVolumeHierarchy
+{
+public:
+    BoundingVolumeHierarchy();
+
+    /**
+     * @brief Builds the tree over the given entities.
+     *
+     * Entities whose RenderJob isn't cullable are kept aside and always
+     * reported as visible.
+     *
+     * @param entities ditto.
+     **/
+    explicit BoundingVolumeHierarchy(const vector<shared_ptr<Entity> >& entities);
+
+    /**
+     * @brief Rebuilds the tree over the given entities.
+     *
+     * @param entities ditto.
+     **/
+    void build(const vector<shared_ptr<Entity> >& entities);
+
+    /**
+     * @brief Recomputes every box from the entities' current transforms,
+     * keeping the tree topology.
+     **/
+    void refit();
+
+    /**
+     * @brief Replaces the tree with another's, over copies of its entities
+     * taken now, so the other tree's entities can move while this one is
+     * culled. The copies are reused from call to call.
+     *
+     * @param other ditto.
+     **/
+    void copy(const BoundingVolumeHierarchy& other);
+
+    /**
+     * @brief Collects the entities intersecting the frustum.
+     *
+     * @param frustum ditto.
+     * @param visible Visible entities are appended here.
+     * @return Number of entities culled.
+     **/
+    uint cull(const Frustum& frustum, vector<shared_ptr<Entity> >& visible) const;
+
+    /**
+     * @return Number of entities in the tree, including the uncullable ones.
+     **/
+    uint size() const;
+
+    /**
+     * @return Number of nodes in the tree.
+     **/
+    uint getNumNodes() const;
+
+private:
+    struct Node {
+        glm::vec3 aabb_min;
+        glm::vec3 aabb_max;
+        /// Start of the node's entities in m_entities.
+        uint first;
+        /// Number of entities in the subtree.
+        uint count;
+        /// Index of the left child, right is left + 1. 0 for leaves.
+        uint left;
+    };
+
+    void buildNode(const uint node_index, const uint first, const uint count);
+    void cullNode(const uint node_index, const Frustum& frustum,
+                  uint plane_mask, vector<shared_ptr<Entity> >& visible,
+                  uint& num_culled) const;
+    void updateEntityBox(const uint index);
+    void fitNode(Node& node) const;
+
+    vector<Node> m_nodes;
+
+    /// Entities ordered so every subtree is a contiguous range.
+    vector<shared_ptr<Entity> > m_entities;
+    vector<glm::vec3> m_aabb_min;
+    vector<glm::vec3> m_aabb_max;
+
+    vector<shared_ptr<Entity> > m_uncullable;
+};
+
+}
+
+#endif // BOUNDINGVOLUMEHIERARCHY_H
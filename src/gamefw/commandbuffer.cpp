@@ -0,0 +1,70 @@
+#include "commandbuffer.h"
+
+#include "renderjob.h"
+
+using namespace gamefw;
+
+CommandBuffer::CommandBuffer()
+{
+}
+
+void CommandBuffer::clear()
+{
+    m_commands.clear();
+}
+
+void CommandBuffer::record(const shared_ptr<Entity>* entities,
+                           const uint num_entities,
+                           const TransformStore& transforms,
+                           InstanceData* instances, const uint first_instance)
+{
+    bool program_bound = false;
+    GLuint current_program = 0;
+
+    uint i = 0;
+    while (i < num_entities) {
+        const RenderJob* renderjob = entities[i]->getRenderJob().get();
+
+        GLuint program = renderjob->getShaderProgramID();
+        if (!program_bound || program != current_program) {
+            push(Command::BIND_PROGRAM, renderjob);
+            program_bound = true;
+            current_program = program;
+        }
+        if (renderjob->m_num_textures > 0) {
+            push(Command::BIND_TEXTURES, renderjob);
+        }
+        push(Command::BIND_MESH, renderjob);
+
+        // Every following entity with the same RenderJob is an instance.
+        const uint group_begin = i;
+        for (; i < num_entities && entities[i]->getRenderJob().get() == renderjob;
+             i++) {
+            const glm::mat4& model = transforms.getModelMatrix(*entities[i]);
+            glm::mat4 normalmatrix = transforms.getNormalMatrix(*entities[i]);
+
+            InstanceData& instance = instances[i];
+            memcpy(instance.model, glm::value_ptr(model), sizeof(instance.model));
+            memcpy(instance.normalmatrix, glm::value_ptr(normalmatrix),
+                   sizeof(instance.normalmatrix));
+        }
+        push(Command::DRAW_INSTANCES, renderjob, first_instance + group_begin,
+             i - group_begin);
+    }
+}
+
+const vector<CommandBuffer::Command>& CommandBuffer::getCommands() const
+{
+    return m_commands;
+}
+
+void CommandBuffer::push(const Command::Type type, const RenderJob* renderjob,
+                         const uint first_instance, const uint num_instances)
+{
+    Command command;
+    command.type = type;
+    command.renderjob = renderjob;
+    command.first_instance = first_instance;
+    command.num_instances = num_instances;
+    m_commands.push_back(command);
+}
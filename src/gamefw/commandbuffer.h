@@ -0,0 +1,86 @@
+#ifndef COMMANDBUFFER_H
+#define COMMANDBUFFER_H
+
+#include "../common.h"
+
+#include "entity.h"
+#include "transformstore.h"
+
+namespace gamefw {
+
+class RenderJob;
+
+/**
+ * @brief List of rendering commands recorded away from the OpenGL thread.
+ *
+ * Commands are plain data referring to RenderJobs and to instance transforms,
+ * which are written to memory given by the caller, such as a mapped buffer.
+ * Recording only does the per entity math and state sorting, so several
+ * buffers can be recorded in parallel over slices of the visible entities and
+ * replayed in order by the Renderer.
+ **/
+class CommandBuffer
+{
+public:
+    /// Per instance attributes of one entity.
+    struct InstanceData {
+        float model[16];
+        float normalmatrix[16];
+    };
+
+    struct Command {
+        enum Type {
+            /// Use the RenderJob's shader program and set per frame uniforms.
+            BIND_PROGRAM,
+            /// Bind the RenderJob's textures to the current program.
+            BIND_TEXTURES,
+            /// Bind the RenderJob's vertex arrays and materials.
+            BIND_MESH,
+            /// Draw instances of the bound mesh.
+            DRAW_INSTANCES
+        };
+
+        Type type;
+        const RenderJob* renderjob;
+        /// Range of instances used by DRAW_INSTANCES.
+        uint first_instance;
+        uint num_instances;
+    };
+
+    CommandBuffer();
+
+    /**
+     * @brief Removes all commands.
+     **/
+    void clear();
+
+    /**
+     * @brief Records the commands drawing the given entities.
+     *
+     * Consecutive entities sharing a RenderJob become a single instanced draw
+     * and the program is only bound when it changes, so the entities should
+     * be sorted by RenderJob. Safe to call from any thread.
+     *
+     * @param entities First entity to draw.
+     * @param num_entities Number of entities.
+     * @param transforms Store holding the entities' up to date matrices.
+     * @param instances Receives the instance data of each entity. Only
+     *                  written to, so it may point to write combined memory.
+     * @param first_instance Index of instances[0] used in the commands.
+     **/
+    void record(const shared_ptr<Entity>* entities, const uint num_entities,
+                const TransformStore& transforms, InstanceData* instances,
+                const uint first_instance);
+
+    const vector<Command>& getCommands() const;
+
+private:
+    void push(const Command::Type type, const RenderJob* renderjob,
+              const uint first_instance = 0, const uint num_instances = 0);
+
+    vector<Command> m_commands;
+};
+
+}
+
+#endif // COMMANDBUFFER_H
@@ -0,0 +1,133 @@
+#include "camerapath.h"
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+
+CameraPath::CameraPath()
+{
+}
+
+void CameraPath::addKeyframe(const float time, const glm::vec3& position,
+                             const glm::vec3& orientation)
+{
+    Keyframe keyframe;
+    keyframe.time = time;
+    keyframe.position = position;
+    keyframe.orientation = orientation;
+    m_keyframes.push_back(keyframe);
+}
+
+bool CameraPath::load(const string& path)
+{
+    ifstream file(path.c_str());
+    if (!file) {
+        LOG(logERROR) << "Couldn't open camera path " << path << ".";
+        return false;
+    }
+
+    m_keyframes.clear();
+    string line;
+    while (getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        istringstream fields(line);
+        Keyframe keyframe;
+        fields >> keyframe.time
+               >> keyframe.position.x >> keyframe.position.y >> keyframe.position.z
+               >> keyframe.orientation.x >> keyframe.orientation.y
+               >> keyframe.orientation.z;
+        if (fields.fail()) {
+            LOG(logWARNING) << "Skipping malformed camera path line: " << line;
+            continue;
+        }
+        m_keyframes.push_back(keyframe);
+    }
+
+    if (m_keyframes.empty()) {
+        LOG(logERROR) << "Camera path " << path << " has no keyframes.";
+        return false;
+    }
+    return true;
+}
+
+bool CameraPath::save(const string& path) const
+{
+    ofstream file(path.c_str());
+    if (!file) {
+        LOG(logERROR) << "Couldn't write camera path " << path << ".";
+        return false;
+    }
+
+    file << "# time x y z yaw pitch roll\n";
+    foreach (const Keyframe& keyframe, m_keyframes) {
+        file << keyframe.time << " "
+             << keyframe.position.x << " " << keyframe.position.y << " "
+             << keyframe.position.z << " "
+             << keyframe.orientation.x << " " << keyframe.orientation.y << " "
+             << keyframe.orientation.z << "\n";
+    }
+    return file.good();
+}
+
+void CameraPath::sample(const float time, gamefw::Entity& camera) const
+{
+    if (m_keyframes.empty()) {
+        return;
+    }
+    if (time <= m_keyframes.front().time) {
+        camera.m_position = m_keyframes.front().position;
+        camera.m_orientation = m_keyframes.front().orientation;
+        return;
+    }
+    if (time >= m_keyframes.back().time) {
+        camera.m_position = m_keyframes.back().position;
+        camera.m_orientation = m_keyframes.back().orientation;
+        return;
+    }
+
+    // First keyframe after the time, the paths are short enough to scan.
+    uint next = 1;
+    while (m_keyframes[next].time <= time) {
+        next++;
+    }
+    const Keyframe& a = m_keyframes[next - 1];
+    const Keyframe& b = m_keyframes[next];
+    float t = (time - a.time) / (b.time - a.time);
+    camera.m_position = glm::mix(a.position, b.position, t);
+    camera.m_orientation = glm::mix(a.orientation, b.orientation, t);
+}
+
+float CameraPath::getDuration() const
+{
+    return m_keyframes.empty() ? 0.0f : m_keyframes.back().time;
+}
+
+uint CameraPath::getNumKeyframes() const
+{
+    return m_keyframes.size();
+}
+
+CameraPath CameraPath::makeOrbit(const glm::vec3& center, const float radius,
+                                 const float height, const float duration,
+                                 const uint num_keyframes)
+{
+    CameraPath path;
+    const uint num_steps = std::max(num_keyframes, 2u) - 1;
+    // Pitch looking down at the center, the same all around.
+    const float pitch = -glm::degrees(std::atan2(height, radius));
+    for (uint i = 0; i <= num_steps; i++) {
+        float fraction = (float) i / num_steps;
+        float angle = fraction * 360.0f;
+        glm::vec3 position = center +
+            glm::vec3(glm::sin(glm::radians(angle)) * radius, height,
+                      glm::cos(glm::radians(angle)) * radius);
+        // Yaw 0 looks down -z. Kept unwrapped so interpolation doesn't spin
+        // back at the seam.
+        path.addKeyframe(fraction * duration, position,
+                         glm::vec3(-angle, pitch, 0.0f));
+    }
+    return path;
+}
@@ -0,0 +1,83 @@
+#ifndef CAMERAPATH_H
+#define CAMERAPATH_H
+
+#include "../../common.h"
+#include "../entity.h"
+
+/**
+ * @brief Timed camera positions and orientations, for replaying the same
+ * view sequence in benchmarks.
+ *
+ * Saved as text, one keyframe per line: time in seconds, position x y z and
+ * orientation yaw pitch roll. Lines starting with # are comments.
+ **/
+class CameraPath
+{
+public:
+    CameraPath();
+
+    /**
+     * @brief Appends a keyframe. Times must not decrease.
+     *
+     * @param time Seconds from the start of the path.
+     * @param position ditto.
+     * @param orientation Yaw, pitch and roll like Entity::m_orientation.
+     **/
+    void addKeyframe(const float time, const glm::vec3& position,
+                     const glm::vec3& orientation);
+
+    /**
+     * @brief Replaces the keyframes with the ones in a file.
+     *
+     * @param path ditto.
+     * @return False if the file couldn't be read or has no keyframes.
+     **/
+    bool load(const string& path);
+
+    /**
+     * @param path ditto.
+     * @return False if the file couldn't be written.
+     **/
+    bool save(const string& path) const;
+
+    /**
+     * @brief Moves the camera to where the path is at the given time,
+     * interpolating between keyframes. Times outside the path clamp to its
+     * ends.
+     *
+     * @param time Seconds from the start of the path.
+     * @param camera ditto.
+     **/
+    void sample(const float time, gamefw::Entity& camera) const;
+
+    /**
+     * @return Time of the last keyframe.
+     **/
+    float getDuration() const;
+
+    uint getNumKeyframes() const;
+
+    /**
+     * @brief Makes a path circling a point while looking at it.
+     *
+     * @param center Point looked at.
+     * @param radius Horizontal distance from the center.
+     * @param height Height above the center.
+     * @param duration Seconds for a full circle.
+     * @param num_keyframes ditto.
+     **/
+    static CameraPath makeOrbit(const glm::vec3& center, const float radius,
+                                const float height, const float duration,
+                                const uint num_keyframes = 64);
+
+private:
+    struct Keyframe {
+        float time;
+        glm::vec3 position;
+        glm::vec3 orientation;
+    };
+
+    vector<Keyframe> m_keyframes;
+};
+
+#endif // CAMERAPATH_H
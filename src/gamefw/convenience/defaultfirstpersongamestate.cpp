@@ -4,7 +4,9 @@ DefaultFirstPersonGameState::DefaultFirstPersonGameState(gamefw::Game* parent,
                                                          shared_ptr<Entity> controllable)
 :
 m_parent(parent),
-m_controller(controllable)
+m_controller(controllable),
+m_controllable(controllable),
+m_recording(false)
 {
     sf::Window* main_window = m_parent->getMainWindow();
     const sf::Vector2u windowsize = main_window->getSize();
@@ -20,6 +22,22 @@ DefaultFirstPersonGameState::~DefaultFirstPersonGameState()
 void DefaultFirstPersonGameState::changeControlledEntity(shared_ptr< Entity > controllable)
 {
     m_controller = DefaultFirstPersonController(controllable);
+    m_controllable = controllable;
+}
+
+void DefaultFirstPersonGameState::toggleRecording()
+{
+    if (m_recording) {
+        if (m_recorded_path.save("camerapath.txt")) {
+            LOG(logINFO) << "Recorded " << m_recorded_path.getNumKeyframes()
+                         << " camera keyframes to camerapath.txt.";
+        }
+    } else {
+        LOG(logINFO) << "Recording camera path.";
+        m_recorded_path = CameraPath();
+        m_recording_clock.restart();
+    }
+    m_recording = !m_recording;
 }
 
 
@@ -36,6 +54,12 @@ UpdateStatus DefaultFirstPersonGameState::update()
                     LOG(logERROR) << "Reloading shaders.";
                     gamefw::Locator::getShaderFactory().reloadShaders();
                     break;
+                case (sf::Keyboard::P):
+                    m_parent->exportProfile("profile.json");
+                    break;
+                case (sf::Keyboard::K):
+                    toggleRecording();
+                    break;
                 case (sf::Keyboard::Escape):
                     return UPDATE_QUIT;
                 default:
@@ -58,5 +82,11 @@ UpdateStatus DefaultFirstPersonGameState::update()
         const sf::Vector2i mousepos = sf::Vector2i(m_window_middle_x, m_window_middle_y);
         sf::Mouse::setPosition(mousepos, *main_window);
     }
+
+    if (m_recording) {
+        m_recorded_path.addKeyframe(m_recording_clock.getElapsedTime().asSeconds(),
+                                    m_controllable->m_position,
+                                    m_controllable->m_orientation);
+    }
     return UPDATE_NORMAL;
 }
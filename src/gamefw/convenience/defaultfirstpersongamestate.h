@@ -3,6 +3,7 @@
 
 #include "../gamefw.h"
 #include "defaultfirstpersoncontroller.h"
+#include "camerapath.h"
 
 class DefaultFirstPersonGameState
 :
@@ -26,13 +27,24 @@ public:
      */
     virtual void changeControlledEntity(shared_ptr< Entity > controllable);
 
+    /**
+     * @brief Processes input and moves the controlled entity. K starts and
+     * stops recording its path to camerapath.txt for benchmarks.
+     **/
     UpdateStatus update();
 
 private:
+    void toggleRecording();
+
     gamefw::Game* m_parent;
     DefaultFirstPersonController m_controller;
     int m_window_middle_x;
     int m_window_middle_y;
+
+    shared_ptr<Entity> m_controllable;
+    bool m_recording;
+    CameraPath m_recorded_path;
+    sf::Clock m_recording_clock;
 };
 
 #endif // DEFAULTFIRSTPERSONGAMESTATE_H
@@ -21,6 +21,7 @@ void SimpleGameWorld::addEntities(const std::vector<shared_ptr<gamefw::Entity> >
 
 void SimpleGameWorld::update()
 {
+    PROFILE_ZONE("SimpleGameWorld::update");
     foreach(shared_ptr<gamefw::Entity> entity, *m_entity_list) {
         entity->m_position.x += entity->m_velocity_local.x *
                         glm::cos(glm::radians(entity->m_orientation.x)) -
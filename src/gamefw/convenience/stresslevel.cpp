@@ -0,0 +1,94 @@
+#include "stresslevel.h"
+
+#include <cmath>
+
+#include "../locator.h"
+#include "../fileservice.h"
+
+using namespace gamefw;
+
+/// Entities placed in turn, mixing materials and meshes.
+const char* const ENTITY_NAMES[] = {"sphere", "flatsmooth"};
+const uint NUM_ENTITY_NAMES = sizeof(ENTITY_NAMES) / sizeof(ENTITY_NAMES[0]);
+const char* const LIGHT_NAME = "lightball";
+/// Distance between grid cells.
+const float SPACING = 4.0f;
+
+/**
+ * @brief Small xorshift generator, so levels don't depend on the C library's
+ * rand().
+ **/
+class Random
+{
+public:
+    explicit Random(const uint seed)
+    :
+    m_state(seed * 2654435761u + 1u)
+    {
+    }
+
+    /// Uniform in [0, 1).
+    float next()
+    {
+        m_state ^= m_state << 13;
+        m_state ^= m_state >> 17;
+        m_state ^= m_state << 5;
+        return (m_state >> 8) / 16777216.0f;
+    }
+
+    float range(const float min, const float max)
+    {
+        return min + next() * (max - min);
+    }
+
+private:
+    uint m_state;
+};
+
+static shared_ptr<Entity> instantiate(map<string, shared_ptr<Entity> >& loaded,
+                                      const string& name)
+{
+    if (loaded.find(name) == loaded.end()) {
+        loaded[name] = Locator::getFileService().createEntity(name);
+    }
+    return loaded[name];
+}
+
+shared_ptr<LevelFile> generateStressLevel(const uint num_entities,
+                                          const uint num_lights,
+                                          const uint seed)
+{
+    Random random(seed);
+    shared_ptr<LevelFile> level(new LevelFile());
+
+    const uint side = (uint) std::ceil(std::sqrt((float) num_entities));
+    const float half_size = side * SPACING * 0.5f;
+
+    for (uint i = 0; i < num_entities; i++) {
+        const string name(ENTITY_NAMES[i % NUM_ENTITY_NAMES]);
+        shared_ptr<Entity> entity(new Entity(*instantiate(level->m_loaded_entities,
+                                                          name)));
+        entity->m_position = glm::vec3((i % side) * SPACING - half_size,
+                                       random.range(-1.0f, 1.0f),
+                                       (i / side) * SPACING - half_size);
+        entity->m_orientation = glm::vec3(random.range(0.0f, 360.0f), 0.0f, 0.0f);
+        level->m_entities.push_back(entity);
+    }
+
+    for (uint i = 0; i < num_lights; i++) {
+        shared_ptr<PointLight> light(new PointLight(
+            *instantiate(level->m_loaded_entities, LIGHT_NAME)));
+        light->m_position = glm::vec3(random.range(-half_size, half_size),
+                                      random.range(2.0f, 6.0f),
+                                      random.range(-half_size, half_size));
+        light->m_color = glm::vec3(random.range(0.2f, 1.0f),
+                                   random.range(0.2f, 1.0f),
+                                   random.range(0.2f, 1.0f));
+        light->m_intensity = random.range(1.0f, 4.0f);
+        light->m_radius = random.range(SPACING, 3.0f * SPACING);
+        level->m_pointlights.push_back(light);
+    }
+
+    level->buildEntityHierarchy();
+    return level;
+}
@@ -0,0 +1,24 @@
+#ifndef STRESSLEVEL_H
+#define STRESSLEVEL_H
+
+#include "../../common.h"
+#include "../levelfile.h"
+
+/**
+ * @brief Generates a level of the given size, for measuring how the renderer
+ * scales with the scene.
+ *
+ * Entities are spread over a square grid with some jitter in height and
+ * orientation, lights float above them. The same arguments always give the
+ * same level.
+ *
+ * @param num_entities ditto.
+ * @param num_lights ditto.
+ * @param seed Varies the layout.
+ * @return Level with its entity hierarchy built.
+ **/
+shared_ptr<gamefw::LevelFile> generateStressLevel(const uint num_entities,
+                                                  const uint num_lights,
+                                                  const uint seed = 1);
+
+#endif // STRESSLEVEL_H
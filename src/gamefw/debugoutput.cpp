@@ -0,0 +1,109 @@
+#include "debugoutput.h"
+
+#include <algorithm>
+
+using namespace gamefw;
+
+static bool g_enabled = false;
+static GLint g_max_label_length = 0;
+
+static const char* sourceName(const GLenum source)
+{
+    switch (source) {
+    case GL_DEBUG_SOURCE_API:
+        return "API";
+    case GL_DEBUG_SOURCE_WINDOW_SYSTEM:
+        return "window system";
+    case GL_DEBUG_SOURCE_SHADER_COMPILER:
+        return "shader compiler";
+    case GL_DEBUG_SOURCE_THIRD_PARTY:
+        return "third party";
+    case GL_DEBUG_SOURCE_APPLICATION:
+        return "application";
+    default:
+        return "other";
+    }
+}
+
+static const char* typeName(const GLenum type)
+{
+    switch (type) {
+    case GL_DEBUG_TYPE_ERROR:
+        return "error";
+    case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR:
+        return "deprecated behavior";
+    case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:
+        return "undefined behavior";
+    case GL_DEBUG_TYPE_PORTABILITY:
+        return "portability";
+    case GL_DEBUG_TYPE_PERFORMANCE:
+        return "performance";
+    case GL_DEBUG_TYPE_MARKER:
+        return "marker";
+    default:
+        return "other";
+    }
+}
+
+static LogLevel severityLevel(const GLenum severity)
+{
+    switch (severity) {
+    case GL_DEBUG_SEVERITY_HIGH:
+        return logERROR;
+    case GL_DEBUG_SEVERITY_MEDIUM:
+        return logWARNING;
+    case GL_DEBUG_SEVERITY_LOW:
+        return logINFO;
+    default:
+        return logDEBUG;
+    }
+}
+
+static void APIENTRY logMessage(GLenum source, GLenum type, GLuint id,
+                                GLenum severity, GLsizei length,
+                                const GLchar* message, const void* /*user_param*/)
+{
+    LOG(severityLevel(severity)) << "OpenGL " << typeName(type) << " ("
+                                 << sourceName(source) << ", " << id << "): "
+                                 << string(message, length);
+}
+
+bool DebugOutput::enable()
+{
+    g_enabled = false;
+    if (!GLEW_KHR_debug) {
+        LOG(logINFO) << "No GL_KHR_debug, OpenGL errors go unreported.";
+        return false;
+    }
+
+    glGetIntegerv(GL_MAX_LABEL_LENGTH, &g_max_label_length);
+    glDebugMessageCallback(logMessage, 0);
+#ifdef ENABLE_GL_DEBUG
+    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, 0,
+                          GL_TRUE);
+#else
+    glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE,
+                          GL_DEBUG_SEVERITY_NOTIFICATION, 0, 0, GL_FALSE);
+#endif
+    // Enabled by default in debug contexts only.
+    glEnable(GL_DEBUG_OUTPUT);
+    g_enabled = true;
+    return true;
+}
+
+bool DebugOutput::isEnabled()
+{
+    return g_enabled;
+}
+
+void DebugOutput::label(const GLenum identifier, const GLuint name,
+                        const string& label)
+{
+    if (!g_enabled) {
+        return;
+    }
+    GLsizei length = std::min<GLsizei>(label.size(), g_max_label_length - 1);
+    glObjectLabel(identifier, name, length, label.c_str());
+}
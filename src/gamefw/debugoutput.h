@@ -0,0 +1,51 @@
+#ifndef DEBUGOUTPUT_H
+#define DEBUGOUTPUT_H
+
+#include "../common.h"
+#include "../ogl.h"
+
+namespace gamefw {
+
+/**
+ * @brief Routes OpenGL errors and warnings into the log through a
+ * GL_KHR_debug message callback, instead of polling glGetError.
+ *
+ * By default the driver reports messages asynchronously, possibly from its
+ * own threads and after the offending call has returned, and notifications
+ * are left out, so the callback costs nothing while there's nothing to
+ * report. Builds with ENABLE_GL_DEBUG ask for a debug context and receive
+ * every message synchronously, from within the offending call, where a
+ * breakpoint in the callback shows who made it.
+ *
+ * Objects labeled with label() are called by their labels in the messages
+ * and in debuggers like RenderDoc and apitrace.
+ **/
+class DebugOutput
+{
+public:
+    /**
+     * @brief Installs the message callback on the current context.
+     *
+     * @return Whether GL_KHR_debug is supported. Without it errors are only
+     *         caught by checkOpenGLError() in builds with ENABLE_GL_DEBUG.
+     **/
+    static bool enable();
+
+    static bool isEnabled();
+
+    /**
+     * @brief Names an OpenGL object in debug messages. Does nothing unless
+     * enabled.
+     *
+     * @param identifier Kind of the object: GL_BUFFER, GL_TEXTURE,
+     *        GL_PROGRAM, GL_VERTEX_ARRAY or GL_FRAMEBUFFER.
+     * @param name The object, which must have been bound once.
+     * @param label Truncated to GL_MAX_LABEL_LENGTH.
+     **/
+    static void label(const GLenum identifier, const GLuint name,
+                      const string& label);
+};
+
+}
+
+#endif // DEBUGOUTPUT_H
@@ -1,6 +1,8 @@
 
 #include "entity.h"
 
+#include <glm/gtx/euler_angles.hpp>
+
 using namespace gamefw;
 
 Entity::Entity()
@@ -9,7 +11,8 @@ m_name(new string("")), m_desc(new string("")),
 m_position(0.0f, 0.0f, 0.0f),
 m_velocity_local(0.0f, 0.0f, 0.0f),
 m_orientation(0.0f, 0.0f, 0.0f),
-m_angular_velocity(0.0f, 0.0f, 0.0f)
+m_angular_velocity(0.0f, 0.0f, 0.0f),
+m_transform_slot(~0u)
 {
 }
 
@@ -32,11 +35,31 @@ void Entity::setRenderJob(shared_ptr< RenderJob > renderjob)
     m_renderjob = renderjob;
 }
 
-shared_ptr< RenderJob > Entity::getRenderJob() const
+const shared_ptr<RenderJob>& Entity::getRenderJob() const
 {
     return m_renderjob;
 }
 
+glm::mat4 Entity::getModelMatrix() const
+{
+    // Orientation ...
+    glm::mat4 model(glm::yawPitchRoll(m_orientation.x,
+                                      m_orientation.y,
+                                      m_orientation.z));
+    // ... + translation
+    model[3] = glm::vec4(m_position, 1.0);
+    return model;
+}
+
+void Entity::copyRenderState(const Entity& source)
+{
+    m_position = source.m_position;
+    m_orientation = source.m_orientation;
+    if (m_renderjob != source.m_renderjob) {
+        m_renderjob = source.m_renderjob;
+    }
+}
+
 void Entity::setDesc(const char* desc)
 {
     m_desc = shared_ptr<string>(new string(desc));
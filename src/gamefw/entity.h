@@ -24,9 +24,24 @@ public:
     shared_ptr<string> getDesc() const;
     void setDesc(const char* desc);
 
-    shared_ptr<RenderJob> getRenderJob() const;
+    /// Returned by reference so render threads don't touch the reference count.
+    const shared_ptr<RenderJob>& getRenderJob() const;
     void setRenderJob(shared_ptr<RenderJob> renderjob);
 
+    /**
+     * @brief Model transform built from m_orientation and m_position.
+     **/
+    glm::mat4 getModelMatrix() const;
+
+    /**
+     * @brief Copies what the renderer reads from another entity. Assigning
+     * whole entities would also copy the transform cache slot, which belongs
+     * to the original.
+     *
+     * @param source ditto.
+     **/
+    void copyRenderState(const Entity& source);
+
     /**
      * @brief World space position.
      **/
@@ -50,9 +65,14 @@ public:
     glm::vec3 m_angular_velocity;
 
 private:
+    friend class TransformStore;
+
     shared_ptr<string> m_name;
     shared_ptr<string> m_desc;
     shared_ptr<RenderJob> m_renderjob;
+
+    /// Slot in the renderer's TransformStore, validated by the store.
+    uint m_transform_slot;
 };
 
 }
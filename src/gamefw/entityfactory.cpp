@@ -39,6 +39,12 @@ typedef struct _vertex_extra {
     GLfloat bitangent[4];
 } t_vertex_extra;
 
+/// Defines changing where vertices end up. Depth-only shaders keep them so
+/// their depth matches the full shaders exactly.
+const char* const POSITION_DEFINES[] = {"FRUSTUM", "SKYBOX",
+                                        "BILLBOARD_AXIS_ALIGNED", "HALFSIZE",
+                                        "TINYSIZE"};
+
 /**
  * @brief Mesh material properties.
  */
@@ -56,6 +62,49 @@ typedef struct _t_material {
 
 using namespace gamefw;
 
+/// Vertex attributes of t_vertex, in the bound GL_ARRAY_BUFFER.
+static void pointVertexAttributes(const bool material_indices)
+{
+    glVertexAttribPointer(
+        renderjob_enums::POSITION,
+        4, GL_FLOAT, GL_FALSE, sizeof(t_vertex),
+        (void*) offsetof(t_vertex, position)
+    );
+
+    glVertexAttribPointer(
+        renderjob_enums::NORMAL,
+        4, GL_FLOAT, GL_FALSE, sizeof(t_vertex),
+        (void*) offsetof(t_vertex, normal)
+    );
+
+    glVertexAttribPointer(
+        renderjob_enums::TEXCOORD,
+        2, GL_FLOAT, GL_FALSE, sizeof(t_vertex),
+        (void*) offsetof(t_vertex, texcoord)
+    );
+
+    if (material_indices) {
+        glVertexAttribIPointer(
+            renderjob_enums::MATERIAL_IDX,
+            1, GL_UNSIGNED_INT, sizeof(t_vertex),
+            (void*) offsetof(t_vertex, material_idx)
+        );
+    }
+}
+
+/// Pools are only used with OpenGL 3.3, which has material indices.
+static void pointPooledVertexAttributes()
+{
+    pointVertexAttributes(true);
+}
+
+/// Tightly packed positions, w defaults to 1.
+static void pointPositionAttributes()
+{
+    glVertexAttribPointer(renderjob_enums::POSITION, 3, GL_FLOAT, GL_FALSE,
+                          3 * sizeof(GLfloat), 0);
+}
+
 const char* EntityCreationError::what() const throw()
 {
     return "Error when creating Entity.";
@@ -63,7 +112,8 @@ const char* EntityCreationError::what() const throw()
 
 EntityFactory::EntityFactory(const OpenGLVersion opengl_version)
 :
-m_opengl_version(opengl_version)
+m_opengl_version(opengl_version),
+m_material_registry(new MaterialRegistry)
 {
 
 }
@@ -141,6 +191,8 @@ shared_ptr<Entity> EntityFactory::createEntity(const string& path)
 
     // Load shaders.
     bool materials_defined = false; // Needed to determine whether uniform blocks are created.
+    bool pooled = false;
+    set<string> defines;
     {
         TiXmlElement* shader_defines_element =
             dochandle.FirstChild("gfx").FirstChild("shader_defines").ToElement();
@@ -148,7 +200,6 @@ shared_ptr<Entity> EntityFactory::createEntity(const string& path)
             LOG(logERROR) << "No shader_defines element in entity file " << path;
             throw EntityCreationError();
         }
-        set<string> defines;
         string shader_defines(shader_defines_element->GetText());
         // Tokenize shader_defines;
         typedef boost::tokenizer<boost::char_separator<char> > tokenizer;
@@ -157,55 +208,65 @@ shared_ptr<Entity> EntityFactory::createEntity(const string& path)
         foreach(string define, tokens) {
             defines.insert(define);
         }
-        GLuint num_materials = model.getNumMaterials();
+        // Materials come from the registry, whose size is the same for all
+        // models, so the program doesn't depend on the model.
         string materials_define("MATERIALS");
         if (defines.find(materials_define) != defines.end()) { // If materials define found.
             materials_defined = true;
             defines.erase(materials_define);
             stringstream materials_define_stream;
-            materials_define_stream << materials_define << " " << num_materials;
+            materials_define_stream << materials_define << " "
+                                    << MaterialRegistry::CAPACITY;
             defines.insert(materials_define_stream.str());
         }
 
-        // Insert vertex attrib indices.
-        int i = 0;
-        foreach(const char* enum_name, renderjob_enums::vertex_strings) {
-            defines.insert(makeDefineFromEnum(enum_name, i++));
-        }
-        i = 0;
-        foreach(const char* enum_name, renderjob_enums::vertex_extra_strings) {
-            defines.insert(makeDefineFromEnum(enum_name, i++));
-        }
-        i = 0;
-        foreach(const char* enum_name, renderjob_enums::uniform_block_strings) {
-            defines.insert(makeDefineFromEnum(enum_name, i++));
-        }
-        i = 0;
-        foreach(const char* enum_name, renderjob_enums::out_gbuffers_strings) {
-            defines.insert(makeDefineFromEnum(enum_name, i++));
-        }
-        i = 0;
-        foreach(const char* enum_name, renderjob_enums::out_pbuffers_strings) {
-            defines.insert(makeDefineFromEnum(enum_name, i++));
-        }
-        i = 0;
-        foreach(const char* enum_name, renderjob_enums::out_ppbuffers_strings) {
-            defines.insert(makeDefineFromEnum(enum_name, i++));
-        }
+        insertEnumDefines(defines);
 
         ShaderFactory& shaderfactory = Locator::getShaderFactory();
         shared_ptr<ShaderProgram> shaderprogram = shaderfactory.makeShader(defines);
         renderjob->setShaderProgram(shaderprogram);
+
+        // Depth-only variant for the depth pre-pass, keeping only what moves
+        // vertices so most meshes share one program. Alpha tested meshes
+        // keep their albedo too, so the G-buffer pass finds the depth of
+        // the texels it doesn't discard.
+        bool scene_mesh = defines.find("FRUSTUM") != defines.end() &&
+                          defines.find("GBUFFER") == defines.end();
+        if (m_opengl_version == OGL_3_3 && scene_mesh) {
+            set<string> depth_defines;
+            foreach (const char* define, POSITION_DEFINES) {
+                if (defines.find(define) != defines.end()) {
+                    depth_defines.insert(define);
+                }
+            }
+            if (defines.find("ALBEDO_TEX") != defines.end()) {
+                renderjob->m_alpha_tested = true;
+                depth_defines.insert("ALBEDO_TEX");
+            }
+            depth_defines.insert("DEPTH_ONLY");
+            insertEnumDefines(depth_defines);
+            renderjob->setDepthShaderProgram(shaderfactory.makeShader(depth_defines));
+            // Drawn together with other scene meshes.
+            pooled = true;
+        }
     }
 
-    // Load model after shader creation because uniform blocks
-    // needs a working shader program.
-    loadModel(model, renderjob);
+    // Occluders keep their triangles for the occlusion culler.
+    if (dochandle.FirstChild("gfx").FirstChild("occluder").ToNode()) {
+        renderjob->m_occluder = true;
+    }
 
+    // Register materials after shader creation because uniform blocks
+    // needs a working shader program, and before loading the model, whose
+    // vertices refer to them.
+    vector<GLuint> material_indices;
     if (materials_defined && m_opengl_version == OGL_3_3) {
-        createMaterials(renderjob, model);
+        material_indices = registerMaterials(renderjob, model);
         checkOpenGLError();
     }
+    loadModel(model, renderjob, pooled, material_indices);
+    adjustBounds(renderjob, defines);
+    labelObjects(renderjob, path);
 
     LOG(logINFO) << "Entity "
     << (name_element ? name_element->GetText() : "*UnNamed*")
@@ -214,20 +275,27 @@ shared_ptr<Entity> EntityFactory::createEntity(const string& path)
     return entity;
 }
 
-void EntityFactory::loadModel(const ObjFile& model, shared_ptr< RenderJob > renderjob)
+void EntityFactory::loadModel(const ObjFile& model, shared_ptr< RenderJob > renderjob,
+                              const bool pooled,
+                              const vector<GLuint>& material_indices)
 {
     vector<t_vertex> vertex_buffer;
     vector<GLushort> element_buffer;
     //  tuple<vertex, normal, texcoord, material_idx>
     typedef boost::tuple<int, int, int, int> vec_identifier;
     map<vec_identifier, int> vec_indexes;
+    // Position-only stream, one vertex per distinct position.
+    vector<GLfloat> depth_positions;
+    vector<GLushort> depth_elements;
+    map<int, int> position_indexes;
 
     int numtriangles = model.getNumTriangles();
 
     // Create vertex- and element buffers.
     for (int i = 0; i < numtriangles; i++) {
         const t_obj_triangle* triangle = model.getTriangles() + i;
-        GLuint material_idx = triangle->material;
+        GLuint material_idx = material_indices.empty() ? triangle->material :
+                              material_indices[triangle->material];
         for (int j = 0; j < 3; j++) {
             int pos, nor, tex;
             pos = triangle->pindices[j];
@@ -255,15 +323,154 @@ void EntityFactory::loadModel(const ObjFile& model, shared_ptr< RenderJob > rend
             }
             GLushort vertex_index = (GLushort) result->second;
             element_buffer.push_back(vertex_index);
+
+            map<int, int>::iterator position_result = position_indexes.find(pos);
+            if (position_result == position_indexes.end()) {
+                position_result = position_indexes.insert(
+                    make_pair(pos, (int) depth_positions.size() / 3)).first;
+                depth_positions.insert(depth_positions.end(),
+                                       model.getPositions() + pos * 3,
+                                       model.getPositions() + pos * 3 + 3);
+            }
+            depth_elements.push_back((GLushort) position_result->second);
         }
     }
     renderjob->m_vertex_count = element_buffer.size();
+    renderjob->m_bounds = BoundingVolume(vertex_buffer[0].position,
+                                         vertex_buffer.size(), sizeof(t_vertex));
 
-    genVertexBuffers(renderjob, &vertex_buffer[0], vertex_buffer.size(),
-                     &element_buffer[0], element_buffer.size());
+    if (renderjob->m_occluder) {
+        renderjob->m_occluder_positions = depth_positions;
+        renderjob->m_occluder_indices = depth_elements;
+    }
+
+    if (pooled) {
+        if (!m_mesh_pool) {
+            m_mesh_pool.reset(new MeshPool("Mesh pool", sizeof(t_vertex),
+                                           pointPooledVertexAttributes));
+            m_depth_mesh_pool.reset(new MeshPool("Depth mesh pool",
+                                                 3 * sizeof(GLfloat),
+                                                 pointPositionAttributes));
+        }
+        renderjob->m_mesh_pool = m_mesh_pool;
+        renderjob->m_mesh_range = m_mesh_pool->add(
+            &vertex_buffer[0], vertex_buffer.size(),
+            &element_buffer[0], element_buffer.size());
+        // Alpha tested meshes draw their depth with texture coordinates.
+        if (!renderjob->m_alpha_tested) {
+            renderjob->m_depth_mesh_pool = m_depth_mesh_pool;
+            renderjob->m_depth_mesh_range = m_depth_mesh_pool->add(
+                &depth_positions[0], depth_positions.size() / 3,
+                &depth_elements[0], depth_elements.size());
+        }
+    } else {
+        genVertexBuffers(renderjob, &vertex_buffer[0], vertex_buffer.size(),
+                         &element_buffer[0], element_buffer.size());
+        if (m_opengl_version == OGL_3_3 && !renderjob->m_alpha_tested) {
+            genDepthBuffers(renderjob, depth_positions, depth_elements);
+        }
+    }
     checkOpenGLError();
 }
 
+void EntityFactory::genDepthBuffers(shared_ptr<RenderJob> renderjob,
+                                    const vector<GLfloat>& positions,
+                                    const vector<GLushort>& elements) const
+{
+    glGenVertexArrays(1, &renderjob->m_buffer_objects.depth_vao);
+    glBindVertexArray(renderjob->m_buffer_objects.depth_vao);
+    {
+        glGenBuffers(1, &renderjob->m_buffer_objects.position_buffer);
+        glGenBuffers(1, &renderjob->m_buffer_objects.depth_element_buffer);
+
+        glBindBuffer(GL_ARRAY_BUFFER, renderjob->m_buffer_objects.position_buffer);
+        glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(GLfloat),
+                     &positions[0], GL_STATIC_DRAW);
+        pointPositionAttributes();
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,
+                     renderjob->m_buffer_objects.depth_element_buffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, elements.size() * sizeof(GLushort),
+                     &elements[0], GL_STATIC_DRAW);
+    }
+    glBindVertexArray(0);
+    renderjob->m_depth_mesh_range.num_indices = elements.size();
+}
+
+void EntityFactory::labelObjects(shared_ptr<RenderJob> renderjob,
+                                 const string& path) const
+{
+    // Pooled meshes share the pools' labels.
+    if (renderjob->m_buffer_objects.vao != 0) {
+        DebugOutput::label(GL_VERTEX_ARRAY, renderjob->m_buffer_objects.vao, path);
+        DebugOutput::label(GL_BUFFER, renderjob->m_buffer_objects.vertex_buffer,
+                           path + " vertices");
+        DebugOutput::label(GL_BUFFER, renderjob->m_buffer_objects.element_buffer,
+                           path + " elements");
+    }
+    if (renderjob->m_buffer_objects.depth_vao != 0) {
+        DebugOutput::label(GL_VERTEX_ARRAY, renderjob->m_buffer_objects.depth_vao,
+                           path + " depth");
+        DebugOutput::label(GL_BUFFER, renderjob->m_buffer_objects.position_buffer,
+                           path + " positions");
+        DebugOutput::label(GL_BUFFER,
+                           renderjob->m_buffer_objects.depth_element_buffer,
+                           path + " depth elements");
+    }
+}
+
+void EntityFactory::adjustBounds(shared_ptr<RenderJob> renderjob,
+                                 const set<string>& defines) const
+{
+    // Mirror the vertex displacements done in uber.v.glsl. Only the first
+    // of them applies, as in the shader's #elif chain, so a billboard keeps
+    // its full size whatever size define it also has.
+    if (defines.find("BILLBOARD_AXIS_ALIGNED") != defines.end()) {
+        renderjob->m_bounds.makeRotationInvariant();
+    } else if (defines.find("SKYBOX") != defines.end()) {
+        // Follows the camera, always visible.
+        renderjob->m_cullable = false;
+    } else if (defines.find("HALFSIZE") != defines.end()) {
+        renderjob->m_bounds.scale(0.5f);
+    } else if (defines.find("TINYSIZE") != defines.end()) {
+        renderjob->m_bounds.scale(0.1f);
+    }
+}
+
+void EntityFactory::insertEnumDefines(set<string>& defines) const
+{
+    // Attribute, uniform block and output indices shared with the shaders.
+    int i = 0;
+    foreach(const char* enum_name, renderjob_enums::vertex_strings) {
+        defines.insert(makeDefineFromEnum(enum_name, i++));
+    }
+    i = 0;
+    foreach(const char* enum_name, renderjob_enums::vertex_extra_strings) {
+        defines.insert(makeDefineFromEnum(enum_name, i++));
+    }
+    i = 0;
+    foreach(const char* enum_name, renderjob_enums::instance_strings) {
+        defines.insert(makeDefineFromEnum(enum_name,
+                                          renderjob_enums::instance_locations[i++]));
+    }
+    i = 0;
+    foreach(const char* enum_name, renderjob_enums::uniform_block_strings) {
+        defines.insert(makeDefineFromEnum(enum_name, i++));
+    }
+    i = 0;
+    foreach(const char* enum_name, renderjob_enums::out_gbuffers_strings) {
+        defines.insert(makeDefineFromEnum(enum_name, i++));
+    }
+    i = 0;
+    foreach(const char* enum_name, renderjob_enums::out_pbuffers_strings) {
+        defines.insert(makeDefineFromEnum(enum_name, i++));
+    }
+    i = 0;
+    foreach(const char* enum_name, renderjob_enums::out_ppbuffers_strings) {
+        defines.insert(makeDefineFromEnum(enum_name, i++));
+    }
+}
+
 const string EntityFactory::makeDefineFromEnum(const char* enum_name, int index) const
 {
     stringstream enum_define;
@@ -291,32 +498,7 @@ void EntityFactory::genVertexBuffers(shared_ptr<RenderJob> renderjob,
                      vertex_buffer, GL_STATIC_DRAW);
         checkOpenGLError();
 
-
-        glVertexAttribPointer(
-            renderjob_enums::POSITION,
-            4, GL_FLOAT, GL_FALSE, sizeof(t_vertex),
-            (void*) offsetof(t_vertex, position)
-        );
-
-        glVertexAttribPointer(
-            renderjob_enums::NORMAL,
-            4, GL_FLOAT, GL_FALSE, sizeof(t_vertex),
-            (void*) offsetof(t_vertex, normal)
-        );
-
-        glVertexAttribPointer(
-            renderjob_enums::TEXCOORD,
-            2, GL_FLOAT, GL_FALSE, sizeof(t_vertex),
-            (void*) offsetof(t_vertex, texcoord)
-        );
-
-        if (m_opengl_version == OGL_3_3) {
-            glVertexAttribIPointer(
-                renderjob_enums::MATERIAL_IDX,
-                1, GL_UNSIGNED_INT, sizeof(t_vertex),
-                (void*) offsetof(t_vertex, material_idx)
-            );
-        }
+        pointVertexAttributes(m_opengl_version == OGL_3_3);
         checkOpenGLError();
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, renderjob->m_buffer_objects.element_buffer);
@@ -324,13 +506,13 @@ void EntityFactory::genVertexBuffers(shared_ptr<RenderJob> renderjob,
                      element_buffer, GL_STATIC_DRAW);
     }
     glBindVertexArray(0);
+    renderjob->m_mesh_range.num_indices = element_buffer_length;
 }
 
-void EntityFactory::createMaterials(shared_ptr<RenderJob> renderjob,
-                                    const ObjFile& model) const
+vector<GLuint> EntityFactory::registerMaterials(shared_ptr<RenderJob> renderjob,
+                                               const ObjFile& model)
 {
     int program_id = renderjob->getShaderProgramID();
-    int num_materials = model.getNumMaterials();
 
     GLuint material_location = glGetUniformBlockIndex(program_id,
                                "materials");
@@ -344,19 +526,17 @@ void EntityFactory::createMaterials(shared_ptr<RenderJob> renderjob,
         &block_size);
 
     // Tests if the the uniform block is similarly aligned in the buffer and the shader source.
-    assert(block_size == sizeof(t_obj_mtl) * num_materials);
-
-    // Create Uniform Buffer Object and fill with material data.
-    glGenBuffers(1, &renderjob->m_uniforms.materials);
-    glBindBuffer(GL_UNIFORM_BUFFER, renderjob->m_uniforms.materials);
-    glBufferData(GL_UNIFORM_BUFFER, block_size, model.getMaterials(), GL_STATIC_DRAW);
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
-
-    // Attach the UBO to RenderJob::MATERIAL index.
-    glBindBufferBase(GL_UNIFORM_BUFFER, renderjob_enums::MATERIAL,
-                     renderjob->m_uniforms.materials);
-    // Associate the block in the GLSL source to this index.
-    glUniformBlockBinding(program_id, material_location, renderjob_enums::MATERIAL);
+    assert(block_size == sizeof(t_obj_mtl) * MaterialRegistry::CAPACITY);
 
-}
+    // Materials equal to ones of earlier models share their indices.
+    vector<GLuint> material_indices;
+    for (GLuint i = 0; i < model.getNumMaterials(); i++) {
+        material_indices.push_back(m_material_registry->add(model.getMaterials()[i]));
+    }
+    m_material_registry->upload();
+    renderjob->m_materials = m_material_registry;
 
+    // Associate the block in the GLSL source to the RenderJob::MATERIAL index.
+    glUniformBlockBinding(program_id, material_location, renderjob_enums::MATERIAL);
+    return material_indices;
+}
@@ -5,8 +5,12 @@
 #include "../common.h"
 #include "../util/objfile.h"
 
+#include <set>
+
 #include "entity.h"
 #include "openglversion.h"
+#include "meshpool.h"
+#include "materialregistry.h"
 
 typedef struct _vertex t_vertex;
 
@@ -51,17 +55,55 @@ public:
     shared_ptr<Entity> createEntity(const std::string& path);
 
 private:
-    void loadModel(const ObjFile& model, shared_ptr<RenderJob> renderjob);
+    /**
+     * @param model ditto.
+     * @param renderjob Receives the mesh.
+     * @param pooled Whether the mesh goes in the shared mesh pools instead
+     *        of buffers of its own.
+     * @param material_indices Global index of each of the model's materials,
+     *        stored in the vertices. Empty to store the model's own indices.
+     **/
+    void loadModel(const ObjFile& model, shared_ptr<RenderJob> renderjob,
+                   const bool pooled, const vector<GLuint>& material_indices);
     
     void genVertexBuffers(shared_ptr<RenderJob> renderjob,
             const t_vertex* vertex_buffer, size_t vertex_buffer_length,
             const GLushort* element_buffer, size_t element_buffer_length) const;
 
-    void createMaterials(shared_ptr<RenderJob> renderjob, const ObjFile& model) const;
+    void genDepthBuffers(shared_ptr<RenderJob> renderjob,
+                         const vector<GLfloat>& positions,
+                         const vector<GLushort>& elements) const;
+
+    /**
+     * @brief Adds the model's materials to the material registry and binds
+     * its uniform block to the render job's program.
+     *
+     * @return Global index of each of the model's materials.
+     **/
+    vector<GLuint> registerMaterials(shared_ptr<RenderJob> renderjob,
+                                     const ObjFile& model);
+
+    /**
+     * @brief Names the render job's buffers after the entity file in
+     * OpenGL's debug messages.
+     **/
+    void labelObjects(shared_ptr<RenderJob> renderjob, const string& path) const;
+
+    void adjustBounds(shared_ptr<RenderJob> renderjob,
+                      const std::set<string>& defines) const;
+
+    void insertEnumDefines(std::set<string>& defines) const;
 
     const std::string makeDefineFromEnum(const char* enum_name, int index) const;
     
     const OpenGLVersion m_opengl_version;
+
+    /// Scene meshes and their position-only streams, created with the first
+    /// scene mesh.
+    shared_ptr<MeshPool> m_mesh_pool, m_depth_mesh_pool;
+
+    /// Materials of every model, deduplicated.
+    shared_ptr<MaterialRegistry> m_material_registry;
 };
 
 }
@@ -93,6 +93,7 @@ const char* FileService::fileToBuffer(const string& filename ) const
 
 GLuint FileService::makeTexture(const string& name)
 {
+    PROFILE_ZONE("FileService::makeTexture");
     map<string, uint >::iterator result = m_texture_cache.find(name);
     if (result != m_texture_cache.end()) { // If texture already loaded.
         return m_texture_cache[name];
@@ -119,6 +120,7 @@ GLuint FileService::makeTexture(const string& name)
         GL_BGRA, GL_UNSIGNED_BYTE,   // external format, type
         pixels                      // pixels
     );
+    DebugOutput::label(GL_TEXTURE, texture, name);
 
     image->clear();
     delete image;
@@ -160,6 +162,7 @@ const string FileService::getRealPath(const string& path) const
 
 shared_ptr<Entity> FileService::createEntity(const string& name) const
 {
+    PROFILE_ZONE("FileService::createEntity");
     string path = "assets/entities/" + name + ".xml";
     string realpath(getRealPath(path));
     return m_entity_factory->createEntity(realpath);
@@ -172,6 +175,7 @@ const std::string gamefw::FileService::getDirSeparator() const
 
 shared_ptr<LevelFile> gamefw::FileService::loadLevelFile(string name) const
 {
+    PROFILE_ZONE("FileService::loadLevelFile");
     string path = "assets/levels/" + name + ".xml";
     string realpath(getRealPath(path));
     return shared_ptr<LevelFile>(new LevelFile(realpath));
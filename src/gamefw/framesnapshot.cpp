@@ -0,0 +1,99 @@
+#include "framesnapshot.h"
+
+using namespace gamefw;
+
+FrameSnapshot::FrameSnapshot()
+{
+}
+
+void FrameSnapshot::clear()
+{
+    m_camera.reset();
+    m_entities.clear();
+    m_hierarchies.clear();
+    m_pointlights.clear();
+}
+
+void FrameSnapshot::setCamera(shared_ptr<Entity> camera)
+{
+    m_camera = camera;
+}
+
+void FrameSnapshot::addEntity(shared_ptr<Entity> entity)
+{
+    m_entities.push_back(entity);
+}
+
+void FrameSnapshot::addHierarchy(shared_ptr<BoundingVolumeHierarchy> hierarchy)
+{
+    m_hierarchies.push_back(hierarchy);
+}
+
+void FrameSnapshot::addPointLight(shared_ptr<PointLight> pointlight)
+{
+    m_pointlights.push_back(pointlight);
+}
+
+void FrameSnapshot::copy(const FrameSnapshot& other)
+{
+    clear();
+
+    if (other.m_camera) {
+        // Made here, as snapshots copied from each other would share it.
+        if (!m_camera_copy) {
+            m_camera_copy.reset(new Entity);
+        }
+        m_camera_copy->copyRenderState(*other.m_camera);
+        m_camera = m_camera_copy;
+    }
+
+    while (m_entity_copies.size() < other.m_entities.size()) {
+        m_entity_copies.push_back(shared_ptr<Entity>(new Entity));
+    }
+    for (uint i = 0; i < other.m_entities.size(); i++) {
+        m_entity_copies[i]->copyRenderState(*other.m_entities[i]);
+        m_entities.push_back(m_entity_copies[i]);
+    }
+
+    while (m_hierarchy_copies.size() < other.m_hierarchies.size()) {
+        m_hierarchy_copies.push_back(
+            shared_ptr<BoundingVolumeHierarchy>(new BoundingVolumeHierarchy));
+    }
+    for (uint i = 0; i < other.m_hierarchies.size(); i++) {
+        m_hierarchy_copies[i]->copy(*other.m_hierarchies[i]);
+        m_hierarchies.push_back(m_hierarchy_copies[i]);
+    }
+
+    while (m_pointlight_copies.size() < other.m_pointlights.size()) {
+        m_pointlight_copies.push_back(shared_ptr<PointLight>(new PointLight));
+    }
+    for (uint i = 0; i < other.m_pointlights.size(); i++) {
+        const PointLight& source = *other.m_pointlights[i];
+        PointLight& copy = *m_pointlight_copies[i];
+        copy.copyRenderState(source);
+        copy.m_color = source.m_color;
+        copy.m_intensity = source.m_intensity;
+        copy.m_radius = source.m_radius;
+        m_pointlights.push_back(m_pointlight_copies[i]);
+    }
+}
+
+const shared_ptr<Entity>& FrameSnapshot::getCamera() const
+{
+    return m_camera;
+}
+
+const vector<shared_ptr<Entity> >& FrameSnapshot::getEntities() const
+{
+    return m_entities;
+}
+
+const vector<shared_ptr<BoundingVolumeHierarchy> >& FrameSnapshot::getHierarchies() const
+{
+    return m_hierarchies;
+}
+
+const vector<shared_ptr<PointLight> >& FrameSnapshot::getPointLights() const
+{
+    return m_pointlights;
+}
@@ -0,0 +1,64 @@
+#ifndef FRAMESNAPSHOT_H
+#define FRAMESNAPSHOT_H
+
+#include "../common.h"
+
+#include "entity.h"
+#include "pointlight.h"
+#include "boundingvolumehierarchy.h"
+
+namespace gamefw {
+
+/**
+ * @brief Everything the renderer draws in a frame: the camera, entities,
+ * hierarchies and point lights.
+ *
+ * The renderer queues a frame into one as entities are added. copy() takes
+ * a snapshot of that queue for a render thread: the camera, entities,
+ * hierarchies and lights are copied, so the simulation can move on while the
+ * copy is drawn. Copies are reused from frame to frame, so the same entities
+ * queued in the same order keep their copies and cached transforms.
+ **/
+class FrameSnapshot
+{
+public:
+    FrameSnapshot();
+
+    /**
+     * @brief Empties the snapshot, keeping the copies for reuse.
+     **/
+    void clear();
+
+    void setCamera(shared_ptr<Entity> camera);
+    void addEntity(shared_ptr<Entity> entity);
+    void addHierarchy(shared_ptr<BoundingVolumeHierarchy> hierarchy);
+    void addPointLight(shared_ptr<PointLight> pointlight);
+
+    /**
+     * @brief Replaces the contents with copies of another snapshot's.
+     *
+     * @param other ditto.
+     **/
+    void copy(const FrameSnapshot& other);
+
+    const shared_ptr<Entity>& getCamera() const;
+    const vector<shared_ptr<Entity> >& getEntities() const;
+    const vector<shared_ptr<BoundingVolumeHierarchy> >& getHierarchies() const;
+    const vector<shared_ptr<PointLight> >& getPointLights() const;
+
+private:
+    shared_ptr<Entity> m_camera;
+    vector<shared_ptr<Entity> > m_entities;
+    vector<shared_ptr<BoundingVolumeHierarchy> > m_hierarchies;
+    vector<shared_ptr<PointLight> > m_pointlights;
+
+    // Made by copy().
+    shared_ptr<Entity> m_camera_copy;
+    vector<shared_ptr<Entity> > m_entity_copies;
+    vector<shared_ptr<BoundingVolumeHierarchy> > m_hierarchy_copies;
+    vector<shared_ptr<PointLight> > m_pointlight_copies;
+};
+
+}
+
+#endif // FRAMESNAPSHOT_H
@@ -0,0 +1,50 @@
+#include "frustum.h"
+
+using namespace gamefw;
+
+Frustum::Frustum()
+{
+    for (int i = 0; i < NUM_PLANES; i++) {
+        m_planes[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+}
+
+Frustum::Frustum(const glm::mat4& view_projection)
+{
+    // Rows of the column major matrix (Gribb & Hartmann).
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(view_projection[0][i], view_projection[1][i],
+                            view_projection[2][i], view_projection[3][i]);
+    }
+    m_planes[LEFT_PLANE] = rows[3] + rows[0];
+    m_planes[RIGHT_PLANE] = rows[3] - rows[0];
+    m_planes[BOTTOM_PLANE] = rows[3] + rows[1];
+    m_planes[TOP_PLANE] = rows[3] - rows[1];
+    m_planes[NEAR_PLANE] = rows[3] + rows[2];
+    m_planes[FAR_PLANE] = rows[3] - rows[2];
+
+    for (int i = 0; i < NUM_PLANES; i++) {
+        float length = glm::length(glm::vec3(m_planes[i]));
+        m_planes[i] = m_planes[i] / length;
+    }
+}
+
+bool Frustum::intersects(const glm::vec3& center,
+                         const glm::vec3& half_extents) const
+{
+    for (int i = 0; i < NUM_PLANES; i++) {
+        const glm::vec3 normal(m_planes[i]);
+        float distance = glm::dot(normal, center) + m_planes[i].w;
+        float radius = glm::dot(glm::abs(normal), half_extents);
+        if (distance + radius < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const glm::vec4& Frustum::getPlane(const int plane) const
+{
+    return m_planes[plane];
+}
@@ -0,0 +1,51 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include "../common.h"
+
+namespace gamefw {
+
+/**
+ * @brief The six clipping planes of a view frustum in world space.
+ *
+ * Each plane is stored as (nx, ny, nz, d) with a normalized normal pointing
+ * into the frustum, so a point p is inside the plane when dot(n, p) + d >= 0.
+ **/
+class Frustum
+{
+public:
+    enum Planes {LEFT_PLANE, RIGHT_PLANE, BOTTOM_PLANE, TOP_PLANE,
+                 NEAR_PLANE, FAR_PLANE, NUM_PLANES};
+
+    /**
+     * @brief Creates a frustum that contains everything.
+     **/
+    Frustum();
+
+    /**
+     * @brief Extracts the planes from a combined view-projection matrix.
+     *
+     * @param view_projection ditto.
+     **/
+    explicit Frustum(const glm::mat4& view_projection);
+
+    /**
+     * @brief Conservative test for a box given as center and half extents.
+     *
+     * @return False only if the box is completely outside a plane.
+     **/
+    bool intersects(const glm::vec3& center, const glm::vec3& half_extents) const;
+
+    /**
+     * @param plane One of Planes.
+     * @return The plane as (nx, ny, nz, d).
+     **/
+    const glm::vec4& getPlane(const int plane) const;
+
+private:
+    glm::vec4 m_planes[NUM_PLANES];
+};
+
+}
+
+#endif // FRUSTUM_H
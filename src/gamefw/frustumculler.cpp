@@ -0,0 +1,140 @@
+#include "frustumculler.h"
+
+#include "simd.h"
+
+using namespace gamefw;
+
+/// Arrays are padded to this, so the widest SIMD path never reads past the end.
+const uint PADDING = 8;
+
+FrustumCuller::FrustumCuller()
+:
+m_count(0)
+{
+}
+
+void FrustumCuller::setFrustum(const Frustum& frustum)
+{
+    m_frustum = frustum;
+}
+
+void FrustumCuller::clear()
+{
+    m_count = 0;
+}
+
+uint FrustumCuller::size() const
+{
+    return m_count;
+}
+
+uint FrustumCuller::add(const BoundingVolume& bounds, const glm::mat4& model)
+{
+    glm::vec3 center, half_extents;
+    float radius = bounds.transform(model, center, half_extents);
+    return add(center, half_extents, radius);
+}
+
+uint FrustumCuller::add(const glm::vec3& center, const glm::vec3& half_extents,
+                        const float radius)
+{
+    if (m_count == m_center_x.size()) {
+        uint padded_size = m_count + PADDING;
+        m_center_x.resize(padded_size, 0.0f);
+        m_center_y.resize(padded_size, 0.0f);
+        m_center_z.resize(padded_size, 0.0f);
+        m_extent_x.resize(padded_size, 0.0f);
+        m_extent_y.resize(padded_size, 0.0f);
+        m_extent_z.resize(padded_size, 0.0f);
+        m_radius.resize(padded_size, 0.0f);
+    }
+    m_center_x[m_count] = center.x;
+    m_center_y[m_count] = center.y;
+    m_center_z[m_count] = center.z;
+    m_extent_x[m_count] = half_extents.x;
+    m_extent_y[m_count] = half_extents.y;
+    m_extent_z[m_count] = half_extents.z;
+    m_radius[m_count] = radius;
+    return m_count++;
+}
+
+uint FrustumCuller::cull(vector<uint>& visible) const
+{
+    uint num_culled = 0;
+
+#ifdef GAMEFW_SIMD
+    // Broadcast the planes once.
+    simd_float normal_x[Frustum::NUM_PLANES], normal_y[Frustum::NUM_PLANES],
+               normal_z[Frustum::NUM_PLANES], distance[Frustum::NUM_PLANES];
+    simd_float abs_normal_x[Frustum::NUM_PLANES],
+               abs_normal_y[Frustum::NUM_PLANES],
+               abs_normal_z[Frustum::NUM_PLANES];
+    for (int p = 0; p < Frustum::NUM_PLANES; p++) {
+        const glm::vec4& plane = m_frustum.getPlane(p);
+        normal_x[p] = simdSet(plane.x);
+        normal_y[p] = simdSet(plane.y);
+        normal_z[p] = simdSet(plane.z);
+        distance[p] = simdSet(plane.w);
+        abs_normal_x[p] = simdSet(glm::abs(plane.x));
+        abs_normal_y[p] = simdSet(glm::abs(plane.y));
+        abs_normal_z[p] = simdSet(glm::abs(plane.z));
+    }
+    const simd_float zero = simdSet(0.0f);
+
+    for (uint i = 0; i < m_count; i += SIMD_WIDTH) {
+        simd_float center_x = simdLoad(&m_center_x[i]);
+        simd_float center_y = simdLoad(&m_center_y[i]);
+        simd_float center_z = simdLoad(&m_center_z[i]);
+        simd_float extent_x = simdLoad(&m_extent_x[i]);
+        simd_float extent_y = simdLoad(&m_extent_y[i]);
+        simd_float extent_z = simdLoad(&m_extent_z[i]);
+        simd_float radius = simdLoad(&m_radius[i]);
+
+        simd_float outside = zero;
+        for (int p = 0; p < Frustum::NUM_PLANES; p++) {
+            // Signed distance from the plane to the shared center.
+            simd_float d = simdAdd(simdAdd(simdMul(normal_x[p], center_x),
+                                           simdMul(normal_y[p], center_y)),
+                                   simdAdd(simdMul(normal_z[p], center_z),
+                                           distance[p]));
+            // Box extent projected on the plane normal.
+            simd_float box_radius =
+                simdAdd(simdAdd(simdMul(abs_normal_x[p], extent_x),
+                                simdMul(abs_normal_y[p], extent_y)),
+                        simdMul(abs_normal_z[p], extent_z));
+            // Both volumes bound the mesh, so the smaller reach is still safe.
+            simd_float reach = simdMin(radius, box_radius);
+            outside = simdOr(outside, simdLess(simdAdd(d, reach), zero));
+        }
+
+        int outside_mask = simdMoveMask(outside);
+        for (uint lane = 0; lane < SIMD_WIDTH && i + lane < m_count; lane++) {
+            if (outside_mask & (1 << lane)) {
+                num_culled++;
+            } else {
+                visible.push_back(i + lane);
+            }
+        }
+    }
+#else
+    for (uint i = 0; i < m_count; i++) {
+        bool outside = false;
+        for (int p = 0; p < Frustum::NUM_PLANES && !outside; p++) {
+            const glm::vec4& plane = m_frustum.getPlane(p);
+            float d = plane.x * m_center_x[i] + plane.y * m_center_y[i] +
+                      plane.z * m_center_z[i] + plane.w;
+            float box_radius = glm::abs(plane.x) * m_extent_x[i] +
+                               glm::abs(plane.y) * m_extent_y[i] +
+                               glm::abs(plane.z) * m_extent_z[i];
+            outside = d + glm::min(m_radius[i], box_radius) < 0.0f;
+        }
+        if (outside) {
+            num_culled++;
+        } else {
+            visible.push_back(i);
+        }
+    }
+#endif
+
+    return num_culled;
+}
@@ -0,0 +1,91 @@
+#ifndef FRUSTUMCULLER_H
+#define FRUSTUMCULLER_H
+
+#include "../common.h"
+
+#include "boundingvolume.h"
+#include "frustum.h"
+
+namespace gamefw {
+
+/**
+ * @brief Batched frustum culling of bounding volumes.
+ *
+ * Volumes are transformed to world space when added and stored in structure of
+ * arrays layout, so that cull() can test four (SSE) or eight (AVX, when built
+ * with -mavx) volumes against a plane with a handful of instructions. A volume
+ * is culled when its bounding sphere or its box is outside any plane.
+ *
+ * Usage:
+ * \code
+ * culler.clear();
+ * culler.setFrustum(Frustum(projection * view));
+ * foreach (entity, entities) culler.add(bounds, model);
+ * vector<uint> visible;
+ * uint num_culled = culler.cull(visible);
+ * \endcode
+ **/
+class FrustumCuller
+{
+public:
+    FrustumCuller();
+
+    /**
+     * @brief Sets the frustum used by following cull() calls.
+     *
+     * @param frustum ditto.
+     **/
+    void setFrustum(const Frustum& frustum);
+
+    /**
+     * @brief Removes all added volumes. Keeps the allocated memory.
+     **/
+    void clear();
+
+    /**
+     * @brief Adds a model space volume transformed to world space.
+     *
+     * @param bounds Model space bounds.
+     * @param model Model transform of the instance.
+     * @return Index of the volume, as reported by cull().
+     **/
+    uint add(const BoundingVolume& bounds, const glm::mat4& model);
+
+    /**
+     * @brief Adds a volume already in world space.
+     *
+     * @param center World space center.
+     * @param half_extents World space half extents of the box.
+     * @param radius World space radius of the sphere.
+     * @return Index of the volume, as reported by cull().
+     **/
+    uint add(const glm::vec3& center, const glm::vec3& half_extents,
+             const float radius);
+
+    /**
+     * @return Number of added volumes.
+     **/
+    uint size() const;
+
+    /**
+     * @brief Tests every added volume against the frustum.
+     *
+     * @param visible Indices of the visible volumes are appended here in
+     *                ascending order.
+     * @return Number of culled volumes.
+     **/
+    uint cull(vector<uint>& visible) const;
+
+private:
+    Frustum m_frustum;
+    uint m_count;
+
+    // World space volumes, padded to a multiple of the SIMD width.
+    vector<float> m_center_x, m_center_y, m_center_z;
+    vector<float> m_extent_x, m_extent_y, m_extent_z;
+    vector<float> m_radius;
+};
+
+}
+
+#endif // FRUSTUMCULLER_H
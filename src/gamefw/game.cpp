@@ -3,6 +3,9 @@
 
 #include "game.h"
 #include "renderer.h"
+#include "headlesscontext.h"
+#include "snapshotqueue.h"
+#include "debugoutput.h"
 
 #include <SFML/Graphics.hpp>
 #include "gamefw.h"
@@ -14,8 +17,13 @@ enum Windows {
 };
 
 Game::Game(const uint display_width, const uint display_height,
-           OpenGLVersion opengl_version)
+           OpenGLVersion opengl_version, WindowMode window_mode)
+:
+m_num_frames(0),
+m_profile_export_frame(0)
 {
+    Profiler::setThreadName("Main");
+
     if (opengl_version == OGL_3_3) {
         m_main_window_context = sf::ContextSettings(24, 8, 0, 3, 3);
         LOG(logINFO) << "Using OpenGL 3.3 Renderer.";
@@ -26,28 +34,52 @@ Game::Game(const uint display_width, const uint display_height,
         LOG(logERROR) << "No support for given OpenGL version.";
         throw OpenGLError();
     }
+#if defined(ENABLE_GL_DEBUG) && \
+    (SFML_VERSION_MAJOR > 2 || (SFML_VERSION_MAJOR == 2 && SFML_VERSION_MINOR >= 3))
+    m_main_window_context.attributeFlags |= sf::ContextSettings::Debug;
+#endif
+
+    if (window_mode == HEADLESS) {
+        if (opengl_version != OGL_3_3) {
+            LOG(logERROR) << "Headless rendering requires OpenGL 3.3.";
+            throw OpenGLError();
+        }
+        m_headless_context = shared_ptr<HeadlessContext>(new HeadlessContext());
+        // Core profiles don't list their extensions the way GLEW expects.
+        glewExperimental = GL_TRUE;
+    }
+
     int status = glewInit();
     if (GLEW_OK != status) {
         LOG(logERROR) << "Error:" << glewGetErrorString(status) << "\n";
     }
+    glGetError(); // glewInit leaves GL_INVALID_ENUM behind on core profiles.
 
-    
-    m_main_window.create(sf::VideoMode(display_width, display_height,
-                                       24), "Test", sf::Style::Default,
-                         m_main_window_context);
-    m_main_window.setActive();
-    m_main_window.setKeyRepeatEnabled(false);
-    m_main_window.setMouseCursorVisible(false);
-    m_main_window.setVerticalSyncEnabled(true);
+    if (!m_headless_context) {
+        m_main_window.create(sf::VideoMode(display_width, display_height,
+                                           24), "Test", sf::Style::Default,
+                             m_main_window_context);
+        m_main_window.setActive();
+        m_main_window.setKeyRepeatEnabled(false);
+        m_main_window.setMouseCursorVisible(false);
+        m_main_window.setVerticalSyncEnabled(true);
+    }
+    DebugOutput::enable();
     glClearColor(0.0, 0.0, 0.0, 1.0);
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LESS);
     // Renderer must be initialized after main window because of OpenGL context dependency.
     m_renderer = shared_ptr<Renderer>(new Renderer(display_width, display_height, opengl_version));
+    if (m_headless_context) {
+        m_renderer->enableOffscreenOutput();
+    }
 }
 
 Game::~Game()
 {
+    stopRenderThread();
+    // The renderer's OpenGL objects go before the context.
+    m_renderer.reset();
     m_main_window.close();
 }
 
@@ -58,20 +90,117 @@ sf::Window* Game::getMainWindow()
 
 UpdateStatus Game::update()
 {
-    UpdateStatus status = m_active_gamestate->update();
-    m_renderer->render();
-    m_main_window.display();
+    PROFILE_ZONE("Game::update");
+    UpdateStatus status;
+    {
+        PROFILE_ZONE("IGameState::update");
+        status = m_active_gamestate->update();
+    }
+    if (m_render_thread) {
+        FrameSnapshot* snapshot = m_snapshots->beginWrite();
+        m_renderer->takeSnapshot(*snapshot);
+        m_snapshots->endWrite();
+    } else {
+        m_renderer->render();
+        display();
+    }
+
+    m_num_frames++;
+    if (m_num_frames == m_profile_export_frame) {
+        exportProfile(m_profile_export_path);
+    }
+
     if (status == UPDATE_QUIT) {
+        stopRenderThread();
         m_main_window.close();
     }
     return status;
 }
 
+void gamefw::Game::setPipelined(const bool enabled, const uint num_snapshots)
+{
+    if (enabled == isPipelined()) {
+        return;
+    }
+    if (!enabled) {
+        stopRenderThread();
+        return;
+    }
+    m_snapshots = shared_ptr<SnapshotQueue>(new SnapshotQueue(num_snapshots));
+    // A context is current on one thread at a time.
+    releaseContext();
+    m_render_thread = shared_ptr<sf::Thread>(new sf::Thread(&Game::renderLoop, this));
+    m_render_thread->launch();
+}
+
+bool gamefw::Game::isPipelined() const
+{
+    return m_render_thread.get() != 0;
+}
+
+void gamefw::Game::renderLoop()
+{
+    PROFILE_THREAD("Render");
+    activateContext();
+    while (FrameSnapshot* snapshot = m_snapshots->beginRead()) {
+        m_renderer->render(*snapshot);
+        display();
+        m_snapshots->endRead();
+    }
+    releaseContext();
+}
+
+void gamefw::Game::stopRenderThread()
+{
+    if (!m_render_thread) {
+        return;
+    }
+    // The render thread finishes the frames already handed over.
+    m_snapshots->close();
+    m_render_thread->wait();
+    m_render_thread.reset();
+    m_snapshots.reset();
+    activateContext();
+}
+
+void gamefw::Game::activateContext()
+{
+    if (m_headless_context) {
+        m_headless_context->makeCurrent();
+    } else {
+        m_main_window.setActive(true);
+    }
+}
+
+void gamefw::Game::releaseContext()
+{
+    if (m_headless_context) {
+        m_headless_context->release();
+    } else {
+        m_main_window.setActive(false);
+    }
+}
+
+void gamefw::Game::display()
+{
+    PROFILE_ZONE("Display");
+    if (m_headless_context) {
+        glFlush();
+    } else {
+        m_main_window.display();
+    }
+}
+
 void gamefw::Game::addToRenderQueue(shared_ptr<Entity> entity)
 {
     m_renderer->addToRenderQueue(entity);
 }
 
+void gamefw::Game::addToRenderQueue(shared_ptr<BoundingVolumeHierarchy> hierarchy)
+{
+    m_renderer->addToRenderQueue(hierarchy);
+}
+
 void gamefw::Game::addToPointLightQueue(shared_ptr<PointLight> pointlight)
 {
     m_renderer->addToPointLightQueue(pointlight);
@@ -82,6 +211,36 @@ shared_ptr<Renderer> gamefw::Game::getRenderer()
     return m_renderer;
 }
 
+bool gamefw::Game::isHeadless() const
+{
+    return m_headless_context.get() != 0;
+}
+
+void gamefw::Game::readFrame(vector<unsigned char>& rgba) const
+{
+    if (isPipelined()) {
+        LOG(logERROR) << "Frames can't be read back while pipelined.";
+        rgba.clear();
+        return;
+    }
+    m_renderer->readOutput(rgba);
+}
+
+void gamefw::Game::exportProfile(const string& path)
+{
+    if (Profiler::exportChromeTrace(path)) {
+        LOG(logINFO) << "Profile written to " << path << ".";
+    } else {
+        LOG(logERROR) << "Couldn't write profile to " << path << ".";
+    }
+}
+
+void gamefw::Game::exportProfileAfter(const uint num_frames, const string& path)
+{
+    m_profile_export_frame = m_num_frames + num_frames;
+    m_profile_export_path = path;
+}
+
 void gamefw::Game::changeGameState(shared_ptr< IGameState > gamestate)
 {
     m_active_gamestate = gamestate;
@@ -14,6 +14,19 @@ class Renderer;
 
 class PointLight;
 
+class BoundingVolumeHierarchy;
+
+class HeadlessContext;
+
+class SnapshotQueue;
+
+enum WindowMode {
+    WINDOWED,
+    /// No window, frames are rendered offscreen and read back with
+    /// Game::readFrame(). Needs an OpenGL 3.3 build with EGL.
+    HEADLESS
+};
+
 /**
  * @brief Main game class. Provides the main window and performs input processing.
  */
@@ -26,8 +39,11 @@ public:
      * @param display_width Height in pixels.
      * @param display_height Width in pixels.
      * @param opengl_version OpenGL context version. Defaults to OGL_3_3.
+     * @param window_mode Whether to open a window. Defaults to WINDOWED.
      **/
-    Game(const uint display_width, const uint display_height, const OpenGLVersion opengl_version = OGL_3_3);
+    Game(const uint display_width, const uint display_height,
+         const OpenGLVersion opengl_version = OGL_3_3,
+         const WindowMode window_mode = WINDOWED);
 
     ~Game();
 
@@ -35,9 +51,30 @@ public:
 
     /**
      * @brief Draws the screen and performs input processing.
+     *
+     * When pipelined, only hands a snapshot of the frame to the render
+     * thread, waiting while it is behind.
      */
     UpdateStatus update();
 
+    /**
+     * @brief Renders on a thread of its own, owning the OpenGL context, while
+     * update() simulates the next frame. update() hands the renderer's queue,
+     * camera and lights over as snapshots, so the simulation can change
+     * entities while a frame is drawn. Adds up to num_snapshots - 1 frames of
+     * latency. Disabled by default.
+     *
+     * Entities have to be loaded before enabling, loading makes OpenGL calls.
+     * While pipelined, the renderer's settings and statistics mustn't be
+     * touched from this thread, and readFrame() is unavailable.
+     *
+     * @param enabled ditto.
+     * @param num_snapshots 2 for double buffering, 3 for triple.
+     **/
+    void setPipelined(const bool enabled, const uint num_snapshots = 2);
+
+    bool isPipelined() const;
+
     /**
      * @brief Changes the active GameState.
      * 
@@ -52,6 +89,13 @@ public:
      */
     void addToRenderQueue(shared_ptr<Entity> entity);
 
+    /**
+     * @brief Adds every entity of a hierarchy to the rendering pipeline.
+     *
+     * @param hierarchy ditto.
+     */
+    void addToRenderQueue(shared_ptr<BoundingVolumeHierarchy> hierarchy);
+
     /**
      * @brief Adds pointlight to the rendering pipeline.
      *
@@ -62,12 +106,59 @@ public:
 
     shared_ptr<Renderer> getRenderer();
 
+    /**
+     * @return True if there is no window.
+     */
+    bool isHeadless() const;
+
+    /**
+     * @brief Reads back the last frame drawn by update().
+     *
+     * @param rgba Resized to the display size, 4 bytes per pixel, rows from
+     *        top to bottom.
+     */
+    void readFrame(vector<unsigned char>& rgba) const;
+
+    /**
+     * @brief Writes the CPU profiling zones recorded so far as Chrome trace
+     * JSON. Zones are only recorded when built with ENABLE_PROFILING.
+     *
+     * @param path File to write.
+     */
+    void exportProfile(const string& path);
+
+    /**
+     * @brief Exports the profile once the given number of frames more have
+     * been updated.
+     *
+     * @param num_frames ditto.
+     * @param path File to write.
+     */
+    void exportProfileAfter(const uint num_frames, const string& path);
+
 private:
+    void renderLoop();
+    void stopRenderThread();
+    void activateContext();
+    void releaseContext();
+    void display();
+
     shared_ptr<Renderer> m_renderer;
+    /// Replaces the window's context when headless.
+    shared_ptr<HeadlessContext> m_headless_context;
     sf::ContextSettings m_main_window_context;
     sf::Window m_main_window;
 
+    /// Frames handed to m_render_thread, when pipelined.
+    shared_ptr<SnapshotQueue> m_snapshots;
+    shared_ptr<sf::Thread> m_render_thread;
+
     shared_ptr<IGameState> m_active_gamestate;
+
+    uint m_num_frames;
+    /// Frame after which the profile is exported, 0 for none.
+    uint m_profile_export_frame;
+    string m_profile_export_path;
 };
 
 }
@@ -10,10 +10,13 @@
 class OpenGLError: public exception {};
 
 /**
- * Checks if OpenGL has generated an error.
+ * Checks if OpenGL has generated an error. glGetError waits for the driver
+ * to catch up, so this is only done in builds with ENABLE_GL_DEBUG. Other
+ * builds learn of errors through DebugOutput.
  * 
  * @throw OpenGLError When an error has occured.
  */
+#ifdef ENABLE_GL_DEBUG
 inline void checkOpenGLError()
 {
     int error;
@@ -45,8 +48,55 @@ inline void checkOpenGLError()
         throw OpenGLError();
     }
 }
+#else
+inline void checkOpenGLError()
+{
+}
+#endif
+
+/**
+ * Checks that the bound framebuffer is complete, logging why if not.
+ *
+ * @return True when complete.
+ */
+inline bool checkFramebuffer()
+{
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    string error = "Framebuffer object error: ";
+
+    switch (status)
+    {
+    case GL_FRAMEBUFFER_UNDEFINED:
+        LOG(logERROR) << error << "GL_FRAMEBUFFER_UNDEFINED";
+        break;
+    case GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT:
+        LOG(logERROR) << error << "GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT";
+        break;
+    case GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT:
+        LOG(logERROR) << error << "GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT";
+        break;
+    case GL_FRAMEBUFFER_INCOMPLETE_DRAW_BUFFER:
+        LOG(logERROR) << error << "GL_FRAMEBUFFER_INCOMPLETE_DRAW_BUFFER";
+        break;
+    case GL_FRAMEBUFFER_INCOMPLETE_READ_BUFFER:
+        LOG(logERROR) << error << "GL_FRAMEBUFFER_INCOMPLETE_READ_BUFFER";
+        break;
+    case GL_FRAMEBUFFER_UNSUPPORTED:
+        LOG(logERROR) << error << "GL_FRAMEBUFFER_UNSUPPORTED";
+        break;
+    case GL_FRAMEBUFFER_INCOMPLETE_MULTISAMPLE:
+        LOG(logERROR) << error << "GL_FRAMEBUFFER_INCOMPLETE_MULTISAMPLE";
+        break;
+    case GL_FRAMEBUFFER_INCOMPLETE_LAYER_TARGETS:
+        LOG(logERROR) << error << "GL_FRAMEBUFFER_INCOMPLETE_LAYER_TARGETS";
+        break;
+    }
+
+    return status == GL_FRAMEBUFFER_COMPLETE;
+}
 
 #include "openglversion.h"
+#include "debugoutput.h"
 #include "entity.h"
 #include "pointlight.h"
 #include "icontroller.h"
@@ -56,6 +106,7 @@ inline void checkOpenGLError()
 #include "shaderfactory.h"
 #include "shaderprogram.h"
 #include "renderjob.h"
+#include "frustumculler.h"
 #include "entityfactory.h"
 #include "fileservice.h"
 #include "locator.h"
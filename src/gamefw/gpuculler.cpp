@@ -0,0 +1,215 @@
+#include "gpuculler.h"
+
+#include "commandbuffer.h"
+#include "debugoutput.h"
+#include "locator.h"
+#include "gamefw.h"
+
+using namespace gamefw;
+
+/// Work group sizes, as declared in cull.c.glsl.
+const GLuint CULL_GROUP_SIZE = 64;
+const GLuint DEPTH_PYRAMID_GROUP_SIZE = 8;
+
+// Shader storage bindings of the culling, of the blocks named in
+// STORAGE_BLOCKS.
+enum { INSTANCES_BINDING, DRAWS_BINDING, COMMANDS_BINDING, VISIBLE_BINDING };
+const char* const STORAGE_BLOCKS[] = {"instance_block", "draw_block",
+                                      "command_block", "visible_block"};
+
+/// Number of work groups covering size invocations.
+static GLuint numGroups(const GLuint size, const GLuint group_size)
+{
+    return (size + group_size - 1) / group_size;
+}
+
+GpuCuller::GpuCuller(const GLuint depth_width, const GLuint depth_height)
+:
+m_source(0),
+m_visible_instances(0),
+m_visible_instances_size(0),
+m_depth_pyramid(0),
+m_depth_width(depth_width),
+m_depth_height(depth_height),
+m_depth_pyramid_levels(1),
+m_depth_pyramid_valid(false)
+{
+    m_depth_pyramid_viewport[0] = m_depth_pyramid_viewport[1] = 0;
+
+    m_source = Locator::getFileService().fileToBuffer("src/cull.c.glsl");
+    try {
+        set<string> defines;
+        defines.insert("CULL");
+        m_cull_program.reset(new ShaderProgram(m_source, defines));
+        defines.clear();
+        defines.insert("DEPTH_PYRAMID");
+        m_depth_pyramid_program.reset(new ShaderProgram(m_source, defines));
+    } catch (...) {
+        // The destructor doesn't run for a constructor that throws.
+        delete [] m_source;
+        throw;
+    }
+
+    // Bound here like the uniform blocks, binding layout qualifiers need
+    // GLSL 4.20.
+    const GLuint cull_program_id = m_cull_program->getProgramID();
+    for (GLuint binding = INSTANCES_BINDING; binding <= VISIBLE_BINDING; binding++) {
+        GLuint block = glGetProgramResourceIndex(cull_program_id,
+                                                 GL_SHADER_STORAGE_BLOCK,
+                                                 STORAGE_BLOCKS[binding]);
+        glShaderStorageBlockBinding(cull_program_id, block, binding);
+    }
+
+    glGenBuffers(1, &m_visible_instances);
+
+    // The first level is half the size of the depth buffer, down to 1x1.
+    GLuint size = std::max(std::max((depth_width + 1) / 2, (depth_height + 1) / 2), 1u);
+    while (size > 1) {
+        size = (size + 1) / 2;
+        m_depth_pyramid_levels++;
+    }
+    glGenTextures(1, &m_depth_pyramid);
+    glBindTexture(GL_TEXTURE_2D, m_depth_pyramid);
+    glTexStorage2D(GL_TEXTURE_2D, m_depth_pyramid_levels, GL_R32F,
+                   std::max((depth_width + 1) / 2, 1u),
+                   std::max((depth_height + 1) / 2, 1u));
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    DebugOutput::label(GL_TEXTURE, m_depth_pyramid, "Depth pyramid");
+    checkOpenGLError();
+}
+
+GpuCuller::~GpuCuller()
+{
+    m_cull_program.reset();
+    m_depth_pyramid_program.reset();
+    delete [] m_source;
+    glDeleteBuffers(1, &m_visible_instances);
+    glDeleteTextures(1, &m_depth_pyramid);
+}
+
+bool GpuCuller::isSupported()
+{
+    return GLEW_ARB_compute_shader && GLEW_ARB_shader_storage_buffer_object &&
+           GLEW_ARB_program_interface_query &&
+           GLEW_ARB_shader_image_load_store && GLEW_ARB_texture_storage;
+}
+
+void GpuCuller::cull(const GLuint buffer, const RingBuffer::Allocation& instances,
+                     const RingBuffer::Allocation& draws,
+                     const RingBuffer::Allocation& commands,
+                     const Frustum& frustum, const bool occlusion_culling,
+                     StateCache& state)
+{
+    PROFILE_ZONE("GpuCuller::cull");
+    const GLuint num_instances = instances.size /
+                                 sizeof(CommandBuffer::InstanceData);
+    const GLuint num_draws = draws.size / sizeof(DrawBounds);
+    if (num_instances == 0) {
+        return;
+    }
+
+    // Grown with room to spare, so it isn't reallocated every frame.
+    if (instances.size > m_visible_instances_size) {
+        m_visible_instances_size = std::max(instances.size,
+                                            2 * m_visible_instances_size);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_visible_instances);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, m_visible_instances_size, 0,
+                     GL_DYNAMIC_COPY);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        DebugOutput::label(GL_BUFFER, m_visible_instances, "Visible instances");
+    }
+
+    const GLuint program_id = m_cull_program->getProgramID();
+    state.useProgram(program_id);
+    glUniform1ui(glGetUniformLocation(program_id, "num_instances"), num_instances);
+    glUniform1ui(glGetUniformLocation(program_id, "num_draws"), num_draws);
+    glm::vec4 planes[Frustum::NUM_PLANES];
+    for (int p = 0; p < Frustum::NUM_PLANES; p++) {
+        planes[p] = frustum.getPlane(p);
+    }
+    glUniform4fv(glGetUniformLocation(program_id, "frustum_planes"),
+                 Frustum::NUM_PLANES, &planes[0][0]);
+
+    const bool test_depth = occlusion_culling && m_depth_pyramid_valid;
+    glUniform1i(glGetUniformLocation(program_id, "occlusion_culling"), test_depth);
+    if (test_depth) {
+        state.bindTexture(0, GL_TEXTURE_2D, m_depth_pyramid);
+        glUniform1i(glGetUniformLocation(program_id, "depth_pyramid"), 0);
+        glUniform1i(glGetUniformLocation(program_id, "depth_pyramid_levels"),
+                    m_depth_pyramid_levels);
+        glUniformMatrix4fv(glGetUniformLocation(program_id,
+                                                "previous_viewprojection"),
+                           1, GL_FALSE, &m_depth_pyramid_viewprojection[0][0]);
+        glUniform2iv(glGetUniformLocation(program_id, "previous_viewport"), 1,
+                     m_depth_pyramid_viewport);
+    }
+
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, INSTANCES_BINDING, buffer,
+                      instances.offset, instances.size);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, DRAWS_BINDING, buffer,
+                      draws.offset, draws.size);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, COMMANDS_BINDING, buffer,
+                      commands.offset, commands.size);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, VISIBLE_BINDING,
+                      m_visible_instances, 0, instances.size);
+    glDispatchCompute(numGroups(num_instances, CULL_GROUP_SIZE), 1, 1);
+    for (GLuint binding = INSTANCES_BINDING; binding <= VISIBLE_BINDING; binding++) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, 0);
+    }
+
+    // The counts are read as draw parameters, the instances as attributes.
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+void GpuCuller::buildDepthPyramid(const GLuint depth_texture,
+                                  const glm::mat4& viewprojection,
+                                  const GLuint viewport_width,
+                                  const GLuint viewport_height,
+                                  StateCache& state)
+{
+    PROFILE_ZONE("GpuCuller::buildDepthPyramid");
+    const GLuint program_id = m_depth_pyramid_program->getProgramID();
+    state.useProgram(program_id);
+    glUniform1i(glGetUniformLocation(program_id, "source"), 0);
+    glUniform1i(glGetUniformLocation(program_id, "destination"), 0);
+
+    // Each level reduces the one before it, the first the depth buffer.
+    GLuint source_width = m_depth_width, source_height = m_depth_height;
+    for (GLint level = 0; level < m_depth_pyramid_levels; level++) {
+        const GLuint width = std::max((source_width + 1) / 2, 1u);
+        const GLuint height = std::max((source_height + 1) / 2, 1u);
+        state.bindTexture(0, GL_TEXTURE_2D, level == 0 ? depth_texture :
+                                                          m_depth_pyramid);
+        glUniform1i(glGetUniformLocation(program_id, "source_level"),
+                    level == 0 ? 0 : level - 1);
+        glUniform2i(glGetUniformLocation(program_id, "source_size"),
+                    source_width, source_height);
+        glUniform2i(glGetUniformLocation(program_id, "destination_size"),
+                    width, height);
+        glBindImageTexture(0, m_depth_pyramid, level, GL_FALSE, 0,
+                           GL_WRITE_ONLY, GL_R32F);
+        glDispatchCompute(numGroups(width, DEPTH_PYRAMID_GROUP_SIZE),
+                          numGroups(height, DEPTH_PYRAMID_GROUP_SIZE), 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        source_width = width;
+        source_height = height;
+    }
+    glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+    m_depth_pyramid_valid = true;
+    m_depth_pyramid_viewprojection = viewprojection;
+    m_depth_pyramid_viewport[0] = viewport_width;
+    m_depth_pyramid_viewport[1] = viewport_height;
+}
+
+void GpuCuller::invalidateDepthPyramid()
+{
+    m_depth_pyramid_valid = false;
+}
+
+GLuint GpuCuller::getVisibleInstances() const
+{
+    return m_visible_instances;
+}
@@ -0,0 +1,125 @@
+#ifndef GPUCULLER_H
+#define GPUCULLER_H
+
+#include "../common.h"
+#include "../ogl.h"
+
+#include "frustum.h"
+#include "ringbuffer.h"
+#include "shaderprogram.h"
+#include "statecache.h"
+
+namespace gamefw {
+
+/**
+ * @brief Culls the instances of indirect draws in a compute shader, so the
+ * CPU never tests or reads back single instances.
+ *
+ * Each instance's box, given per draw in model space, is transformed by the
+ * instance's model matrix and tested against the frustum, and optionally
+ * against a depth pyramid of the previous frame. The instances that pass are
+ * compacted to the front of their draw's range in a buffer of visible
+ * instances, and atomically counted into the instance counts of the draw
+ * commands, which the draws then read straight from the GPU.
+ *
+ * Testing against the previous frame's depth can hide an object for one
+ * frame when something in front of it moves away.
+ **/
+class GpuCuller
+{
+public:
+    /// Model space box of the mesh of one draw, as read by the shader.
+    struct DrawBounds {
+        GLfloat center[3];
+        GLuint first_instance;
+        GLfloat half_extents[3];
+        /// 0 if the instances are always drawn.
+        GLuint cullable;
+    };
+
+    /**
+     * @brief Creates the compute programs and the depth pyramid. Requires a
+     * current OpenGL context and isSupported().
+     *
+     * @param depth_width Width of the depth buffers of buildDepthPyramid().
+     * @param depth_height ditto.
+     **/
+    GpuCuller(const GLuint depth_width, const GLuint depth_height);
+    ~GpuCuller();
+
+    /**
+     * @return Whether the context has compute shaders, shader storage
+     *         buffers and their program interface queries, image load and
+     *         store and immutable textures.
+     **/
+    static bool isSupported();
+
+    /**
+     * @brief Dispatches the culling of this frame's instances. Draws issued
+     * afterwards may read the commands and getVisibleInstances().
+     *
+     * @param buffer Buffer holding the three ranges.
+     * @param instances CommandBuffer::InstanceData of every instance.
+     * @param draws DrawBounds of every draw, sorted by first instance.
+     * @param commands Two indirect draw commands per draw, see cull.c.glsl,
+     *        with zero instances.
+     * @param frustum ditto.
+     * @param occlusion_culling Whether to also test against the depth pyramid,
+     *        if one was built.
+     * @param state Program and texture bindings go through it.
+     **/
+    void cull(const GLuint buffer, const RingBuffer::Allocation& instances,
+              const RingBuffer::Allocation& draws,
+              const RingBuffer::Allocation& commands, const Frustum& frustum,
+              const bool occlusion_culling, StateCache& state);
+
+    /**
+     * @brief Builds the depth pyramid the next frame's instances are tested
+     * against.
+     *
+     * @param depth_texture Depth buffer of the frame's scene.
+     * @param viewprojection The frame's view-projection.
+     * @param viewport_width Pixels of the depth buffer the scene covers.
+     * @param viewport_height ditto.
+     * @param state ditto.
+     **/
+    void buildDepthPyramid(const GLuint depth_texture,
+                           const glm::mat4& viewprojection,
+                           const GLuint viewport_width,
+                           const GLuint viewport_height, StateCache& state);
+
+    /**
+     * @brief Stops testing against the depth pyramid until the next one is
+     * built, when the previous frame no longer tells what is hidden.
+     **/
+    void invalidateDepthPyramid();
+
+    /**
+     * @return Buffer of the instances that passed the last cull().
+     **/
+    GLuint getVisibleInstances() const;
+
+private:
+    GpuCuller(const GpuCuller&);
+    GpuCuller& operator=(const GpuCuller&);
+
+    /// Source of both programs, kept for their lifetime.
+    const char* m_source;
+    shared_ptr<ShaderProgram> m_cull_program;
+    shared_ptr<ShaderProgram> m_depth_pyramid_program;
+
+    GLuint m_visible_instances;
+    GLsizeiptr m_visible_instances_size;
+
+    GLuint m_depth_pyramid;
+    GLuint m_depth_width, m_depth_height;
+    GLint m_depth_pyramid_levels;
+    bool m_depth_pyramid_valid;
+    /// Camera and viewport the pyramid was built with.
+    glm::mat4 m_depth_pyramid_viewprojection;
+    GLint m_depth_pyramid_viewport[2];
+};
+
+}
+
+#endif // GPUCULLER_H
@@ -0,0 +1,89 @@
+#include "gputimer.h"
+
+#include <algorithm>
+
+using namespace gamefw;
+
+GpuTimer::GpuTimer(const uint num_passes, const uint num_frames)
+:
+m_num_passes(num_passes),
+m_num_frames(num_frames),
+m_queries(num_passes * num_frames),
+m_issued(num_passes * num_frames, false),
+m_frame(0),
+m_num_frames_begun(0),
+m_stats(num_passes)
+{
+    glGenQueries(m_queries.size(), &m_queries[0]);
+}
+
+GpuTimer::~GpuTimer()
+{
+    glDeleteQueries(m_queries.size(), &m_queries[0]);
+}
+
+bool GpuTimer::beginFrame()
+{
+    m_frame = m_num_frames_begun % m_num_frames;
+    m_num_frames_begun++;
+
+    const uint first = m_frame * m_num_passes;
+    bool any_issued = false;
+    for (uint pass = 0; pass < m_num_passes; pass++) {
+        if (!m_issued[first + pass]) {
+            continue;
+        }
+        any_issued = true;
+
+        // Normally long done. If not, give up on the frame rather than wait.
+        GLint available = 0;
+        glGetQueryObjectiv(m_queries[first + pass], GL_QUERY_RESULT_AVAILABLE,
+                           &available);
+        if (!available) {
+            std::fill(m_issued.begin() + first,
+                      m_issued.begin() + first + m_num_passes, false);
+            return false;
+        }
+    }
+    if (!any_issued) {
+        return false;
+    }
+
+    float frame_time = 0.0f;
+    for (uint pass = 0; pass < m_num_passes; pass++) {
+        if (!m_issued[first + pass]) {
+            continue;
+        }
+        GLuint64 elapsed = 0; // Nanoseconds.
+        glGetQueryObjectui64v(m_queries[first + pass], GL_QUERY_RESULT,
+                              &elapsed);
+        float milliseconds = elapsed * 1e-6f;
+        m_stats[pass].add(milliseconds);
+        frame_time += milliseconds;
+        m_issued[first + pass] = false;
+    }
+    m_frame_stats.add(frame_time);
+    return true;
+}
+
+void GpuTimer::begin(const uint pass)
+{
+    const uint index = m_frame * m_num_passes + pass;
+    glBeginQuery(GL_TIME_ELAPSED, m_queries[index]);
+    m_issued[index] = true;
+}
+
+void GpuTimer::end()
+{
+    glEndQuery(GL_TIME_ELAPSED);
+}
+
+const TimingStats& GpuTimer::getStats(const uint pass) const
+{
+    return m_stats[pass];
+}
+
+const TimingStats& GpuTimer::getFrameStats() const
+{
+    return m_frame_stats;
+}
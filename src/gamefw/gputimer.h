@@ -0,0 +1,80 @@
+#ifndef GPUTIMER_H
+#define GPUTIMER_H
+
+#include "../common.h"
+#include "../ogl.h"
+
+#include "timingstats.h"
+
+namespace gamefw {
+
+/**
+ * @brief Times passes on the GPU with GL_TIME_ELAPSED queries.
+ *
+ * Every frame in flight has its own set of queries, one per pass. A frame's
+ * results are only read when its queries are about to be reused, by which
+ * time the GPU has finished them, so reading never stalls. Passes can't
+ * overlap, elapsed time queries don't nest.
+ **/
+class GpuTimer
+{
+public:
+    /**
+     * @brief Creates the queries. Requires a current OpenGL context.
+     *
+     * @param num_passes Number of passes timed per frame.
+     * @param num_frames Number of frames results lag behind.
+     **/
+    GpuTimer(const uint num_passes, const uint num_frames = 3);
+    ~GpuTimer();
+
+    /**
+     * @brief Starts a frame, collecting the results of the frame that used
+     * its queries before.
+     *
+     * @return Whether results were collected. The frame's total is then in
+     *         getFrameStats().getLatest().
+     **/
+    bool beginFrame();
+
+    /**
+     * @brief Starts timing a pass. Passes not begun in a frame are left out
+     * of its results.
+     *
+     * @param pass ditto.
+     **/
+    void begin(const uint pass);
+
+    /// Stops timing the pass begun last.
+    void end();
+
+    /**
+     * @return Times of the given pass in milliseconds.
+     **/
+    const TimingStats& getStats(const uint pass) const;
+
+    /**
+     * @return Sum of the timed passes of each frame in milliseconds.
+     **/
+    const TimingStats& getFrameStats() const;
+
+private:
+    GpuTimer(const GpuTimer&);
+    GpuTimer& operator=(const GpuTimer&);
+
+    uint m_num_passes;
+    uint m_num_frames;
+    /// num_passes queries per frame, frame after frame.
+    vector<GLuint> m_queries;
+    /// Whether each query was issued in its frame.
+    vector<bool> m_issued;
+    uint m_frame;
+    uint m_num_frames_begun;
+
+    vector<TimingStats> m_stats;
+    TimingStats m_frame_stats;
+};
+
+}
+
+#endif // GPUTIMER_H
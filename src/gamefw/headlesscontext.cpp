@@ -0,0 +1,170 @@
+#include "headlesscontext.h"
+
+#include "gamefw.h"
+
+#ifdef HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif // HAVE_EGL
+
+using namespace gamefw;
+
+#ifdef HAVE_EGL
+
+static bool hasExtension(const char* extensions, const char* name)
+{
+    if (!extensions) {
+        return false;
+    }
+    // Whole words only, names may be prefixes of each other.
+    const size_t length = strlen(name);
+    for (const char* found = strstr(extensions, name); found;
+         found = strstr(found + length, name)) {
+        bool starts = found == extensions || found[-1] == ' ';
+        bool ends = found[length] == ' ' || found[length] == '\0';
+        if (starts && ends) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static EGLDisplay getDisplay()
+{
+    const char* client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (hasExtension(client_extensions, "EGL_MESA_platform_surfaceless") &&
+        hasExtension(client_extensions, "EGL_EXT_platform_base")) {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay) {
+            EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+                                                    EGL_DEFAULT_DISPLAY, 0);
+            if (display != EGL_NO_DISPLAY) {
+                return display;
+            }
+        }
+    }
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+HeadlessContext::HeadlessContext()
+:
+m_display(EGL_NO_DISPLAY),
+m_context(EGL_NO_CONTEXT),
+m_surface(EGL_NO_SURFACE)
+{
+    EGLDisplay display = getDisplay();
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        LOG(logERROR) << "Couldn't initialize an EGL display.";
+        throw OpenGLError();
+    }
+    m_display = display;
+    LOG(logINFO) << "Using EGL " << major << "." << minor << ".";
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        LOG(logERROR) << "EGL doesn't support desktop OpenGL.";
+        eglTerminate(display);
+        throw OpenGLError();
+    }
+
+    const EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_STENCIL_SIZE, 8,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint num_configs = 0;
+    if (!eglChooseConfig(display, config_attribs, &config, 1, &num_configs) ||
+        num_configs == 0) {
+        LOG(logERROR) << "No suitable EGL config.";
+        eglTerminate(display);
+        throw OpenGLError();
+    }
+
+    const EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+        EGL_CONTEXT_MINOR_VERSION_KHR, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+#ifdef ENABLE_GL_DEBUG
+        EGL_CONTEXT_FLAGS_KHR, EGL_CONTEXT_OPENGL_DEBUG_BIT_KHR,
+#endif
+        EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT,
+                                          context_attribs);
+    if (context == EGL_NO_CONTEXT) {
+        LOG(logERROR) << "Couldn't create an OpenGL 3.3 core context with EGL.";
+        eglTerminate(display);
+        throw OpenGLError();
+    }
+    m_context = context;
+
+    if (!hasExtension(eglQueryString(display, EGL_EXTENSIONS),
+                      "EGL_KHR_surfaceless_context")) {
+        const EGLint pbuffer_attribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+        m_surface = eglCreatePbufferSurface(display, config, pbuffer_attribs);
+        if (m_surface == EGL_NO_SURFACE) {
+            LOG(logERROR) << "Couldn't create an EGL pbuffer.";
+            eglDestroyContext(display, context);
+            eglTerminate(display);
+            throw OpenGLError();
+        }
+    }
+
+    makeCurrent();
+}
+
+HeadlessContext::~HeadlessContext()
+{
+    eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (m_surface != EGL_NO_SURFACE) {
+        eglDestroySurface(m_display, m_surface);
+    }
+    eglDestroyContext(m_display, m_context);
+    eglTerminate(m_display);
+}
+
+void HeadlessContext::makeCurrent()
+{
+    if (!eglMakeCurrent(m_display, m_surface, m_surface, m_context)) {
+        LOG(logERROR) << "Couldn't make the EGL context current.";
+        throw OpenGLError();
+    }
+}
+
+void HeadlessContext::release()
+{
+    eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+}
+
+#else
+
+HeadlessContext::HeadlessContext()
+:
+m_display(0),
+m_context(0),
+m_surface(0)
+{
+    LOG(logERROR) << "Headless rendering requires building with EGL.";
+    throw OpenGLError();
+}
+
+HeadlessContext::~HeadlessContext()
+{
+}
+
+void HeadlessContext::makeCurrent()
+{
+}
+
+void HeadlessContext::release()
+{
+}
+
+#endif // HAVE_EGL
@@ -0,0 +1,54 @@
+#ifndef HEADLESSCONTEXT_H
+#define HEADLESSCONTEXT_H
+
+#include "../common.h"
+
+namespace gamefw {
+
+/**
+ * @brief OpenGL 3.3 core context without a window.
+ *
+ * Lets the renderer run in CI, on render farm nodes or over SSH. Created
+ * through EGL on Mesa's surfaceless platform when available, which also works
+ * with llvmpipe when there is no GPU, otherwise on the default display. The
+ * context is made current without a surface, or with a 1x1 pbuffer where
+ * surfaceless contexts aren't supported. Rendering has to go to framebuffer
+ * objects.
+ *
+ * Requires building with EGL (HAVE_EGL).
+ **/
+class HeadlessContext
+{
+public:
+    /**
+     * @brief Creates the context and makes it current.
+     *
+     * @throw OpenGLError If no context could be created.
+     **/
+    HeadlessContext();
+    ~HeadlessContext();
+
+    /**
+     * @brief Makes the context current on the calling thread.
+     **/
+    void makeCurrent();
+
+    /**
+     * @brief Detaches the context from the calling thread, so another thread
+     * can make it current.
+     **/
+    void release();
+
+private:
+    HeadlessContext(const HeadlessContext&);
+    HeadlessContext& operator=(const HeadlessContext&);
+
+    // EGL handles, kept opaque so EGL headers stay out of the interface.
+    void* m_display;
+    void* m_context;
+    void* m_surface;
+};
+
+}
+
+#endif // HEADLESSCONTEXT_H
@@ -36,6 +36,18 @@ gamefw::LevelFile::LevelFile(string path)
         m_pointlights.push_back(pointlight);
         pointlightelement = levelhandle.Child("pointlight", num_pointlights++).ToElement();
     }
+
+    buildEntityHierarchy();
+}
+
+gamefw::LevelFile::LevelFile()
+{
+}
+
+void gamefw::LevelFile::buildEntityHierarchy()
+{
+    m_entity_hierarchy = shared_ptr<BoundingVolumeHierarchy>(
+        new BoundingVolumeHierarchy(m_entities));
 }
 
 shared_ptr< gamefw::Entity > gamefw::LevelFile::createEntity(const TiXmlElement& entityelement)
@@ -82,5 +94,12 @@ shared_ptr< gamefw::PointLight > gamefw::LevelFile::createPointLight(const TiXml
     istringstream intensity(intensity_str);
     intensity >> pointlight->m_intensity;
 
+    // Assign optional attenuation radius.
+    const TiXmlNode* radius_node = pointlightelement.FirstChild("radius");
+    if (radius_node) {
+        istringstream radius(radius_node->ToElement()->GetText());
+        radius >> pointlight->m_radius;
+    }
+
     return pointlight;
 }
\ No newline at end of file
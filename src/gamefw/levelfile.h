@@ -9,6 +9,7 @@
 
 #include "igameworld.h"
 #include "pointlight.h"
+#include "boundingvolumehierarchy.h"
 
 namespace gamefw {
     
@@ -37,9 +38,28 @@ public:
      **/
     LevelFile(string path);
 
+    /**
+     * @brief Creates an empty level to be filled in code. Call
+     * buildEntityHierarchy() once the entities are added.
+     **/
+    LevelFile();
+
+    /**
+     * @brief Builds m_entity_hierarchy over m_entities.
+     **/
+    void buildEntityHierarchy();
+
     vector<shared_ptr<Entity> > m_entities;
     vector<shared_ptr<PointLight> > m_pointlights;
     map<string, shared_ptr<Entity> > m_loaded_entities;
+
+    /**
+     * @brief Hierarchy over m_entities, built when the level is loaded.
+     *
+     * Meant to be passed to Renderer::addToRenderQueue every frame instead of
+     * queueing the entities one by one. Call refit() on it if they move.
+     **/
+    shared_ptr<BoundingVolumeHierarchy> m_entity_hierarchy;
     
 private:
     shared_ptr<Entity> createEntity(const TiXmlElement& entityelement);
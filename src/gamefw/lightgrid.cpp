@@ -0,0 +1,181 @@
+#include "lightgrid.h"
+
+#include <cfloat>
+
+using namespace gamefw;
+
+LightGrid::LightGrid(const uint size_x, const uint size_y, const uint size_z)
+:
+m_size_x(size_x),
+m_size_y(size_y),
+m_size_z(size_z),
+m_near_z(1.0f),
+m_far_z(1000.0f),
+m_slice_scale(0.0f),
+m_slice_bias(0.0f),
+m_num_lights(0),
+m_clusters(size_x * size_y * size_z * 2, 0)
+{
+}
+
+void LightGrid::setView(const glm::mat4& view, const glm::mat4& projection,
+                        const float near_z, const float far_z)
+{
+    m_view = view;
+    m_projection = projection;
+    m_frustum = Frustum(projection);
+    m_near_z = near_z;
+    m_far_z = far_z;
+    m_slice_scale = m_size_z / glm::log(far_z / near_z);
+    m_slice_bias = -glm::log(near_z) * m_slice_scale;
+
+    m_num_lights = 0;
+    m_ranges.clear();
+    m_range_lights.clear();
+}
+
+uint LightGrid::addLight(const glm::vec3& position, const float radius)
+{
+    const uint index = m_num_lights++;
+
+    // View space looks down -z.
+    glm::vec3 center(m_view * glm::vec4(position, 1.0f));
+    float min_depth = -center.z - radius;
+    float max_depth = -center.z + radius;
+    if (max_depth < m_near_z || min_depth > m_far_z ||
+        !m_frustum.intersects(center, glm::vec3(radius, radius, radius))) {
+        return index; // Not in view.
+    }
+
+    ClusterRange range;
+    range.min_z = getSlice(min_depth);
+    range.max_z = getSlice(max_depth);
+
+    if (min_depth <= m_near_z) {
+        // Crosses the near plane, so its projection is unbounded.
+        range.min_x = 0;
+        range.max_x = m_size_x - 1;
+        range.min_y = 0;
+        range.max_y = m_size_y - 1;
+    } else {
+        // Project the corners of the sphere's view space box.
+        glm::vec2 ndc_min(FLT_MAX, FLT_MAX), ndc_max(-FLT_MAX, -FLT_MAX);
+        for (int corner = 0; corner < 8; corner++) {
+            glm::vec4 point(center.x + (corner & 1 ? radius : -radius),
+                            center.y + (corner & 2 ? radius : -radius),
+                            center.z + (corner & 4 ? radius : -radius),
+                            1.0f);
+            glm::vec4 clip = m_projection * point;
+            glm::vec2 ndc(clip.x / clip.w, clip.y / clip.w);
+            ndc_min = glm::min(ndc_min, ndc);
+            ndc_max = glm::max(ndc_max, ndc);
+        }
+        if (ndc_max.x < -1.0f || ndc_min.x > 1.0f ||
+            ndc_max.y < -1.0f || ndc_min.y > 1.0f) {
+            return index; // Outside the sides of the frustum.
+        }
+        range.min_x = getTile(ndc_min.x, m_size_x);
+        range.max_x = getTile(ndc_max.x, m_size_x);
+        range.min_y = getTile(ndc_min.y, m_size_y);
+        range.max_y = getTile(ndc_max.y, m_size_y);
+    }
+
+    m_ranges.push_back(range);
+    m_range_lights.push_back(index);
+    return index;
+}
+
+void LightGrid::build()
+{
+    // Count the lights of each cluster.
+    std::fill(m_clusters.begin(), m_clusters.end(), 0);
+    uint total = 0;
+    foreach (const ClusterRange& range, m_ranges) {
+        for (uint z = range.min_z; z <= range.max_z; z++) {
+            for (uint y = range.min_y; y <= range.max_y; y++) {
+                uint row = (z * m_size_y + y) * m_size_x;
+                for (uint x = range.min_x; x <= range.max_x; x++) {
+                    m_clusters[(row + x) * 2 + 1]++;
+                }
+            }
+        }
+        total += (range.max_x - range.min_x + 1) *
+                 (range.max_y - range.min_y + 1) *
+                 (range.max_z - range.min_z + 1);
+    }
+
+    // Offsets by prefix sum. The counts are refilled below.
+    uint offset = 0;
+    for (uint i = 0; i < m_clusters.size(); i += 2) {
+        m_clusters[i] = offset;
+        offset += m_clusters[i + 1];
+        m_clusters[i + 1] = 0;
+    }
+
+    m_light_indices.resize(total);
+    for (uint i = 0; i < m_ranges.size(); i++) {
+        const ClusterRange& range = m_ranges[i];
+        for (uint z = range.min_z; z <= range.max_z; z++) {
+            for (uint y = range.min_y; y <= range.max_y; y++) {
+                uint row = (z * m_size_y + y) * m_size_x;
+                for (uint x = range.min_x; x <= range.max_x; x++) {
+                    uint* cluster = &m_clusters[(row + x) * 2];
+                    m_light_indices[cluster[0] + cluster[1]++] = m_range_lights[i];
+                }
+            }
+        }
+    }
+}
+
+const vector<uint>& LightGrid::getClusters() const
+{
+    return m_clusters;
+}
+
+const vector<uint>& LightGrid::getLightIndices() const
+{
+    return m_light_indices;
+}
+
+uint LightGrid::getNumLights() const
+{
+    return m_num_lights;
+}
+
+uint LightGrid::getSizeX() const
+{
+    return m_size_x;
+}
+
+uint LightGrid::getSizeY() const
+{
+    return m_size_y;
+}
+
+uint LightGrid::getSizeZ() const
+{
+    return m_size_z;
+}
+
+float LightGrid::getSliceScale() const
+{
+    return m_slice_scale;
+}
+
+float LightGrid::getSliceBias() const
+{
+    return m_slice_bias;
+}
+
+uint LightGrid::getSlice(const float depth) const
+{
+    float clamped = glm::clamp(depth, m_near_z, m_far_z);
+    int slice = (int) (glm::log(clamped) * m_slice_scale + m_slice_bias);
+    return glm::clamp(slice, 0, (int) m_size_z - 1);
+}
+
+uint LightGrid::getTile(const float ndc, const uint size) const
+{
+    int tile = (int) ((ndc * 0.5f + 0.5f) * size);
+    return glm::clamp(tile, 0, (int) size - 1);
+}
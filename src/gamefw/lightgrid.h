@@ -0,0 +1,108 @@
+#ifndef LIGHTGRID_H
+#define LIGHTGRID_H
+
+#include "../common.h"
+
+#include "frustum.h"
+
+namespace gamefw {
+
+/**
+ * @brief Bins lights into a view space froxel grid for clustered shading.
+ *
+ * The view frustum is split into tiles on screen and exponentially spaced
+ * depth slices. Each cluster stores a range in a shared light index list, so
+ * a pixel only shades the lights whose bounding sphere reaches its cluster.
+ **/
+class LightGrid
+{
+public:
+    /**
+     * @param size_x Number of tiles along the screen width.
+     * @param size_y Number of tiles along the screen height.
+     * @param size_z Number of depth slices.
+     **/
+    LightGrid(const uint size_x = 16, const uint size_y = 9,
+              const uint size_z = 24);
+
+    /**
+     * @brief Sets the view lights are binned in and removes all lights.
+     *
+     * @param view View transform.
+     * @param projection Perspective projection.
+     * @param near_z Distance to the near plane.
+     * @param far_z Distance to the far plane.
+     **/
+    void setView(const glm::mat4& view, const glm::mat4& projection,
+                 const float near_z, const float far_z);
+
+    /**
+     * @brief Adds a light. Call build() once all lights are added.
+     *
+     * @param position World space position.
+     * @param radius Distance beyond which the light doesn't contribute.
+     * @return Index of the light, as referred to in getLightIndices().
+     **/
+    uint addLight(const glm::vec3& position, const float radius);
+
+    /**
+     * @brief Fills the clusters with the lights added since setView().
+     **/
+    void build();
+
+    /**
+     * @return Offset into getLightIndices() and light count for every
+     *         cluster, x varying fastest.
+     **/
+    const vector<uint>& getClusters() const;
+
+    /**
+     * @return Light indices of all clusters, back to back.
+     **/
+    const vector<uint>& getLightIndices() const;
+
+    /**
+     * @return Number of lights added.
+     **/
+    uint getNumLights() const;
+
+    uint getSizeX() const;
+    uint getSizeY() const;
+    uint getSizeZ() const;
+
+    /**
+     * @brief Scale and bias giving a view depth's slice as
+     *        log(depth) * scale + bias.
+     **/
+    float getSliceScale() const;
+    float getSliceBias() const;
+
+private:
+    /// Clusters covered by one light, inclusive.
+    struct ClusterRange {
+        uint min_x, max_x, min_y, max_y, min_z, max_z;
+    };
+
+    uint getSlice(const float depth) const;
+    uint getTile(const float ndc, const uint size) const;
+
+    const uint m_size_x, m_size_y, m_size_z;
+
+    glm::mat4 m_view;
+    glm::mat4 m_projection;
+    /// View space frustum.
+    Frustum m_frustum;
+    float m_near_z, m_far_z;
+    float m_slice_scale, m_slice_bias;
+
+    uint m_num_lights;
+    vector<ClusterRange> m_ranges;
+    vector<uint> m_range_lights;
+
+    vector<uint> m_clusters;
+    vector<uint> m_light_indices;
+};
+
+}
+
+#endif // LIGHTGRID_H
@@ -0,0 +1,85 @@
+#include "materialregistry.h"
+
+#include "debugoutput.h"
+
+using namespace gamefw;
+
+const uint MaterialRegistry::CAPACITY;
+
+/// What tells materials apart, leaving out the padding.
+static vector<GLfloat> materialKey(const t_obj_mtl& material)
+{
+    vector<GLfloat> key(material.diffuse, material.diffuse + 4);
+    key.insert(key.end(), material.specular, material.specular + 4);
+    key.push_back(material.shininess);
+    return key;
+}
+
+MaterialRegistry::MaterialRegistry()
+:
+m_num_uploaded(0),
+m_buffer(0)
+{
+
+}
+
+MaterialRegistry::~MaterialRegistry()
+{
+    if (m_buffer != 0) {
+        glDeleteBuffers(1, &m_buffer);
+    }
+}
+
+GLuint MaterialRegistry::add(const t_obj_mtl& material)
+{
+    vector<GLfloat> key = materialKey(material);
+    std::map<vector<GLfloat>, GLuint>::iterator result = m_indices.find(key);
+    if (result != m_indices.end()) {
+        return result->second;
+    }
+    if (m_materials.size() == CAPACITY) {
+        LOG(logWARNING) << "More than " << CAPACITY
+                        << " distinct materials, using the first instead.";
+        return 0;
+    }
+    GLuint index = m_materials.size();
+    m_materials.push_back(material);
+    m_indices[key] = index;
+    return index;
+}
+
+uint MaterialRegistry::size() const
+{
+    return m_materials.size();
+}
+
+const t_obj_mtl& MaterialRegistry::getMaterial(const GLuint index) const
+{
+    return m_materials[index];
+}
+
+void MaterialRegistry::upload()
+{
+    if (m_buffer == 0) {
+        // Allocated whole, the uniform block always declares CAPACITY.
+        glGenBuffers(1, &m_buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+        glBufferData(GL_UNIFORM_BUFFER, CAPACITY * sizeof(t_obj_mtl), 0,
+                     GL_STATIC_DRAW);
+        DebugOutput::label(GL_BUFFER, m_buffer, "Materials");
+    } else {
+        glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+    }
+    if (m_num_uploaded < m_materials.size()) {
+        glBufferSubData(GL_UNIFORM_BUFFER, m_num_uploaded * sizeof(t_obj_mtl),
+                        (m_materials.size() - m_num_uploaded) * sizeof(t_obj_mtl),
+                        &m_materials[m_num_uploaded]);
+        m_num_uploaded = m_materials.size();
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+GLuint MaterialRegistry::getBuffer() const
+{
+    return m_buffer;
+}
@@ -0,0 +1,72 @@
+#ifndef MATERIALREGISTRY_H
+#define MATERIALREGISTRY_H
+
+#include "../common.h"
+#include "../ogl.h"
+#include "../util/objfile.h"
+
+#include <map>
+
+namespace gamefw {
+
+/**
+ * @brief Uniform buffer holding the materials of every loaded model, each
+ * distinct material once.
+ *
+ * Vertices refer to materials by their index here. All meshes with
+ * materials therefore share one shader program and one uniform block
+ * binding, and can be drawn together. Materials with the same colors and
+ * shininess share an index, whichever .mtl file they come from.
+ **/
+class MaterialRegistry
+{
+public:
+    /// Materials the uniform block holds. 256 of them fit in the 16 KiB
+    /// every OpenGL 3.3 implementation supports.
+    static const uint CAPACITY = 256;
+
+    MaterialRegistry();
+    ~MaterialRegistry();
+
+    /**
+     * @brief Finds a material with the same content, or adds it. Makes no
+     * OpenGL calls.
+     *
+     * @param material ditto.
+     * @return Index of the material. Once CAPACITY materials are registered,
+     *         new ones are logged and get index 0.
+     **/
+    GLuint add(const t_obj_mtl& material);
+
+    /**
+     * @return Number of distinct materials.
+     **/
+    uint size() const;
+
+    const t_obj_mtl& getMaterial(const GLuint index) const;
+
+    /**
+     * @brief Uploads the materials added since the last upload, creating the
+     * buffer the first time. Requires a current OpenGL context.
+     **/
+    void upload();
+
+    /**
+     * @return The uniform buffer, 0 before the first upload().
+     **/
+    GLuint getBuffer() const;
+
+private:
+    MaterialRegistry(const MaterialRegistry&);
+    MaterialRegistry& operator=(const MaterialRegistry&);
+
+    vector<t_obj_mtl> m_materials;
+    /// Index of each material by its content.
+    std::map<vector<GLfloat>, GLuint> m_indices;
+    uint m_num_uploaded;
+    GLuint m_buffer;
+};
+
+}
+
+#endif // MATERIALREGISTRY_H
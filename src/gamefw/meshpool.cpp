@@ -0,0 +1,123 @@
+#include "meshpool.h"
+
+#include "debugoutput.h"
+
+using namespace gamefw;
+
+/// Initial sizes of the buffers in bytes, doubled as needed.
+const GLsizeiptr INITIAL_VERTEX_CAPACITY = 1 << 20;
+const GLsizeiptr INITIAL_ELEMENT_CAPACITY = 1 << 18;
+
+MeshPool::MeshPool(const string& name, const GLsizei vertex_size,
+                   const AttributeSetup setup_attributes)
+:
+m_name(name),
+m_vertex_size(vertex_size),
+m_setup_attributes(setup_attributes),
+m_vertex_array(0),
+m_vertex_buffer(0),
+m_element_buffer(0),
+m_vertex_capacity(INITIAL_VERTEX_CAPACITY),
+m_element_capacity(INITIAL_ELEMENT_CAPACITY),
+m_num_vertices(0),
+m_num_elements(0)
+{
+    glGenVertexArrays(1, &m_vertex_array);
+    glGenBuffers(1, &m_vertex_buffer);
+    glGenBuffers(1, &m_element_buffer);
+
+    glBindVertexArray(m_vertex_array);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vertex_buffer);
+    glBufferData(GL_ARRAY_BUFFER, m_vertex_capacity, 0, GL_STATIC_DRAW);
+    m_setup_attributes();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_element_buffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_element_capacity, 0, GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    DebugOutput::label(GL_VERTEX_ARRAY, m_vertex_array, m_name);
+    DebugOutput::label(GL_BUFFER, m_vertex_buffer, m_name + " vertices");
+    DebugOutput::label(GL_BUFFER, m_element_buffer, m_name + " elements");
+}
+
+MeshPool::~MeshPool()
+{
+    glDeleteVertexArrays(1, &m_vertex_array);
+    glDeleteBuffers(1, &m_vertex_buffer);
+    glDeleteBuffers(1, &m_element_buffer);
+}
+
+MeshPool::Range MeshPool::add(const void* vertices, const uint num_vertices,
+                              const GLushort* elements, const uint num_elements)
+{
+    const GLsizeiptr vertex_offset = (GLsizeiptr) m_num_vertices * m_vertex_size;
+    const GLsizeiptr vertex_size = (GLsizeiptr) num_vertices * m_vertex_size;
+    const GLsizeiptr element_offset = m_num_elements * sizeof(GLushort);
+    const GLsizeiptr element_size = num_elements * sizeof(GLushort);
+    reserve(m_vertex_buffer, GL_ARRAY_BUFFER, m_vertex_capacity, vertex_offset,
+            vertex_offset + vertex_size);
+    reserve(m_element_buffer, GL_ELEMENT_ARRAY_BUFFER, m_element_capacity,
+            element_offset, element_offset + element_size);
+
+    // Uploaded through the copy target, leaving the vertex array alone.
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_vertex_buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, vertex_offset, vertex_size, vertices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_element_buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, element_offset, element_size, elements);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    Range range;
+    range.first_index = m_num_elements;
+    range.num_indices = num_elements;
+    range.base_vertex = m_num_vertices;
+    m_num_vertices += num_vertices;
+    m_num_elements += num_elements;
+    return range;
+}
+
+GLuint MeshPool::getVertexArray() const
+{
+    return m_vertex_array;
+}
+
+size_t MeshPool::getMemoryUsage() const
+{
+    return (size_t) m_num_vertices * m_vertex_size +
+           m_num_elements * sizeof(GLushort);
+}
+
+void MeshPool::reserve(GLuint& buffer, const GLenum target,
+                       GLsizeiptr& capacity, const GLsizeiptr used,
+                       const GLsizeiptr size)
+{
+    if (size <= capacity) {
+        return;
+    }
+    while (capacity < size) {
+        capacity *= 2;
+    }
+    LOG(logINFO) << "Growing " << m_name << " buffer to " << capacity
+                 << " bytes.";
+
+    GLuint new_buffer = 0;
+    glGenBuffers(1, &new_buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, new_buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, capacity, 0, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffers(1, &buffer);
+    buffer = new_buffer;
+
+    // The vertex array refers to the buffers themselves.
+    glBindVertexArray(m_vertex_array);
+    glBindBuffer(target, buffer);
+    if (target == GL_ARRAY_BUFFER) {
+        m_setup_attributes();
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    glBindVertexArray(0);
+    DebugOutput::label(GL_BUFFER, buffer, m_name + (target == GL_ARRAY_BUFFER ?
+                                                    " vertices" : " elements"));
+}
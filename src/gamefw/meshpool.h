@@ -0,0 +1,89 @@
+#ifndef MESHPOOL_H
+#define MESHPOOL_H
+
+#include "../common.h"
+#include "../ogl.h"
+
+namespace gamefw {
+
+/**
+ * @brief Vertex and element buffer shared by many meshes of one vertex
+ * layout, with a vertex array reading them.
+ *
+ * Meshes are appended one after the other, each with its own 16 bit
+ * elements offset by a base vertex, so meshes drawn with the same program
+ * can go in one multi-draw. The buffers grow by copying into larger ones,
+ * keeping the vertex array. Space of meshes no longer drawn isn't reclaimed.
+ **/
+class MeshPool
+{
+public:
+    /**
+     * @brief Points the vertex attributes of a layout at the bound
+     * GL_ARRAY_BUFFER, starting at offset 0.
+     **/
+    typedef void (*AttributeSetup)();
+
+    /// Where a mesh lies in the pool.
+    struct Range {
+        /// Offset of the first element, in elements.
+        GLuint first_index;
+        GLsizei num_indices;
+        /// Added to each element.
+        GLint base_vertex;
+    };
+
+    /**
+     * @brief Creates the buffers and the vertex array. Requires a current
+     * OpenGL context.
+     *
+     * @param name Labels the OpenGL objects.
+     * @param vertex_size Bytes per vertex.
+     * @param setup_attributes Sets up the layout. Called again when the
+     *        vertex buffer is replaced.
+     **/
+    MeshPool(const string& name, const GLsizei vertex_size,
+             const AttributeSetup setup_attributes);
+    ~MeshPool();
+
+    /**
+     * @brief Uploads a mesh. Growing the buffers leaves vertex array 0
+     * bound.
+     *
+     * @param vertices num_vertices vertices of the pool's layout.
+     * @param num_vertices ditto.
+     * @param elements Indices into vertices.
+     * @param num_elements ditto.
+     * @return Where the mesh went.
+     **/
+    Range add(const void* vertices, const uint num_vertices,
+              const GLushort* elements, const uint num_elements);
+
+    GLuint getVertexArray() const;
+
+    /**
+     * @return Bytes taken by the vertices and elements added so far.
+     **/
+    size_t getMemoryUsage() const;
+
+private:
+    MeshPool(const MeshPool&);
+    MeshPool& operator=(const MeshPool&);
+
+    /// Grows a buffer to hold at least size bytes, keeping its contents.
+    void reserve(GLuint& buffer, const GLenum target, GLsizeiptr& capacity,
+                 const GLsizeiptr used, const GLsizeiptr size);
+
+    string m_name;
+    GLsizei m_vertex_size;
+    AttributeSetup m_setup_attributes;
+    GLuint m_vertex_array;
+    GLuint m_vertex_buffer, m_element_buffer;
+    /// Sizes in bytes.
+    GLsizeiptr m_vertex_capacity, m_element_capacity;
+    uint m_num_vertices, m_num_elements;
+};
+
+}
+
+#endif // MESHPOOL_H
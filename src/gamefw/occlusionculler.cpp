@@ -0,0 +1,358 @@
+#include "occlusionculler.h"
+
+#include <algorithm>
+#include <cfloat>
+
+#include "simd.h"
+
+using namespace gamefw;
+
+/// Tile size in pixels. The width is a multiple of the widest SIMD width.
+const uint TILE_WIDTH = 32;
+const uint TILE_HEIGHT = 16;
+const uint MAX_RASTER_THREADS = 4;
+const uint MIN_TRIANGLES_PER_THREAD = 256;
+/// Window space depth where nothing has been drawn.
+const float FAR_DEPTH = 1.0f;
+
+static uint roundUp(const uint value, const uint multiple)
+{
+    return (std::max(value, 1u) + multiple - 1) / multiple * multiple;
+}
+
+OcclusionCuller::OcclusionCuller(const uint width, const uint height)
+:
+m_width(roundUp(width, TILE_WIDTH)),
+m_height(roundUp(height, TILE_HEIGHT)),
+m_tiles_x(m_width / TILE_WIDTH),
+m_tiles_y(m_height / TILE_HEIGHT),
+m_bins(m_tiles_x * m_tiles_y),
+m_workers("Occlusion rasterizer", MAX_RASTER_THREADS - 1)
+{
+    // Halve down to 1x1, rounding up so odd sizes keep their last texel.
+    uint level_width = m_width, level_height = m_height;
+    while (true) {
+        Level level;
+        level.width = level_width;
+        level.height = level_height;
+        level.depth.resize(level_width * level_height, FAR_DEPTH);
+        m_levels.push_back(level);
+        if (level_width == 1 && level_height == 1) {
+            break;
+        }
+        level_width = (level_width + 1) / 2;
+        level_height = (level_height + 1) / 2;
+    }
+}
+
+void OcclusionCuller::beginFrame(const glm::mat4& viewprojection)
+{
+    m_viewprojection = viewprojection;
+    m_triangles.clear();
+    foreach (vector<uint>& bin, m_bins) {
+        bin.clear();
+    }
+    std::fill(m_levels[0].depth.begin(), m_levels[0].depth.end(), FAR_DEPTH);
+}
+
+void OcclusionCuller::addOccluder(const float* positions,
+                                  const unsigned short* indices,
+                                  const uint num_indices,
+                                  const glm::mat4& model)
+{
+    const glm::mat4 transform = m_viewprojection * model;
+    for (uint i = 0; i + 2 < num_indices; i += 3) {
+        glm::vec4 clip[3];
+        for (uint v = 0; v < 3; v++) {
+            const float* p = positions + indices[i + v] * 3;
+            clip[v] = transform * glm::vec4(p[0], p[1], p[2], 1.0f);
+        }
+
+        // Clipped against the near plane z = -w, leaving a triangle or a
+        // quad. Occluders next to the camera hide the most.
+        glm::vec4 polygon[4];
+        uint num_vertices = 0;
+        for (uint v = 0; v < 3; v++) {
+            const glm::vec4& current = clip[v];
+            const glm::vec4& next = clip[(v + 1) % 3];
+            const float current_distance = current.z + current.w;
+            const float next_distance = next.z + next.w;
+            if (current_distance >= 0.0f) {
+                polygon[num_vertices++] = current;
+            }
+            if ((current_distance >= 0.0f) != (next_distance >= 0.0f)) {
+                const float t = current_distance /
+                                (current_distance - next_distance);
+                polygon[num_vertices++] = current + (next - current) * t;
+            }
+        }
+        for (uint v = 2; v < num_vertices; v++) {
+            addTriangle(polygon[0], polygon[v - 1], polygon[v]);
+        }
+    }
+}
+
+void OcclusionCuller::addTriangle(const glm::vec4& clip0, const glm::vec4& clip1,
+                                  const glm::vec4& clip2)
+{
+    const glm::vec4* clip[] = {&clip0, &clip1, &clip2};
+    float x[3], y[3], z[3];
+    for (uint v = 0; v < 3; v++) {
+        const glm::vec4& position = *clip[v];
+        if (position.w <= 0.0f) { // Degenerate projections only.
+            return;
+        }
+        // Window space, pixel centers at half coordinates.
+        x[v] = (position.x / position.w * 0.5f + 0.5f) * m_width;
+        y[v] = (position.y / position.w * 0.5f + 0.5f) * m_height;
+        z[v] = position.z / position.w * 0.5f + 0.5f;
+    }
+
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (area == 0.0f) {
+        return;
+    }
+
+    // Clamped as floats, vertices clipped at the near plane can lie far
+    // off screen.
+    const float min_x = std::min(x[0], std::min(x[1], x[2]));
+    const float min_y = std::min(y[0], std::min(y[1], y[2]));
+    const float max_x = std::max(x[0], std::max(x[1], x[2]));
+    const float max_y = std::max(y[0], std::max(y[1], y[2]));
+    if (max_x < 0.0f || max_y < 0.0f || min_x > m_width || min_y > m_height) {
+        return; // Off screen.
+    }
+    Triangle triangle;
+    triangle.min_x = (int) std::floor(std::max(min_x, 0.0f));
+    triangle.min_y = (int) std::floor(std::max(min_y, 0.0f));
+    triangle.max_x = std::min((int) std::ceil(max_x), (int) m_width - 1);
+    triangle.max_y = std::min((int) std::ceil(max_y), (int) m_height - 1);
+    if (triangle.min_x > triangle.max_x || triangle.min_y > triangle.max_y) {
+        return;
+    }
+
+    // Edge functions a * x + b * y + c, positive inside whatever the
+    // winding, so occluders are double sided.
+    const float sign = area > 0.0f ? 1.0f : -1.0f;
+    for (uint e = 0; e < 3; e++) {
+        uint next = (e + 1) % 3;
+        triangle.edge_a[e] = sign * (y[e] - y[next]);
+        triangle.edge_b[e] = sign * (x[next] - x[e]);
+        triangle.edge_c[e] = sign * (x[e] * y[next] - y[e] * x[next]);
+    }
+
+    // Depth is affine in window space after the perspective divide.
+    triangle.depth_a = ((z[1] - z[0]) * (y[2] - y[0]) -
+                        (z[2] - z[0]) * (y[1] - y[0])) / area;
+    triangle.depth_b = ((z[2] - z[0]) * (x[1] - x[0]) -
+                        (z[1] - z[0]) * (x[2] - x[0])) / area;
+    triangle.depth_c = z[0] - triangle.depth_a * x[0] - triangle.depth_b * y[0];
+
+    const uint index = m_triangles.size();
+    m_triangles.push_back(triangle);
+    for (uint ty = triangle.min_y / TILE_HEIGHT;
+         ty <= (uint) triangle.max_y / TILE_HEIGHT; ty++) {
+        for (uint tx = triangle.min_x / TILE_WIDTH;
+             tx <= (uint) triangle.max_x / TILE_WIDTH; tx++) {
+            m_bins[ty * m_tiles_x + tx].push_back(index);
+        }
+    }
+}
+
+void OcclusionCuller::rasterize()
+{
+    PROFILE_ZONE("OcclusionCuller::rasterize");
+    const uint num_threads = std::min(MAX_RASTER_THREADS,
+        std::max(1u, (uint) m_triangles.size() / MIN_TRIANGLES_PER_THREAD));
+
+    // Tiles are interleaved between the threads, so occluders covering only
+    // part of the screen still spread over all of them.
+    vector<TileTask> tasks(num_threads);
+    for (uint i = 0; i < num_threads; i++) {
+        tasks[i].culler = this;
+        tasks[i].first_tile = i;
+        tasks[i].tile_stride = num_threads;
+    }
+    m_workers.run(&rasterizeTiles, &tasks[0], num_threads);
+
+    buildPyramid();
+}
+
+void OcclusionCuller::rasterizeTiles(TileTask* task)
+{
+    OcclusionCuller& culler = *task->culler;
+    for (uint tile = task->first_tile; tile < culler.m_bins.size();
+         tile += task->tile_stride) {
+        culler.rasterizeTile(tile);
+    }
+}
+
+void OcclusionCuller::rasterizeTile(const uint tile)
+{
+    const int tile_x0 = (tile % m_tiles_x) * TILE_WIDTH;
+    const int tile_y0 = (tile / m_tiles_x) * TILE_HEIGHT;
+    float* depth = &m_levels[0].depth[0];
+
+#ifdef GAMEFW_SIMD
+    float lane_offsets[SIMD_WIDTH];
+    for (uint i = 0; i < SIMD_WIDTH; i++) {
+        lane_offsets[i] = (float) i;
+    }
+    const simd_float lanes = simdLoad(lane_offsets);
+    const simd_float zero = simdSet(0.0f);
+#endif // GAMEFW_SIMD
+
+    foreach (uint index, m_bins[tile]) {
+        const Triangle& t = m_triangles[index];
+        const int y0 = std::max(t.min_y, tile_y0);
+        const int y1 = std::min(t.max_y, tile_y0 + (int) TILE_HEIGHT - 1);
+        const int x1 = std::min(t.max_x, tile_x0 + (int) TILE_WIDTH - 1);
+#ifdef GAMEFW_SIMD
+        // Start on a SIMD boundary within the tile, lanes left of the
+        // triangle fail the edge tests.
+        const int x0 = tile_x0 + (std::max(t.min_x, tile_x0) - tile_x0) /
+                       (int) SIMD_WIDTH * SIMD_WIDTH;
+        const simd_float step_x0 = simdMul(simdSet(t.edge_a[0]), lanes);
+        const simd_float step_x1 = simdMul(simdSet(t.edge_a[1]), lanes);
+        const simd_float step_x2 = simdMul(simdSet(t.edge_a[2]), lanes);
+        const simd_float step_depth = simdMul(simdSet(t.depth_a), lanes);
+#else
+        const int x0 = std::max(t.min_x, tile_x0);
+#endif // GAMEFW_SIMD
+
+        for (int y = y0; y <= y1; y++) {
+            const float py = y + 0.5f;
+            float* row = depth + y * m_width;
+#ifdef GAMEFW_SIMD
+            for (int x = x0; x <= x1; x += SIMD_WIDTH) {
+                const float px = x + 0.5f;
+                simd_float e0 = simdAdd(simdSet(t.edge_a[0] * px + t.edge_b[0] * py +
+                                                t.edge_c[0]), step_x0);
+                simd_float e1 = simdAdd(simdSet(t.edge_a[1] * px + t.edge_b[1] * py +
+                                                t.edge_c[1]), step_x1);
+                simd_float e2 = simdAdd(simdSet(t.edge_a[2] * px + t.edge_b[2] * py +
+                                                t.edge_c[2]), step_x2);
+                simd_float outside = simdOr(simdLess(e0, zero),
+                                            simdOr(simdLess(e1, zero),
+                                                   simdLess(e2, zero)));
+                if (simdMoveMask(outside) == (1 << SIMD_WIDTH) - 1) {
+                    continue;
+                }
+                simd_float z = simdAdd(simdSet(t.depth_a * px + t.depth_b * py +
+                                               t.depth_c), step_depth);
+                // Outside lanes become NaN, and min keeps its second operand
+                // when the first is NaN, so only covered pixels change.
+                z = simdOr(z, outside);
+                simdStore(row + x, simdMin(z, simdLoad(row + x)));
+            }
+#else
+            for (int x = x0; x <= x1; x++) {
+                const float px = x + 0.5f;
+                if (t.edge_a[0] * px + t.edge_b[0] * py + t.edge_c[0] < 0.0f ||
+                    t.edge_a[1] * px + t.edge_b[1] * py + t.edge_c[1] < 0.0f ||
+                    t.edge_a[2] * px + t.edge_b[2] * py + t.edge_c[2] < 0.0f) {
+                    continue;
+                }
+                float z = t.depth_a * px + t.depth_b * py + t.depth_c;
+                row[x] = std::min(z, row[x]);
+            }
+#endif // GAMEFW_SIMD
+        }
+    }
+}
+
+void OcclusionCuller::buildPyramid()
+{
+    for (uint l = 1; l < m_levels.size(); l++) {
+        const Level& source = m_levels[l - 1];
+        Level& level = m_levels[l];
+        for (uint y = 0; y < level.height; y++) {
+            const uint sy0 = y * 2;
+            const uint sy1 = std::min(sy0 + 1, source.height - 1);
+            for (uint x = 0; x < level.width; x++) {
+                const uint sx0 = x * 2;
+                const uint sx1 = std::min(sx0 + 1, source.width - 1);
+                level.depth[y * level.width + x] = std::max(
+                    std::max(source.depth[sy0 * source.width + sx0],
+                             source.depth[sy0 * source.width + sx1]),
+                    std::max(source.depth[sy1 * source.width + sx0],
+                             source.depth[sy1 * source.width + sx1]));
+            }
+        }
+    }
+}
+
+bool OcclusionCuller::isVisible(const glm::vec3& center,
+                                const glm::vec3& half_extents) const
+{
+    float min_x = FLT_MAX, min_y = FLT_MAX, max_x = -FLT_MAX, max_y = -FLT_MAX;
+    float min_depth = FLT_MAX;
+    for (uint corner = 0; corner < 8; corner++) {
+        glm::vec3 offset((corner & 1) ? half_extents.x : -half_extents.x,
+                         (corner & 2) ? half_extents.y : -half_extents.y,
+                         (corner & 4) ? half_extents.z : -half_extents.z);
+        glm::vec4 clip = m_viewprojection * glm::vec4(center + offset, 1.0f);
+        if (clip.z < -clip.w || clip.w <= 0.0f) { // Crosses the near plane.
+            return true;
+        }
+        float x = (clip.x / clip.w * 0.5f + 0.5f) * m_width;
+        float y = (clip.y / clip.w * 0.5f + 0.5f) * m_height;
+        min_x = std::min(min_x, x);
+        max_x = std::max(max_x, x);
+        min_y = std::min(min_y, y);
+        max_y = std::max(max_y, y);
+        min_depth = std::min(min_depth, clip.z / clip.w * 0.5f + 0.5f);
+    }
+
+    if (max_x < 0.0f || max_y < 0.0f || min_x >= m_width || min_y >= m_height) {
+        return true; // Off screen, leave it to frustum culling.
+    }
+    uint x0 = (uint) std::max(min_x, 0.0f);
+    uint y0 = (uint) std::max(min_y, 0.0f);
+    uint x1 = (uint) std::min(max_x, m_width - 1.0f);
+    uint y1 = (uint) std::min(max_y, m_height - 1.0f);
+
+    // Coarsest level where the rectangle still spans at most 2x2 texels
+    // along each axis, so only a few are read.
+    uint l = 0;
+    while (l + 1 < m_levels.size() &&
+           ((x1 >> l) - (x0 >> l) > 1 || (y1 >> l) - (y0 >> l) > 1)) {
+        l++;
+    }
+
+    const Level& level = m_levels[l];
+    for (uint y = y0 >> l; y <= y1 >> l; y++) {
+        for (uint x = x0 >> l; x <= x1 >> l; x++) {
+            if (level.depth[y * level.width + x] >= min_depth) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+uint OcclusionCuller::getWidth() const
+{
+    return m_width;
+}
+
+uint OcclusionCuller::getHeight() const
+{
+    return m_height;
+}
+
+uint OcclusionCuller::getNumTriangles() const
+{
+    return m_triangles.size();
+}
+
+float OcclusionCuller::getDepth(const uint level, const uint x, const uint y) const
+{
+    const Level& source = m_levels[level];
+    return source.depth[y * source.width + x];
+}
+
+uint OcclusionCuller::getNumLevels() const
+{
+    return m_levels.size();
+}
@@ -0,0 +1,145 @@
+#ifndef OCCLUSIONCULLER_H
+#define OCCLUSIONCULLER_H
+
+#include "../common.h"
+
+#include "workerpool.h"
+
+namespace gamefw {
+
+/**
+ * @brief Software occlusion culling against a low resolution depth buffer.
+ *
+ * A few large meshes marked as occluders are rasterized on the CPU into a
+ * small depth buffer, split into tiles that are filled in parallel with SIMD
+ * edge functions. A hierarchical-Z pyramid, each level keeping the farthest
+ * depth of four texels of the previous one, is built from it. Boxes are then
+ * tested against the pyramid level where their screen rectangle covers a few
+ * texels, so objects hidden behind the occluders are rejected before they
+ * are drawn, without waiting on the GPU.
+ *
+ * Occluder triangles crossing the near plane are clipped against it. Boxes
+ * crossing it are always visible, so culling errs on drawing too much.
+ *
+ * Usage:
+ * \code
+ * culler.beginFrame(projection * view);
+ * foreach (occluder, occluders) culler.addOccluder(...);
+ * culler.rasterize();
+ * if (culler.isVisible(center, half_extents)) ...
+ * \endcode
+ **/
+class OcclusionCuller
+{
+public:
+    /**
+     * @param width Depth buffer width, rounded up to a multiple of the tile
+     *        width.
+     * @param height Depth buffer height, rounded up to a multiple of the
+     *        tile height.
+     **/
+    OcclusionCuller(const uint width = 256, const uint height = 128);
+
+    /**
+     * @brief Clears the occluders and the depth buffer.
+     *
+     * @param viewprojection Transform from world to clip space.
+     **/
+    void beginFrame(const glm::mat4& viewprojection);
+
+    /**
+     * @brief Adds the triangles of an occluder.
+     *
+     * @param positions Model space positions, x, y and z of each vertex.
+     * @param indices Three per triangle.
+     * @param num_indices ditto.
+     * @param model Model transform of the instance.
+     **/
+    void addOccluder(const float* positions, const unsigned short* indices,
+                     const uint num_indices, const glm::mat4& model);
+
+    /**
+     * @brief Rasterizes the added occluders and builds the pyramid.
+     **/
+    void rasterize();
+
+    /**
+     * @brief Tests a world space box against the occluders rasterized last.
+     *
+     * @param center ditto.
+     * @param half_extents ditto.
+     * @return False if the box is completely behind the occluders.
+     **/
+    bool isVisible(const glm::vec3& center, const glm::vec3& half_extents) const;
+
+    uint getWidth() const;
+    uint getHeight() const;
+
+    /**
+     * @return Number of triangles binned since beginFrame().
+     **/
+    uint getNumTriangles() const;
+
+    /**
+     * @brief Farthest occluder depth of a texel of the pyramid.
+     *
+     * @param level 0 is the full resolution depth buffer.
+     * @param x ditto.
+     * @param y ditto.
+     * @return Window space depth in [0, 1], 1 where nothing was drawn.
+     **/
+    float getDepth(const uint level, const uint x, const uint y) const;
+
+    uint getNumLevels() const;
+
+private:
+    OcclusionCuller(const OcclusionCuller&);
+    OcclusionCuller& operator=(const OcclusionCuller&);
+
+    /// Screen space setup of a triangle, edges and depth as planes.
+    struct Triangle {
+        float edge_a[3], edge_b[3], edge_c[3];
+        float depth_a, depth_b, depth_c;
+        int min_x, min_y, max_x, max_y;
+    };
+
+    struct Level {
+        uint width, height;
+        vector<float> depth;
+    };
+
+    struct TileTask {
+        OcclusionCuller* culler;
+        uint first_tile;
+        uint tile_stride;
+    };
+
+    /**
+     * @brief Sets up and bins a triangle in front of the near plane.
+     *
+     * @param clip0 Clip space vertex.
+     * @param clip1 ditto.
+     * @param clip2 ditto.
+     **/
+    void addTriangle(const glm::vec4& clip0, const glm::vec4& clip1,
+                     const glm::vec4& clip2);
+    static void rasterizeTiles(TileTask* task);
+    void rasterizeTile(const uint tile);
+    void buildPyramid();
+
+    uint m_width, m_height;
+    uint m_tiles_x, m_tiles_y;
+    glm::mat4 m_viewprojection;
+
+    vector<Triangle> m_triangles;
+    /// Indices into m_triangles of those overlapping each tile.
+    vector<vector<uint> > m_bins;
+    /// Level 0 is the depth buffer itself.
+    vector<Level> m_levels;
+    /// Rasterize tiles alongside the thread calling rasterize().
+    WorkerPool m_workers;
+};
+
+}
+
+#endif // OCCLUSIONCULLER_H
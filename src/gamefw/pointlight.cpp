@@ -1,10 +1,14 @@
 #include "pointlight.h"
 
+/// Contribution at which a light with a derived radius is cut off.
+const float LIGHT_CUTOFF = 0.01f;
+
 gamefw::PointLight::PointLight()
         :
         Entity(),
         m_color(1.0, 1.0, 1.0),
-        m_intensity(100.0)
+        m_intensity(100.0),
+        m_radius(0.0)
 {
 }
 
@@ -12,7 +16,8 @@ gamefw::PointLight::PointLight(const gamefw::Entity& entity)
         :
         Entity(entity),
         m_color(1.0, 1.0, 1.0),
-        m_intensity(100.0)
+        m_intensity(100.0),
+        m_radius(0.0)
 {
 
 }
@@ -22,4 +27,14 @@ gamefw::PointLight::~PointLight()
 
 }
 
+float gamefw::PointLight::getRadius() const
+{
+    if (m_radius > 0.0f) {
+        return m_radius;
+    }
+    // Inverse square falloff: intensity * color / d^2 = cutoff.
+    float brightest = glm::max(m_color.r, glm::max(m_color.g, m_color.b));
+    return glm::sqrt(m_intensity * brightest / LIGHT_CUTOFF);
+}
+
 
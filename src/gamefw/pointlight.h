@@ -15,8 +15,20 @@ public:
     
     virtual ~PointLight();
 
+    /**
+     * @return m_radius, or if it's zero the distance where the light's
+     *         contribution falls to 1/100.
+     **/
+    float getRadius() const;
+
     glm::vec3 m_color;
     float m_intensity;
+
+    /**
+     * @brief Distance beyond which the light doesn't contribute. Zero derives
+     * it from the intensity.
+     **/
+    float m_radius;
 };
     
 }
@@ -2,13 +2,94 @@
 #include "../common.h"
 #include "gamefw.h"
 
+#include <algorithm>
+
+#include <SFML/System.hpp>
+
 #include <glm/gtx/projection.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/euler_angles.hpp>
 
 using namespace gamefw;
 
-const int POINTLIGHTS_IDX = 0;
+// Texture buffers of the clustered lighting, in the order of the enum.
+const GLenum LIGHT_BUFFER_FORMATS[] = {GL_RG32UI, GL_R32UI, GL_RGBA32F};
+const char* LIGHT_BUFFER_UNIFORMS[] = {"light_clusters", "light_indices",
+                                       "light_data"};
+/// Texture unit of the G-buffer depth, after the G-buffer color textures.
+const GLuint GBUFFER_DEPTH_UNIT = 3;
+/// Texture unit of the bloom chain in the final composite.
+const GLuint BLOOM_UNIT = 4;
+/// Texture unit of the first light buffer, after the G-buffer textures.
+const GLuint LIGHT_BUFFER_UNIT = 5;
+/// Initial size of each light buffer in bytes, grown as needed.
+const GLsizeiptr LIGHT_BUFFER_SIZE = 1 << 16;
+/// Largest texel of the light buffer formats, the least a range may hold.
+const GLsizeiptr LIGHT_TEXEL_SIZE = 16;
+
+/// Light volumes are drawn slightly larger than the light radius, the sphere
+/// mesh is a polyhedron that lies partly inside its circumscribed sphere.
+const GLfloat LIGHT_VOLUME_SCALE = 1.1f;
+/// Floats per light in the light data buffer.
+const uint LIGHT_DATA_STRIDE = 8;
+
+// Bloom chain.
+const uint MAX_BLOOM_LEVELS = 8;
+const uint DEFAULT_BLOOM_LEVELS = 5;
+
+const char* RENDER_PASS_NAMES[] = {"GPU culling", "Depth pre-pass", "G-buffer",
+                                   "Lighting", "Post-processing", "Bloom",
+                                   "Composite"};
+/// Reported for every pass when nothing is timed.
+const TimingStats NO_TIMINGS;
+
+/// Initial size of each frame's section in the ring buffer, grown as needed.
+const GLsizeiptr RING_BUFFER_FRAME_SIZE = 1 << 20;
+
+// Projection parameters.
+const GLfloat FOV = 60.0f;
+const GLfloat NEAR_Z = 1.0f;
+const GLfloat FAR_Z = 1000.f;
+
+// Command recording threads, used once there are enough visible entities.
+const uint MAX_RECORDING_THREADS = 4;
+const uint MIN_ENTITIES_PER_THREAD = 2048;
+
+/// Layout of glMultiDrawElementsIndirect's commands.
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instance_count;
+    GLuint first_index;
+    GLint base_vertex;
+    GLuint base_instance;
+};
+
+/// Rounds an offset up to the next multiple of the alignment.
+static GLsizeiptr alignOffset(const GLsizeiptr offset, const GLsizeiptr alignment)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+/// Size of the scaled viewport along one axis of the display.
+static GLuint scaledSize(const GLuint size, const float scale)
+{
+    return std::max((GLuint) (size * scale + 0.5f), 1u);
+}
+
+/// Texture coordinates of the last texel centers of the scaled viewport in a
+/// target, render_texcoord_max in uber.f.glsl.
+static glm::vec2 scaledTexcoordMax(const GLuint width, const GLuint height,
+                                   const float scale)
+{
+    return glm::vec2((scaledSize(width, scale) - 0.5f) / width,
+                     (scaledSize(height, scale) - 0.5f) / height);
+}
+
+/// Size of a bloom level along one axis of the display.
+static GLuint bloomLevelSize(const GLuint display_size, const uint level)
+{
+    return std::max(display_size >> (level + 1), 1u);
+}
 
 Renderer::Renderer(const GLuint display_width, const GLuint display_height,
                    OpenGLVersion opengl_version)
@@ -17,341 +98,617 @@ m_display_width(display_width),
 m_display_height(display_height),
 m_camera(new Entity),
 m_aspect_ratio((float) display_width / (float) display_height),
-m_opengl_version(opengl_version)
+m_opengl_version(opengl_version),
+m_render_graph_dirty(true),
+m_num_draws(0),
+m_multi_draw(false),
+m_multi_draw_supported(false),
+m_gpu_culling(false),
+m_num_command_buffers(0),
+m_recording_workers("Command recording", MAX_RECORDING_THREADS - 1),
+m_frame(0),
+m_bloom(true),
+m_bloom_levels(DEFAULT_BLOOM_LEVELS),
+m_bloom_threshold(0.0f),
+m_antialiasing(true),
+m_fused_postprocessing(true),
+m_render_scale(1.0f),
+m_dynamic_resolution(true),
+m_lighting_mode(CLUSTERED_LIGHTING),
+m_occlusion_culling(true),
+m_depth_prepass(false),
+m_num_culled(0)
 {
-    // Don't write to zbuffer for transparent objects.
-    glAlphaFunc (GL_GREATER, 0.1) ;
-    glEnable (GL_ALPHA_TEST) ;
+    m_statistics.draw_calls = 0;
+    m_statistics.state_changes = 0;
+    m_statistics.cull_ms = 0.0f;
+    m_statistics.gl_calls = m_state.getCounters();
+    m_fbo.output = 0;
+    m_output_renderbuffers[0] = m_output_renderbuffers[1] = 0;
+    m_instances.size = m_draw_commands.size = m_draw_bounds.size = 0;
+    // Per draw data is the instance range, read through base instances.
+    m_multi_draw_supported = m_opengl_version == OGL_3_3 &&
+                             GLEW_ARB_multi_draw_indirect &&
+                             GLEW_ARB_base_instance;
+    m_multi_draw = m_multi_draw_supported;
+
     glClearColor(0.0,0.0,0.0,0.0);
     m_camera->setName("Camera");
     if (m_opengl_version == OGL_3_3) {
-        initBuffers(display_width, display_height);
+        initBuffers();
     }
 }
 
 Renderer::~Renderer()
 {
     if (m_opengl_version == OGL_3_3) {
-        glDeleteRenderbuffers(1, &m_depth_stencil_buffers.gbuffer);
-        glDeleteRenderbuffers(1, &m_depth_stencil_buffers.pbuffer);
-        glDeleteFramebuffers(1, &m_fbo.gbuffer);
-        glDeleteFramebuffers(1, &m_fbo.pbuffer);
-        glDeleteFramebuffers(1, &m_fbo.ppbuffer);
-
-        // Delete manually allocated textures.
-        shared_ptr<RenderJob> gbuffer_renderjob = m_gbuffer.getRenderJob();
-        glDeleteTextures(gbuffer_renderjob->m_num_textures,
-                        gbuffer_renderjob->m_textures);
-        delete [] gbuffer_renderjob->m_textures;
-        gbuffer_renderjob->m_num_textures = 0;
-
-        shared_ptr<RenderJob> pbuffer_renderjob = m_pbuffer.getRenderJob();
-        glDeleteTextures(pbuffer_renderjob->m_num_textures,
-                        pbuffer_renderjob->m_textures);
-        delete [] pbuffer_renderjob->m_textures;
-        pbuffer_renderjob->m_num_textures = 0;
-
-        shared_ptr<RenderJob> ppbuffer_renderjob = m_ppbuffer.getRenderJob();
-        // Shared textures with gbuffer.
-        ppbuffer_renderjob->m_num_textures = 0;
-    }
-}
-
-void Renderer::createDepthStencilBuffer(GLuint* buffer, const GLuint width,
-                                        const GLuint height)
-{
-    glGenRenderbuffers(1, buffer);
-    glBindRenderbuffer(GL_RENDERBUFFER, m_depth_stencil_buffers.gbuffer);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH32F_STENCIL8, width, height);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER,
-                              GL_DEPTH_STENCIL_ATTACHMENT,
-                              GL_RENDERBUFFER, m_depth_stencil_buffers.gbuffer);
-}
-
-void Renderer::texParametersForRenderTargets() const
-{
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1000);
-}
-bool Renderer::checkFramebuffer() const
-{
-    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-    string error = "Framebuffer object error: ";
-
-    switch (status)
-    {
-    case GL_FRAMEBUFFER_UNDEFINED:
-        LOG(logERROR) << error << "GL_FRAMEBUFFER_UNDEFINED";
-        break;
-    case GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT:
-        LOG(logERROR) << error << "GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT";
-        break;
-    case GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT:
-        LOG(logERROR) << error << "GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT";
-        break;
-    case GL_FRAMEBUFFER_INCOMPLETE_DRAW_BUFFER:
-        LOG(logERROR) << error << "GL_FRAMEBUFFER_INCOMPLETE_DRAW_BUFFER";
-        break;
-    case GL_FRAMEBUFFER_INCOMPLETE_READ_BUFFER:
-        LOG(logERROR) << error << "GL_FRAMEBUFFER_INCOMPLETE_READ_BUFFER";
-        break;
-    case GL_FRAMEBUFFER_UNSUPPORTED:
-        LOG(logERROR) << error << "GL_FRAMEBUFFER_UNSUPPORTED";
-        break;
-    case GL_FRAMEBUFFER_INCOMPLETE_MULTISAMPLE:
-        LOG(logERROR) << error << "GL_FRAMEBUFFER_INCOMPLETE_MULTISAMPLE";
-        break;
-    case GL_FRAMEBUFFER_INCOMPLETE_LAYER_TARGETS:
-        LOG(logERROR) << error << "GL_FRAMEBUFFER_INCOMPLETE_LAYER_TARGETS";
-        break;
-    }
-
-    return status == GL_FRAMEBUFFER_COMPLETE;
-}
-
-void Renderer::createTexturesForFBO(shared_ptr<RenderJob> renderjob,
-                                    const GLuint num_textures,
-                                    const GLenum internalformats[],
-                                    const GLuint size_divisor[],
-                                    const GLenum types[])
-{
-    renderjob->m_textures = new GLuint[num_textures];
-    renderjob->m_num_textures = num_textures;
-    glGenTextures(num_textures, renderjob->m_textures);
-
-    for (uint i = 0; i < num_textures; i++) {
-        glBindTexture(GL_TEXTURE_2D, renderjob->m_textures[i]);
-
-        texParametersForRenderTargets();
-
-        glTexImage2D(
-            GL_TEXTURE_2D,
-            0,
-            internalformats[i],
-            m_display_width / size_divisor[i],
-            m_display_height / size_divisor[i],
-            0,
-            GL_RGB,
-            types[i],
-            0
-        );
-
-        GLint attachment = GL_COLOR_ATTACHMENT0 + i;
-
-        glFramebufferTexture(GL_FRAMEBUFFER, attachment,
-                             renderjob->m_textures[i], 0);
-    }
-}
-
-void Renderer::initBuffers(const GLuint width, const GLuint height)
-{
-    GLenum draw_buffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1,
-                             GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3,
-                             GL_COLOR_ATTACHMENT4, GL_COLOR_ATTACHMENT5,
-                             GL_COLOR_ATTACHMENT6, GL_COLOR_ATTACHMENT7};
-    
-    // GBUFFER STAGE
-
-    {
-        int num_textures = 5;
-        
-        m_gbuffer = *Locator::getFileService().createEntity("gbuffer");
-        glGenFramebuffers(1, &m_fbo.gbuffer);
-        glBindFramebuffer(GL_FRAMEBUFFER, m_fbo.gbuffer);
-
-        const GLenum internalformats[] = {
-            GL_RGB8,
-            GL_RGB8,
-            GL_RGB16F,
-            GL_RGB32F,
-            GL_RGB8
-        };
-        const GLuint size_divisor[] = {1, 1, 1, 1, 1};
-        const GLenum types[] = {
-            GL_UNSIGNED_BYTE,
-            GL_UNSIGNED_BYTE,
-            GL_FLOAT,
-            GL_FLOAT,
-            GL_UNSIGNED_BYTE
-        };
-        
-        glActiveTexture(GL_TEXTURE0);
-        shared_ptr<RenderJob> gbuffer_renderjob = m_gbuffer.getRenderJob();
-        
-        createTexturesForFBO(gbuffer_renderjob, num_textures, internalformats,
-                             size_divisor, types);
+        if (m_fbo.output != 0) {
+            glDeleteFramebuffers(1, &m_fbo.output);
+            glDeleteRenderbuffers(2, m_output_renderbuffers);
+        }
+        m_ring_buffer.reset();
+        m_gpu_culler.reset();
+        glDeleteTextures(NUM_LIGHT_BUFFERS, m_light_textures);
+        m_gpu_timer.reset();
+        glDeleteBuffers(NUM_LIGHT_BUFFERS, m_light_buffers);
+        // The render targets go with m_render_graph.
+    }
+}
 
-        createDepthStencilBuffer(&m_depth_stencil_buffers.gbuffer, width, height);
+void Renderer::initBuffers()
+{
+    // Fullscreen passes, their render targets come from buildRenderGraph().
+    m_gbuffer = *Locator::getFileService().createEntity("gbuffer");
+    m_pbuffer = *Locator::getFileService().createEntity("pbuffer");
+    m_ppbuffer = *Locator::getFileService().createEntity("ppbuffer");
+    m_fused_composite = *Locator::getFileService().createEntity("fusedcomposite");
+    // Reads the whole G-buffer like the lighting pass.
+    m_light_volume = *Locator::getFileService().createEntity("lightvolume");
+    initBloom();
+
+    m_gpu_timer.reset(new GpuTimer(NUM_RENDER_PASSES));
+
+    // Instance transforms, rewritten every frame.
+    m_ring_buffer.reset(new RingBuffer(RING_BUFFER_FRAME_SIZE));
+
+    // Culls what the multi-draws draw.
+    if (m_multi_draw_supported && GpuCuller::isSupported()) {
+        try {
+            m_gpu_culler.reset(new GpuCuller(m_display_width, m_display_height));
+            m_gpu_culling = true;
+        } catch (const ShaderProgramCreationError&) {
+            LOG(logERROR) << "Culling on the CPU instead.";
+        }
+    }
 
-        bool status = checkFramebuffer();
-        assert(status);
-        GLuint gbuffer_program = gbuffer_renderjob->getShaderProgramID();
-        
-        // Bind uniform block for pointlights.
-        GLuint material_location = glGetUniformBlockIndex(gbuffer_program,
-                                                          "pointlights");
-        assert(material_location != GL_INVALID_INDEX);
-        glGenBuffers(1, &m_uniform_blocks.pointlights);
-
-        // Attach the UBO to pointlights index.
-        glBindBufferBase(GL_UNIFORM_BUFFER, POINTLIGHTS_IDX,
-                         m_uniform_blocks.pointlights);
-        // Associate the block in the GLSL source to this index.
-        glUniformBlockBinding(gbuffer_program, material_location, POINTLIGHTS_IDX);
-        
-        // Assign draw buffers.
-        glDrawBuffers(num_textures, draw_buffers);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // Clustered lighting. The texture buffers view ranges of m_ring_buffer,
+    // or without texture buffer ranges buffers of their own.
+    m_light_buffer_ranges = GLEW_ARB_texture_buffer_range;
+    glGenTextures(NUM_LIGHT_BUFFERS, m_light_textures);
+    for (uint i = 0; i < NUM_LIGHT_BUFFERS; i++) {
+        m_light_buffers[i] = 0;
+        m_light_buffer_sizes[i] = 0;
+        if (!m_light_buffer_ranges) {
+            glGenBuffers(1, &m_light_buffers[i]);
+            glBindBuffer(GL_TEXTURE_BUFFER, m_light_buffers[i]);
+            glBufferData(GL_TEXTURE_BUFFER, LIGHT_BUFFER_SIZE, 0, GL_STREAM_DRAW);
+            m_light_buffer_sizes[i] = LIGHT_BUFFER_SIZE;
+            glBindTexture(GL_TEXTURE_BUFFER, m_light_textures[i]);
+            glTexBuffer(GL_TEXTURE_BUFFER, LIGHT_BUFFER_FORMATS[i],
+                        m_light_buffers[i]);
+            DebugOutput::label(GL_BUFFER, m_light_buffers[i],
+                               LIGHT_BUFFER_UNIFORMS[i]);
+        }
+        DebugOutput::label(GL_TEXTURE, m_light_textures[i], LIGHT_BUFFER_UNIFORMS[i]);
     }
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
 
-    // PBUFFER STAGE.
-    {
-        int num_textures = 4;
-        
-        m_pbuffer = *Locator::getFileService().createEntity("pbuffer");
-
-        glGenFramebuffers(1, &m_fbo.pbuffer);
-        glBindFramebuffer(GL_FRAMEBUFFER, m_fbo.pbuffer);
-
-        glActiveTexture(GL_TEXTURE0);
-        shared_ptr<RenderJob> pbuffer_renderjob = m_pbuffer.getRenderJob();
-
-        const GLenum internalformats[] = {
-            GL_RGB8,
-            GL_RGB8,
-            GL_RGB8,
-            GL_RGB8
-        };
-        const GLuint size_divisors[] = {1, 1, 1, 1};
-        const GLenum types[] = {
-            GL_UNSIGNED_BYTE,
-            GL_UNSIGNED_BYTE,
-            GL_UNSIGNED_BYTE,
-            GL_UNSIGNED_BYTE
-        };
-
-        createTexturesForFBO(pbuffer_renderjob, num_textures, internalformats,
-            size_divisors, types
-        );
-    
-        createDepthStencilBuffer(&m_depth_stencil_buffers.pbuffer, width, height);
-
-        bool status = checkFramebuffer();
-        assert(status);
-        
-        // Assign draw buffers.
-        glDrawBuffers(num_textures, draw_buffers);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    checkOpenGLError();
+}
 
+void Renderer::buildRenderGraph()
+{
+    m_render_graph.clear();
+
+    // Diffuse, specular with the packed shininess and flags, octahedral
+    // normals. Positions come from the depth.
+    m_targets.depth = m_render_graph.addTexture("Depth",
+                                                RenderGraph::DEPTH32F_STENCIL8);
+    m_targets.gbuffer[0] = m_render_graph.addTexture("G-buffer diffuse",
+                                                     RenderGraph::RGBA8);
+    m_targets.gbuffer[1] = m_render_graph.addTexture("G-buffer specular",
+                                                     RenderGraph::RGBA8);
+    m_targets.gbuffer[2] = m_render_graph.addTexture("G-buffer normal",
+                                                     RenderGraph::RG16);
+    // Lit diffuse and specular, and the edges to antialias.
+    m_targets.lit[0] = m_render_graph.addTexture("Lit diffuse", RenderGraph::RGB8);
+    m_targets.lit[1] = m_render_graph.addTexture("Lit specular", RenderGraph::RGB8);
+    m_targets.lit[2] = m_render_graph.addTexture("Edges", RenderGraph::R8);
+    uint antialiased[2];
+    antialiased[0] = m_render_graph.addTexture("Antialiased diffuse",
+                                               RenderGraph::RGB8);
+    antialiased[1] = m_render_graph.addTexture("Antialiased specular",
+                                               RenderGraph::RGB8);
+    m_targets.bloom.clear();
+    for (uint level = 0; level < m_bloom_levels; level++) {
+        stringstream name;
+        name << "Bloom level " << level;
+        m_targets.bloom.push_back(m_render_graph.addTexture(
+            name.str(), RenderGraph::R11F_G11F_B10F, level + 1));
     }
 
-    // POSTPROCESSING STAGE
-    {
-        int num_textures = 2;
-        m_ppbuffer = *Locator::getFileService().createEntity("ppbuffer");
-        shared_ptr<RenderJob> ppbuffer_renderjob = m_ppbuffer.getRenderJob();
+    m_passes.depth_prepass = RenderGraph::CULLED;
+    if (m_depth_prepass) {
+        m_passes.depth_prepass = m_render_graph.addPass("Depth pre-pass");
+        m_render_graph.write(m_passes.depth_prepass, m_targets.depth);
+    }
 
-        // Use gbuffers diffuse and specular textures.
-        m_fbo.ppbuffer = m_fbo.gbuffer;
-        ppbuffer_renderjob->m_textures = m_gbuffer.getRenderJob()->m_textures;
-        ppbuffer_renderjob->m_num_textures = num_textures;
+    m_passes.gbuffer = m_render_graph.addPass("G-buffer");
+    for (uint i = 0; i < 3; i++) {
+        m_render_graph.write(m_passes.gbuffer, m_targets.gbuffer[i]);
+    }
+    m_render_graph.write(m_passes.gbuffer, m_targets.depth);
+
+    // Light volumes are depth and stencil tested against the scene's depth
+    // while reconstructing positions from it. A texture attached to the
+    // framebuffer drawn to can't be sampled, so they sample a copy.
+    m_passes.depth_copy = RenderGraph::CULLED;
+    m_targets.sampled_depth = m_targets.depth;
+    if (m_lighting_mode == LIGHT_VOLUMES) {
+        m_targets.sampled_depth = m_render_graph.addTexture(
+            "Depth copy", RenderGraph::DEPTH32F_STENCIL8);
+        m_passes.depth_copy = m_render_graph.addPass("Depth copy");
+        m_render_graph.read(m_passes.depth_copy, m_targets.depth);
+        m_render_graph.write(m_passes.depth_copy, m_targets.sampled_depth);
     }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    checkOpenGLError();
+    m_passes.lighting = m_render_graph.addPass("Lighting");
+    for (uint i = 0; i < 3; i++) {
+        m_render_graph.read(m_passes.lighting, m_targets.gbuffer[i]);
+        m_render_graph.write(m_passes.lighting, m_targets.lit[i]);
+    }
+    m_render_graph.read(m_passes.lighting, m_targets.sampled_depth);
+    if (m_lighting_mode == LIGHT_VOLUMES) {
+        m_render_graph.write(m_passes.lighting, m_targets.depth);
+    }
+
+    m_passes.antialiasing = m_render_graph.addPass("Antialiasing");
+    for (uint i = 0; i < 3; i++) {
+        m_render_graph.read(m_passes.antialiasing, m_targets.lit[i]);
+    }
+    m_render_graph.write(m_passes.antialiasing, antialiased[0]);
+    m_render_graph.write(m_passes.antialiasing, antialiased[1]);
+
+    // Without the pass nothing reads its results, culling it, and without
+    // antialiasing the edges too. Fused, the composite antialiases the lit
+    // diffuse itself. Only the diffuse is antialiased, the specular goes on
+    // as it is.
+    bool antialiasing_pass = m_antialiasing && !m_fused_postprocessing;
+    for (uint i = 0; i < 2; i++) {
+        m_targets.final[i] = antialiasing_pass ? antialiased[i] : m_targets.lit[i];
+    }
+
+    m_passes.bloom_prefilter = m_render_graph.addPass("Bloom prefilter");
+    m_render_graph.read(m_passes.bloom_prefilter, m_targets.final[1]);
+    m_render_graph.write(m_passes.bloom_prefilter, m_targets.bloom[0]);
+    m_passes.bloom_downsample.assign(m_bloom_levels, RenderGraph::CULLED);
+    for (uint level = 1; level < m_bloom_levels; level++) {
+        uint pass = m_render_graph.addPass("Bloom downsample");
+        m_render_graph.read(pass, m_targets.bloom[level - 1]);
+        m_render_graph.write(pass, m_targets.bloom[level]);
+        m_passes.bloom_downsample[level] = pass;
+    }
+    m_passes.bloom_upsample.assign(m_bloom_levels, RenderGraph::CULLED);
+    for (int level = (int) m_bloom_levels - 2; level >= 0; level--) {
+        uint pass = m_render_graph.addPass("Bloom upsample");
+        m_render_graph.read(pass, m_targets.bloom[level + 1]);
+        m_render_graph.write(pass, m_targets.bloom[level]);
+        m_passes.bloom_upsample[level] = pass;
+    }
+
+    m_passes.composite = m_render_graph.addPass("Composite", true);
+    m_render_graph.read(m_passes.composite, m_targets.final[0]);
+    if (m_antialiasing && m_fused_postprocessing) {
+        m_render_graph.read(m_passes.composite, m_targets.lit[2]);
+    }
+    m_render_graph.read(m_passes.composite,
+                        m_bloom ? m_targets.bloom[0] : m_targets.final[1]);
+
+    m_render_graph.compile();
+    m_render_graph.createResources(m_display_width, m_display_height);
+    // Creating the resources binds textures and framebuffers.
+    m_state.invalidate();
+    LOG(logINFO) << "Render targets: "
+                 << m_render_graph.getNumPhysicalTextures() << " textures, "
+                 << m_render_graph.getMemoryUsage(m_display_width,
+                                                  m_display_height) / 1024
+                 << " KiB.";
+
+    setRenderTargets(m_gbuffer, m_targets.gbuffer, 3);
+    setRenderTargets(m_light_volume, m_targets.gbuffer, 3);
+    setRenderTargets(m_pbuffer, m_targets.lit, 3);
+    setRenderTargets(m_ppbuffer, m_targets.final, 2);
+    setRenderTargets(m_fused_composite, m_targets.lit, 3);
+    m_render_graph_dirty = false;
+}
+
+void Renderer::setRenderTargets(const Entity& entity, const uint targets[],
+                                const uint num_targets)
+{
+    shared_ptr<RenderJob> renderjob = entity.getRenderJob();
+    if (renderjob->m_num_textures > 0) {
+        delete [] renderjob->m_textures;
+    }
+    renderjob->m_textures = new GLuint[num_targets];
+    renderjob->m_num_textures = num_targets;
+    for (uint i = 0; i < num_targets; i++) {
+        renderjob->m_textures[i] = m_render_graph.getTexture(targets[i]);
+    }
 }
 
 void Renderer::render()
 {
-    if (m_opengl_version == OGL_3_3) {
-        glEnable(GL_DEPTH_TEST);
+    m_render_queue.setCamera(m_camera);
+    render(m_render_queue);
+    m_render_queue.clear();
+}
 
-        renderGBuffers();
+void Renderer::takeSnapshot(FrameSnapshot& snapshot)
+{
+    PROFILE_ZONE("Renderer::takeSnapshot");
+    m_render_queue.setCamera(m_camera);
+    snapshot.copy(m_render_queue);
+    m_render_queue.clear();
+}
 
-        glDisable(GL_DEPTH_TEST);
+void Renderer::render(const FrameSnapshot& snapshot)
+{
+    PROFILE_ZONE("Renderer::render");
+    m_frame = &snapshot;
+    m_statistics.draw_calls = 0;
+    // The state may have changed since the last frame.
+    m_state.invalidate();
+    m_state.resetCounters();
+    updateCameraTransforms();
 
+    if (m_opengl_version == OGL_3_3) {
+        if (m_render_graph_dirty) {
+            buildRenderGraph();
+        }
+        m_ring_buffer->beginFrame();
+        if (m_gpu_timer->beginFrame()) {
+            updateRenderScale(m_gpu_timer->getFrameStats().getLatest());
+        }
+
+        // Everything up to the final pass only fills part of the targets.
+        glViewport(0, 0, scaledSize(m_display_width, m_render_scale),
+                   scaledSize(m_display_height, m_render_scale));
+
+        m_state.setEnabled(GL_DEPTH_TEST, true);
+
+        cullRenderQueue();
+        recordCommandBuffers();
+
+        if (isGpuCulling()) {
+            m_gpu_timer->begin(CULLING_PASS);
+            m_gpu_culler->cull(m_ring_buffer->getBufferID(), m_instances,
+                               m_draw_bounds, m_draw_commands,
+                               Frustum(m_projection * m_view),
+                               m_occlusion_culling, m_state);
+            m_gpu_timer->end();
+        }
+
+        if (m_depth_prepass) {
+            m_gpu_timer->begin(DEPTH_PREPASS);
+            renderDepthPrepass();
+            m_gpu_timer->end();
+        }
+
+        m_gpu_timer->begin(GBUFFER_PASS);
+        renderGBuffers();
+        if (isGpuCulling() && m_occlusion_culling) {
+            // What hides what in this frame, for the next one.
+            m_gpu_culler->buildDepthPyramid(
+                m_render_graph.getTexture(m_targets.depth), m_projection * m_view,
+                scaledSize(m_display_width, m_render_scale),
+                scaledSize(m_display_height, m_render_scale), m_state);
+        } else if (m_gpu_culler) {
+            m_gpu_culler->invalidateDepthPyramid();
+        }
+        m_gpu_timer->end();
+
+        m_state.setEnabled(GL_DEPTH_TEST, false);
+
+        m_gpu_timer->begin(LIGHTING_PASS);
         renderPBuffers();
-
-        renderPPBuffers();
+        m_gpu_timer->end();
+
+        if (!m_render_graph.isCulled(m_passes.antialiasing)) {
+            m_gpu_timer->begin(POSTPROCESSING_PASS);
+            renderPPBuffers();
+            m_gpu_timer->end();
+        }
+
+        if (!m_render_graph.isCulled(m_passes.bloom_prefilter)) {
+            m_gpu_timer->begin(BLOOM_PASS);
+            renderBloom();
+            m_gpu_timer->end();
+        }
         
-        glBindFramebuffer(GL_FRAMEBUFFER, 0); // Bind main window's framebuffer.
+        m_gpu_timer->begin(COMPOSITE_PASS);
+        m_state.bindFramebuffer(GL_FRAMEBUFFER, m_fbo.output); // Usually the window's.
+        glViewport(0, 0, m_display_width, m_display_height);
         glClearColor(0.0, 0.0, 0.0, 1.0);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
-        renderEntity(m_ppbuffer);
+        const Entity& composite = m_antialiasing && m_fused_postprocessing ?
+                                  m_fused_composite : m_ppbuffer;
+        GLuint program_id = composite.getRenderJob()->getShaderProgramID();
+        m_state.useProgram(program_id);
+        bindBloom(program_id);
+        renderEntity(composite);
+        m_gpu_timer->end();
+
+        m_ring_buffer->endFrame();
     } else {
         renderRenderQueue();
     }
+
+    // Nothing outside the renderer draws with these.
+    m_state.bindVertexArray(0);
+    m_state.useProgram(0);
+    const StateCache::Counters& gl_calls = m_state.getCounters();
+    m_statistics.gl_calls = gl_calls;
+    m_statistics.state_changes = gl_calls.issued[StateCache::USE_PROGRAM] +
+                                 gl_calls.issued[StateCache::BIND_TEXTURE] +
+                                 gl_calls.issued[StateCache::BIND_VERTEX_ARRAY];
+    m_frame = 0;
+}
+
+uint Renderer::getNumCulled() const
+{
+    return m_num_culled;
+}
+
+const RenderStatistics& Renderer::getStatistics() const
+{
+    return m_statistics;
+}
+
+void Renderer::setOcclusionCulling(const bool enabled)
+{
+    m_occlusion_culling = enabled;
+}
+
+void Renderer::setDepthPrepass(const bool enabled)
+{
+    m_render_graph_dirty = m_render_graph_dirty || enabled != m_depth_prepass;
+    m_depth_prepass = enabled;
+}
+
+void Renderer::setLightingMode(const LightingMode mode)
+{
+    m_render_graph_dirty = m_render_graph_dirty || mode != m_lighting_mode;
+    m_lighting_mode = mode;
+}
+
+void Renderer::setBloomRadius(const uint num_levels)
+{
+    uint bloom_levels = std::max(1u, std::min(num_levels, MAX_BLOOM_LEVELS));
+    m_render_graph_dirty = m_render_graph_dirty || bloom_levels != m_bloom_levels;
+    m_bloom_levels = bloom_levels;
+}
+
+void Renderer::setBloomThreshold(const float threshold)
+{
+    m_bloom_threshold = threshold;
+}
+
+void Renderer::setBloom(const bool enabled)
+{
+    m_render_graph_dirty = m_render_graph_dirty || enabled != m_bloom;
+    m_bloom = enabled;
+}
+
+void Renderer::setAntialiasing(const bool enabled)
+{
+    m_render_graph_dirty = m_render_graph_dirty || enabled != m_antialiasing;
+    m_antialiasing = enabled;
+}
+
+void Renderer::setFusedPostProcessing(const bool enabled)
+{
+    m_render_graph_dirty = m_render_graph_dirty || enabled != m_fused_postprocessing;
+    m_fused_postprocessing = enabled;
+}
+
+void Renderer::setMultiDraw(const bool enabled)
+{
+    m_multi_draw = enabled && m_multi_draw_supported;
+}
+
+bool Renderer::isMultiDrawSupported() const
+{
+    return m_multi_draw_supported;
+}
+
+void Renderer::setGpuCulling(const bool enabled)
+{
+    m_gpu_culling = enabled && m_gpu_culler;
+}
+
+bool Renderer::isGpuCullingSupported() const
+{
+    return m_gpu_culler;
+}
+
+bool Renderer::isGpuCulling() const
+{
+    return m_multi_draw && m_gpu_culling;
+}
+
+void Renderer::setTargetFrameTime(const float target_frame_time)
+{
+    m_dynamic_resolution = target_frame_time > 0.0f;
+    if (m_dynamic_resolution) {
+        m_resolution_scaler.setTargetFrameTime(target_frame_time);
+    } else {
+        m_render_scale = 1.0f;
+    }
+}
+
+float Renderer::getRenderScale() const
+{
+    return m_render_scale;
+}
+
+const TimingStats& Renderer::getPassTimings(const RenderPass pass) const
+{
+    if (!m_gpu_timer) {
+        return NO_TIMINGS;
+    }
+    return m_gpu_timer->getStats(pass);
+}
+
+const TimingStats& Renderer::getFrameTimings() const
+{
+    if (!m_gpu_timer) {
+        return NO_TIMINGS;
+    }
+    return m_gpu_timer->getFrameStats();
+}
+
+const char* Renderer::getPassName(const RenderPass pass)
+{
+    return RENDER_PASS_NAMES[pass];
+}
+
+void Renderer::enableOffscreenOutput()
+{
+    if (m_opengl_version != OGL_3_3 || m_fbo.output != 0) {
+        return;
+    }
+
+    glGenRenderbuffers(2, m_output_renderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_output_renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, m_display_width,
+                          m_display_height);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_output_renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8,
+                          m_display_width, m_display_height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &m_fbo.output);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo.output);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              GL_RENDERBUFFER, m_output_renderbuffers[0]);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                              GL_RENDERBUFFER, m_output_renderbuffers[1]);
+    glDrawBuffer(GL_COLOR_ATTACHMENT0);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    DebugOutput::label(GL_FRAMEBUFFER, m_fbo.output, "Output");
+    bool status = checkFramebuffer();
+    assert(status);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    checkOpenGLError();
+}
+
+void Renderer::readOutput(vector<unsigned char>& rgba) const
+{
+    const uint row_size = m_display_width * 4;
+    rgba.resize(row_size * m_display_height);
+    if (rgba.empty()) {
+        return;
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_fbo.output);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, m_display_width, m_display_height, GL_RGBA,
+                 GL_UNSIGNED_BYTE, &rgba[0]);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+    // OpenGL's rows start at the bottom.
+    vector<unsigned char> row(row_size);
+    for (uint y = 0; y < m_display_height / 2; y++) {
+        unsigned char* top = &rgba[y * row_size];
+        unsigned char* bottom = &rgba[(m_display_height - 1 - y) * row_size];
+        std::copy(top, top + row_size, row.begin());
+        std::copy(bottom, bottom + row_size, top);
+        std::copy(row.begin(), row.end(), bottom);
+    }
+}
+
+void Renderer::updateRenderScale(const float frame_time)
+{
+    if (m_dynamic_resolution) {
+        m_render_scale = m_resolution_scaler.update(frame_time);
+    }
 }
 
 void Renderer::addToRenderQueue(shared_ptr<Entity> entity)
 {
-    m_render_queue.push(entity);
+    m_render_queue.addEntity(entity);
+}
+
+void Renderer::addToRenderQueue(shared_ptr<BoundingVolumeHierarchy> hierarchy)
+{
+    m_render_queue.addHierarchy(hierarchy);
 }
 
 void Renderer::addToPointLightQueue(shared_ptr< PointLight > pointlight)
 {
-    m_pointlight_queue.push(pointlight);
+    m_render_queue.addPointLight(pointlight);
 }
 
 void Renderer::renderEntity(const Entity& entity)
 {
+    PROFILE_ZONE("Renderer::renderEntity");
     shared_ptr<RenderJob> renderjob = entity.getRenderJob();
+    bindRenderJob(*renderjob);
     GLuint program_id = renderjob->getShaderProgramID();
-    glUseProgram(program_id);
-
-    // Load textures.
-    for (uint i = 0; i < renderjob->m_num_textures; i++) {
-        glActiveTexture(GL_TEXTURE0 + i);
-        glBindTexture(GL_TEXTURE_2D, renderjob->m_textures[i]);
-        string uniform_name("texture");
-        uniform_name += (char) '0' + i;
-        GLint location = glGetUniformLocation(program_id, uniform_name.c_str());
-        glUniform1i(location, i);
-    }
-
 
     // Calculate and bind mvp.
-
-    // Model orientation ...
-   glm::mat4 model(glm::yawPitchRoll(entity.m_orientation.x,
-                                     entity.m_orientation.y,
-                                     entity.m_orientation.z));
-    // ... + translation
-    model[3] = glm::vec4(entity.m_position, 1.0);
+    glm::mat4 model = entity.getModelMatrix();
 
     // Normal transform.
     glm::mat4 normalmatrix = glm::transpose(glm::inverse(model));
 
-    // View transform.
-    glm::mat4 view_orientation_x(glm::rotate(glm::mat4(1.0f),
-                                             m_camera->m_orientation.y,
-                                             glm::vec3(-1.0f, 0.0f, 0.0f)));
-    glm::mat4 view_orientation(glm::rotate(view_orientation_x,
-                               m_camera->m_orientation.x,
-                               glm::vec3(0.0f, 1.0f, 0.0f)));
-    glm::mat4 view(glm::translate(view_orientation, -m_camera->m_position));
-
-    // Projection transform
-    const GLfloat FOV = 60.0f;
-    const GLfloat near_z = 1.0f;
-    const GLfloat far_z = 1000.f;
-    glm::mat4 projection = glm::perspective(FOV, m_aspect_ratio, near_z, far_z);
+    glm::mat4 mvp = m_projection * m_view * model;
 
-    glm::mat4 mvp = projection * view * model;
-
-    // Bind the matrices to uniforms.
+    // Bind the matrices to uniforms. The uber shader takes them as instance
+    // attributes instead, the fullscreen passes don't use them.
     GLint location_mvp = glGetUniformLocation(program_id, "mvp");
     glUniformMatrix4fv(location_mvp, 1, GL_FALSE, &mvp[0][0]);
     GLint location_model = glGetUniformLocation(program_id, "model");
     glUniformMatrix4fv(location_model, 1, GL_FALSE, &model[0][0]);
     GLint location_normalmatrix = glGetUniformLocation(program_id, "normalmatrix");
     glUniformMatrix4fv(location_normalmatrix, 1, GL_FALSE, &normalmatrix[0][0]);
+
+    glDrawElements(GL_TRIANGLES, renderjob->m_vertex_count, GL_UNSIGNED_SHORT, 0);
+    m_statistics.draw_calls++;
+}
+
+void Renderer::bindRenderJob(const RenderJob& renderjob)
+{
+    GLuint program_id = renderjob.getShaderProgramID();
+    useProgram(program_id);
+    bindTextures(program_id, renderjob);
+    bindMesh(renderjob);
+    // Drawn without instances, the matrices are uniforms or constant values.
+    setInstanceAttributes(false);
+}
+
+void Renderer::useProgram(const GLuint program_id)
+{
+    m_state.useProgram(program_id);
+
+    glm::mat4 viewprojection = m_projection * m_view;
+    GLint location_viewprojection = glGetUniformLocation(program_id,
+                                                         "viewprojection");
+    glUniformMatrix4fv(location_viewprojection, 1, GL_FALSE,
+                       &viewprojection[0][0]);
     glUniform3fv(glGetUniformLocation(program_id, "viewer_position"),
-                 1, &m_camera->m_position[0]);
+                 1, &m_frame->getCamera()->m_position[0]);
 
     // Bind display height and width uniforms.
     GLint location_width = glGetUniformLocation(program_id, "display_width");
@@ -359,105 +716,875 @@ void Renderer::renderEntity(const Entity& entity)
     GLint location_height = glGetUniformLocation(program_id, "display_height");
     glUniform1f(location_height, (GLfloat) m_display_height);
     GLint location_near_z = glGetUniformLocation(program_id, "near_z");
-    glUniform1f(location_near_z, (GLfloat) near_z);
+    glUniform1f(location_near_z, NEAR_Z);
     GLint location_far_z = glGetUniformLocation(program_id, "far_z");
-    glUniform1f(location_far_z, (GLfloat) far_z);
+    glUniform1f(location_far_z, FAR_Z);
+    GLint location_render_scale = glGetUniformLocation(program_id, "render_scale");
+    glUniform1f(location_render_scale, m_render_scale);
+    glm::vec2 texcoord_max = scaledTexcoordMax(m_display_width, m_display_height,
+                                               m_render_scale);
+    glUniform2fv(glGetUniformLocation(program_id, "render_texcoord_max"), 1,
+                 &texcoord_max[0]);
+}
 
-    glBindVertexArray(renderjob->m_buffer_objects.vao);
-    
-    // Bind material uniform block.
-    if (m_opengl_version == OGL_3_3 && renderjob->m_uniforms.materials != 0) {
-        glBindBufferBase(GL_UNIFORM_BUFFER, renderjob_enums::MATERIAL,
-                         renderjob->m_uniforms.materials);
-        glEnableVertexAttribArray(renderjob_enums::MATERIAL_IDX);
+void Renderer::bindTextures(const GLuint program_id, const RenderJob& renderjob)
+{
+    for (uint i = 0; i < renderjob.m_num_textures; i++) {
+        m_state.bindTexture(i, GL_TEXTURE_2D, renderjob.m_textures[i]);
+        string uniform_name("texture");
+        uniform_name += (char) '0' + i;
+        GLint location = glGetUniformLocation(program_id, uniform_name.c_str());
+        glUniform1i(location, i);
     }
+}
 
-    glEnableVertexAttribArray(renderjob_enums::POSITION);
-    glEnableVertexAttribArray(renderjob_enums::NORMAL);
-    glEnableVertexAttribArray(renderjob_enums::TEXCOORD);
-    glDrawElements(GL_TRIANGLES, renderjob->m_vertex_count, GL_UNSIGNED_SHORT, 0);
-    // Cleanup.
-    glDisableVertexAttribArray(renderjob_enums::POSITION);
-    glDisableVertexAttribArray(renderjob_enums::NORMAL);
-    glDisableVertexAttribArray(renderjob_enums::TEXCOORD);
+void Renderer::bindMesh(const RenderJob& renderjob, const bool depth_only)
+{
+    // The enabled attribute arrays are vertex array state, the state cache
+    // only enables them the first time a frame.
+    const GLuint vertex_array = renderjob.getVertexArray(depth_only);
+    m_state.bindVertexArray(vertex_array);
+    if (vertex_array != renderjob.getVertexArray()) {
+        // The position-only stream.
+        m_state.setVertexAttribArray(renderjob_enums::POSITION, true);
+        return;
+    }
 
-    if (m_opengl_version == OGL_3_3) {
-        glBindBufferBase(GL_UNIFORM_BUFFER, renderjob_enums::MATERIAL, 0);
-        glDisableVertexAttribArray(renderjob_enums::MATERIAL_IDX);
+    // Bind material uniform block, the same for every mesh.
+    if (m_opengl_version == OGL_3_3 && renderjob.m_materials) {
+        m_state.bindUniformBuffer(renderjob_enums::MATERIAL,
+                                  renderjob.m_materials->getBuffer());
+        m_state.setVertexAttribArray(renderjob_enums::MATERIAL_IDX, true);
     }
-    glBindVertexArray(0);
-    glUseProgram(0);
+
+    m_state.setVertexAttribArray(renderjob_enums::POSITION, true);
+    m_state.setVertexAttribArray(renderjob_enums::NORMAL, true);
+    m_state.setVertexAttribArray(renderjob_enums::TEXCOORD, true);
+}
+
+void Renderer::setInstanceAttributes(const bool enabled)
+{
+    for (uint column = 0; column < 4; column++) {
+        m_state.setVertexAttribArray(renderjob_enums::INSTANCE_MODEL + column,
+                                     enabled);
+        m_state.setVertexAttribArray(renderjob_enums::INSTANCE_NORMALMATRIX + column,
+                                     enabled);
+    }
+}
+
+void Renderer::setInstanceBuffer(const GLuint buffer, const GLintptr offset)
+{
+    typedef CommandBuffer::InstanceData InstanceData;
+
+    // Point the instance attributes of the bound vertex array at the
+    // instances from offset on. A mat4 attribute takes one location per
+    // column.
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    for (uint column = 0; column < 4; column++) {
+        const size_t column_offset = column * 4 * sizeof(GLfloat);
+
+        GLuint model_location = renderjob_enums::INSTANCE_MODEL + column;
+        glVertexAttribPointer(model_location, 4, GL_FLOAT, GL_FALSE,
+            sizeof(InstanceData),
+            (GLvoid*) (offset + offsetof(InstanceData, model) + column_offset));
+        glVertexAttribDivisor(model_location, 1);
+
+        GLuint normalmatrix_location = renderjob_enums::INSTANCE_NORMALMATRIX + column;
+        glVertexAttribPointer(normalmatrix_location, 4, GL_FLOAT, GL_FALSE,
+            sizeof(InstanceData),
+            (GLvoid*) (offset + offsetof(InstanceData, normalmatrix) + column_offset));
+        glVertexAttribDivisor(normalmatrix_location, 1);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    setInstanceAttributes(true);
+}
+
+void Renderer::drawInstances(const RenderJob& renderjob,
+                             const uint first_instance,
+                             const uint num_instances, const bool depth_only)
+{
+    setInstanceBuffer(m_ring_buffer->getBufferID(), m_instances.offset +
+                      first_instance * sizeof(CommandBuffer::InstanceData));
+
+    const MeshPool::Range& range = renderjob.getMeshRange(depth_only);
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.num_indices,
+        GL_UNSIGNED_SHORT, (GLvoid*) (range.first_index * sizeof(GLushort)),
+        num_instances, range.base_vertex);
+    m_statistics.draw_calls++;
+}
+
+void Renderer::renderDepthPrepass()
+{
+    // Only depth is attached.
+    m_render_graph.bindFramebuffer(m_passes.depth_prepass, m_state);
+    glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    executeCommandBuffers(true);
 }
 
 void Renderer::renderGBuffers()
 {
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_fbo.gbuffer);
-    renderRenderQueue();
+    m_render_graph.bindFramebuffer(m_passes.gbuffer, m_state);
+    // Zero alpha leaves the packed attributes of empty pixels as unlit sky.
+    glClearColor(0.0, 0.0, 0.0, 0.0);
+    if (m_depth_prepass) {
+        // Depth is final, only the visible fragment of each pixel passes.
+        glClear(GL_COLOR_BUFFER_BIT);
+        glDepthFunc(GL_EQUAL);
+        glDepthMask(GL_FALSE);
+        executeCommandBuffers();
+        glDepthMask(GL_TRUE);
+        glDepthFunc(GL_LESS);
+    } else {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        executeCommandBuffers();
+    }
+    m_visible_entities.clear();
+}
+
+void Renderer::updateCameraTransforms()
+{
+    const Entity& camera = *m_frame->getCamera();
+    // View transform.
+    glm::mat4 view_orientation_x(glm::rotate(glm::mat4(1.0f),
+                                             camera.m_orientation.y,
+                                             glm::vec3(-1.0f, 0.0f, 0.0f)));
+    glm::mat4 view_orientation(glm::rotate(view_orientation_x,
+                               camera.m_orientation.x,
+                               glm::vec3(0.0f, 1.0f, 0.0f)));
+    m_view = glm::translate(view_orientation, -camera.m_position);
+
+    // Projection transform
+    m_projection = glm::perspective(FOV, m_aspect_ratio, NEAR_Z, FAR_Z);
+}
+
+void Renderer::cullRenderQueue()
+{
+    PROFILE_ZONE("Renderer::cullRenderQueue");
+    sf::Clock clock;
+    Frustum frustum(m_projection * m_view);
+    m_num_culled = 0;
+
+    // Static entities, rejected a subtree at a time.
+    foreach (const shared_ptr<BoundingVolumeHierarchy>& hierarchy,
+             m_frame->getHierarchies()) {
+        m_num_culled += hierarchy->cull(frustum, m_visible_entities);
+    }
+
+    // Entities queued one by one.
+    vector<shared_ptr<Entity> > cullable_entities;
+    foreach (const shared_ptr<Entity>& current_entity, m_frame->getEntities()) {
+        if (current_entity->getRenderJob()->m_cullable) {
+            cullable_entities.push_back(current_entity);
+        } else {
+            m_visible_entities.push_back(current_entity);
+        }
+    }
+
+    // Rebuild the matrices of entities that moved.
+    foreach (shared_ptr<Entity> entity, m_visible_entities) {
+        m_transforms.sync(*entity);
+    }
+    foreach (shared_ptr<Entity> entity, cullable_entities) {
+        m_transforms.sync(*entity);
+    }
+    m_transforms.update();
+
+    if (isGpuCulling()) {
+        // Every instance is tested in the compute shader.
+        m_visible_entities.insert(m_visible_entities.end(),
+                                  cullable_entities.begin(),
+                                  cullable_entities.end());
+        m_statistics.cull_ms = clock.getElapsedTime().asMicroseconds() / 1000.0f;
+        return;
+    }
+
+    m_frustum_culler.clear();
+    m_frustum_culler.setFrustum(frustum);
+    foreach (shared_ptr<Entity> entity, cullable_entities) {
+        m_frustum_culler.add(entity->getRenderJob()->m_bounds,
+                             m_transforms.getModelMatrix(*entity));
+    }
+
+    vector<uint> visible;
+    m_num_culled += m_frustum_culler.cull(visible);
+    foreach (uint index, visible) {
+        m_visible_entities.push_back(cullable_entities[index]);
+    }
+
+    if (m_occlusion_culling) {
+        m_num_culled += cullOccluded();
+    }
+    m_statistics.cull_ms = clock.getElapsedTime().asMicroseconds() / 1000.0f;
+}
+
+uint Renderer::cullOccluded()
+{
+    PROFILE_ZONE("Renderer::cullOccluded");
+    m_occlusion_culler.beginFrame(m_projection * m_view);
+    foreach (shared_ptr<Entity> entity, m_visible_entities) {
+        const RenderJob& renderjob = *entity->getRenderJob();
+        if (renderjob.m_occluder && !renderjob.m_occluder_indices.empty()) {
+            m_occlusion_culler.addOccluder(&renderjob.m_occluder_positions[0],
+                                           &renderjob.m_occluder_indices[0],
+                                           renderjob.m_occluder_indices.size(),
+                                           m_transforms.getModelMatrix(*entity));
+        }
+    }
+    if (m_occlusion_culler.getNumTriangles() == 0) {
+        return 0;
+    }
+    m_occlusion_culler.rasterize();
+
+    // Occluders are always kept, they would hide themselves.
+    uint num_kept = 0;
+    for (uint i = 0; i < m_visible_entities.size(); i++) {
+        const RenderJob& renderjob = *m_visible_entities[i]->getRenderJob();
+        bool visible = renderjob.m_occluder || !renderjob.m_cullable;
+        if (!visible) {
+            glm::vec3 center, half_extents;
+            renderjob.m_bounds.transform(
+                m_transforms.getModelMatrix(*m_visible_entities[i]),
+                center, half_extents);
+            visible = m_occlusion_culler.isVisible(center, half_extents);
+        }
+        if (visible) {
+            m_visible_entities[num_kept++] = m_visible_entities[i];
+        }
+    }
+    uint num_occluded = m_visible_entities.size() - num_kept;
+    m_visible_entities.resize(num_kept);
+    return num_occluded;
 }
 
 void Renderer::renderRenderQueue()
 {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
-    while (!m_render_queue.empty()) {
-        shared_ptr<Entity> current_entity = m_render_queue.front();
-        m_render_queue.pop();
+    cullRenderQueue();
+    foreach (shared_ptr<Entity> current_entity, m_visible_entities) {
         renderEntity(*current_entity);
-    } 
-}
-
-uint Renderer::loadLightsIntoUniformBlocks()
-{
-    uint num_pointlights = 0;
-    vector<GLfloat> pointlight_buffer;
-    while (!m_pointlight_queue.empty()) {
-        shared_ptr<PointLight> pointlight = m_pointlight_queue.front();
-        m_pointlight_queue.pop();
-        pointlight_buffer.push_back(pointlight->m_position.x);
-        pointlight_buffer.push_back(pointlight->m_position.y);
-        pointlight_buffer.push_back(pointlight->m_position.z);
-        pointlight_buffer.push_back(0.0f); // padding.
-        pointlight_buffer.push_back(pointlight->m_color.r);
-        pointlight_buffer.push_back(pointlight->m_color.g);
-        pointlight_buffer.push_back(pointlight->m_color.b);
-        pointlight_buffer.push_back(pointlight->m_intensity);
-        num_pointlights++;
-    }
-    const int POINTLIGHTS_SIZE = sizeof(GLfloat) * 8;
-    
-    glBindBuffer(GL_UNIFORM_BUFFER, m_uniform_blocks.pointlights);
-    glBufferData(GL_UNIFORM_BUFFER, POINTLIGHTS_SIZE * pointlight_buffer.size(),
-                 &pointlight_buffer[0], GL_STATIC_DRAW);
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
-    glBindBufferBase(GL_UNIFORM_BUFFER, POINTLIGHTS_IDX,
-                     m_uniform_blocks.pointlights);
-    return num_pointlights;
+    }
+    m_visible_entities.clear();
+}
+
+/// Groups entities by program, then by RenderJob.
+static bool compareRenderJobs(const shared_ptr<Entity>& a,
+                              const shared_ptr<Entity>& b)
+{
+    GLuint program_a = a->getRenderJob()->getShaderProgramID();
+    GLuint program_b = b->getRenderJob()->getShaderProgramID();
+    if (program_a != program_b) {
+        return program_a < program_b;
+    }
+    return a->getRenderJob() < b->getRenderJob();
+}
+
+/// The program drawing a mesh in the G-buffer or the depth pre-pass.
+static GLuint drawProgram(const RenderJob& renderjob, const bool depth_only)
+{
+    // Depth-only programs are shared by most meshes.
+    GLuint program_id = depth_only ? renderjob.getDepthShaderProgramID() : 0;
+    return program_id != 0 ? program_id : renderjob.getShaderProgramID();
+}
+
+/// Whether two meshes are drawn with the same bindings, so one multi-draw
+/// can draw both.
+static bool sharesBindings(const RenderJob& a, const RenderJob& b,
+                           const bool depth_only)
+{
+    if (drawProgram(a, depth_only) != drawProgram(b, depth_only) ||
+        a.getVertexArray(depth_only) != b.getVertexArray(depth_only)) {
+        return false;
+    }
+    if (a.getVertexArray(depth_only) != a.getVertexArray()) {
+        return true; // Positions only, no textures or materials.
+    }
+    if ((!depth_only || a.m_alpha_tested) &&
+        (a.m_num_textures != b.m_num_textures ||
+         !std::equal(a.m_textures, a.m_textures + a.m_num_textures,
+                     b.m_textures))) {
+        return false;
+    }
+    return a.m_materials == b.m_materials;
+}
+
+static DrawElementsIndirectCommand makeDrawCommand(const RenderJob& renderjob,
+                                                   const uint first_instance,
+                                                   const uint num_instances,
+                                                   const bool depth_only)
+{
+    const MeshPool::Range& range = renderjob.getMeshRange(depth_only);
+    DrawElementsIndirectCommand command;
+    command.count = range.num_indices;
+    command.instance_count = num_instances;
+    command.first_index = range.first_index;
+    command.base_vertex = range.base_vertex;
+    // Instance attributes start from here.
+    command.base_instance = first_instance;
+    return command;
+}
+
+/// A slice of the visible entities recorded by one thread.
+struct RecordingTask {
+    CommandBuffer* command_buffer;
+    const shared_ptr<Entity>* entities;
+    uint num_entities;
+    const TransformStore* transforms;
+    CommandBuffer::InstanceData* instances;
+    uint first_instance;
+};
+
+static void recordSlice(RecordingTask* task)
+{
+    PROFILE_ZONE("CommandBuffer::record");
+    task->command_buffer->clear();
+    task->command_buffer->record(task->entities, task->num_entities,
+                                 *task->transforms, task->instances,
+                                 task->first_instance);
+}
+
+void Renderer::recordCommandBuffers()
+{
+    PROFILE_ZONE("Renderer::recordCommandBuffers");
+    // Group entities sharing a RenderJob so each group is one draw call.
+    std::sort(m_visible_entities.begin(), m_visible_entities.end(),
+              compareRenderJobs);
+
+    const uint num_entities = m_visible_entities.size();
+    uint num_slices = std::min(MAX_RECORDING_THREADS,
+                               std::max(1u, num_entities / MIN_ENTITIES_PER_THREAD));
+    if (m_command_buffers.size() < num_slices) {
+        m_command_buffers.resize(num_slices);
+    }
+
+    // One draw per run of entities sharing a RenderJob.
+    m_num_draws = 0;
+    for (uint i = 0; i < num_entities; i++) {
+        if (i == 0 || m_visible_entities[i]->getRenderJob() !=
+                      m_visible_entities[i - 1]->getRenderJob()) {
+            m_num_draws++;
+        }
+    }
+
+    // Instance data is written by the recording threads straight into the
+    // ring buffer, the bounds culled on the GPU and the draw commands follow
+    // it. Allocated at once, growing the ring buffer loses what was allocated
+    // before. The compute shader binds each range on its own.
+    typedef CommandBuffer::InstanceData InstanceData;
+    const GLsizeiptr alignment = m_ring_buffer->getAlignment();
+    const GLsizeiptr instances_size = num_entities * sizeof(InstanceData);
+    const GLsizeiptr bounds_offset = alignOffset(instances_size, alignment);
+    const GLsizeiptr bounds_size = isGpuCulling() ?
+        m_num_draws * sizeof(GpuCuller::DrawBounds) : 0;
+    const GLsizeiptr commands_offset = alignOffset(bounds_offset + bounds_size,
+                                                   alignment);
+    const GLsizeiptr commands_size = m_multi_draw ?
+        2 * m_num_draws * sizeof(DrawElementsIndirectCommand) : 0;
+    RingBuffer::Allocation allocation =
+        m_ring_buffer->allocate(commands_offset + commands_size);
+    m_instances = allocation;
+    m_instances.size = instances_size;
+    m_draw_bounds.data = (char*) allocation.data + bounds_offset;
+    m_draw_bounds.offset = allocation.offset + bounds_offset;
+    m_draw_bounds.size = bounds_size;
+    m_draw_commands.data = (char*) allocation.data + commands_offset;
+    m_draw_commands.offset = allocation.offset + commands_offset;
+    m_draw_commands.size = commands_size;
+    InstanceData* instances = (InstanceData*) m_instances.data;
+
+    // Split into slices of about equal size, moving each boundary forward to
+    // the next RenderJob change so groups aren't split into two draws.
+    vector<RecordingTask> tasks;
+    uint begin = 0;
+    for (uint slice = 0; slice < num_slices && begin < num_entities; slice++) {
+        uint end = num_entities * (slice + 1) / num_slices;
+        end = std::max(end, begin + 1);
+        while (end < num_entities &&
+               m_visible_entities[end]->getRenderJob() ==
+               m_visible_entities[end - 1]->getRenderJob()) {
+            end++;
+        }
+        RecordingTask task;
+        task.command_buffer = &m_command_buffers[slice];
+        task.entities = &m_visible_entities[begin];
+        task.num_entities = end - begin;
+        task.transforms = &m_transforms;
+        task.instances = instances + begin;
+        task.first_instance = begin;
+        tasks.push_back(task);
+        begin = end;
+    }
+    m_num_command_buffers = tasks.size();
+
+    // The first slice is recorded on this thread, the rest by the workers.
+    m_recording_workers.run(&recordSlice, tasks.empty() ? 0 : &tasks[0],
+                            tasks.size());
+    if (m_multi_draw) {
+        writeDrawCommands();
+    }
+    m_ring_buffer->flush(allocation);
+}
+
+void Renderer::writeDrawCommands()
+{
+    typedef CommandBuffer::Command Command;
+
+    DrawElementsIndirectCommand* commands =
+        (DrawElementsIndirectCommand*) m_draw_commands.data;
+    DrawElementsIndirectCommand* depth_commands = commands + m_num_draws;
+    GpuCuller::DrawBounds* bounds = (GpuCuller::DrawBounds*) m_draw_bounds.data;
+    // Culled on the GPU, the compute shader counts the instances.
+    const bool gpu_culling = isGpuCulling();
+    uint draw = 0;
+    for (uint i = 0; i < m_num_command_buffers; i++) {
+        foreach (const Command& command, m_command_buffers[i].getCommands()) {
+            if (command.type != Command::DRAW_INSTANCES) {
+                continue;
+            }
+            const RenderJob& renderjob = *command.renderjob;
+            const uint num_instances = gpu_culling ? 0 : command.num_instances;
+            commands[draw] = makeDrawCommand(renderjob, command.first_instance,
+                                             num_instances, false);
+            depth_commands[draw] = makeDrawCommand(renderjob,
+                                                   command.first_instance,
+                                                   num_instances, true);
+            if (gpu_culling) {
+                GpuCuller::DrawBounds& draw_bounds = bounds[draw];
+                glm::vec3 center = renderjob.m_bounds.getCenter();
+                glm::vec3 half_extents = renderjob.m_bounds.getHalfExtents();
+                std::copy(&center[0], &center[0] + 3, draw_bounds.center);
+                std::copy(&half_extents[0], &half_extents[0] + 3,
+                          draw_bounds.half_extents);
+                draw_bounds.first_instance = command.first_instance;
+                draw_bounds.cullable = renderjob.m_cullable;
+            }
+            draw++;
+        }
+    }
+}
+
+void Renderer::executeCommandBuffers(const bool depth_only)
+{
+    PROFILE_ZONE("Renderer::executeCommandBuffers");
+    typedef CommandBuffer::Command Command;
+
+    if (m_instances.size == 0) {
+        return;
+    }
+    if (m_multi_draw) {
+        executeMultiDraw(depth_only);
+        return;
+    }
+
+    GLuint program_id = 0;
+    for (uint i = 0; i < m_num_command_buffers; i++) {
+        foreach (const Command& command, m_command_buffers[i].getCommands()) {
+            const RenderJob& renderjob = *command.renderjob;
+            switch (command.type) {
+            case Command::BIND_PROGRAM: {
+                // Depth-only programs are shared, only switch when it changes.
+                GLuint next_program_id = drawProgram(renderjob, depth_only);
+                if (next_program_id != program_id) {
+                    program_id = next_program_id;
+                    useProgram(program_id);
+                }
+                break;
+            }
+            case Command::BIND_TEXTURES:
+                if (!depth_only || renderjob.m_alpha_tested) {
+                    bindTextures(program_id, renderjob);
+                }
+                break;
+            case Command::BIND_MESH:
+                bindMesh(renderjob, depth_only);
+                break;
+            case Command::DRAW_INSTANCES:
+                drawInstances(renderjob, command.first_instance,
+                              command.num_instances, depth_only);
+                break;
+            }
+        }
+    }
+}
+
+void Renderer::executeMultiDraw(const bool depth_only)
+{
+    PROFILE_ZONE("Renderer::executeMultiDraw");
+    typedef CommandBuffer::Command Command;
+
+    // The commands of the position-only streams follow the others.
+    const GLintptr commands_offset = m_draw_commands.offset +
+        (depth_only ? m_num_draws * sizeof(DrawElementsIndirectCommand) : 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_ring_buffer->getBufferID());
+
+    // The binding commands are left out, draws are grouped by their bindings
+    // instead. Each group is a run of consecutive draw commands.
+    const RenderJob* group = 0;
+    uint group_begin = 0;
+    uint draw = 0;
+    for (uint i = 0; i < m_num_command_buffers; i++) {
+        foreach (const Command& command, m_command_buffers[i].getCommands()) {
+            if (command.type != Command::DRAW_INSTANCES) {
+                continue;
+            }
+            const RenderJob& renderjob = *command.renderjob;
+            if (group && !sharesBindings(*group, renderjob, depth_only)) {
+                multiDraw(commands_offset, group_begin, draw - group_begin);
+                group = 0;
+            }
+            if (!group) {
+                GLuint program_id = drawProgram(renderjob, depth_only);
+                useProgram(program_id);
+                if (!depth_only || renderjob.m_alpha_tested) {
+                    bindTextures(program_id, renderjob);
+                }
+                bindMesh(renderjob, depth_only);
+                // Base instances pick each draw's instances, of those left by
+                // the culling when done on the GPU.
+                if (isGpuCulling()) {
+                    setInstanceBuffer(m_gpu_culler->getVisibleInstances(), 0);
+                } else {
+                    setInstanceBuffer(m_ring_buffer->getBufferID(),
+                                      m_instances.offset);
+                }
+                group = &renderjob;
+                group_begin = draw;
+            }
+            draw++;
+        }
+    }
+    if (group) {
+        multiDraw(commands_offset, group_begin, draw - group_begin);
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void Renderer::multiDraw(const GLintptr commands_offset, const uint first_draw,
+                         const uint num_draws)
+{
+    const GLintptr offset = commands_offset +
+                            first_draw * sizeof(DrawElementsIndirectCommand);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT,
+                                (GLvoid*) offset, num_draws, 0);
+    m_statistics.draw_calls++;
+}
+
+uint Renderer::loadLightsIntoClusters()
+{
+    PROFILE_ZONE("Renderer::loadLightsIntoClusters");
+    m_light_grid.setView(m_view, m_projection, NEAR_Z, FAR_Z);
+    m_light_data.clear();
+    foreach (const shared_ptr<PointLight>& pointlight, m_frame->getPointLights()) {
+        float radius = pointlight->getRadius();
+        if (m_lighting_mode == CLUSTERED_LIGHTING) {
+            m_light_grid.addLight(pointlight->m_position, radius);
+        }
+        m_light_data.push_back(pointlight->m_position.x);
+        m_light_data.push_back(pointlight->m_position.y);
+        m_light_data.push_back(pointlight->m_position.z);
+        m_light_data.push_back(radius);
+        m_light_data.push_back(pointlight->m_color.r);
+        m_light_data.push_back(pointlight->m_color.g);
+        m_light_data.push_back(pointlight->m_color.b);
+        m_light_data.push_back(pointlight->m_intensity);
+    }
+    m_light_grid.build();
+
+    const vector<uint>& clusters = m_light_grid.getClusters();
+    const vector<uint>& light_indices = m_light_grid.getLightIndices();
+    const void* data[NUM_LIGHT_BUFFERS] = {
+        clusters.empty() ? 0 : &clusters[0],
+        light_indices.empty() ? 0 : &light_indices[0],
+        m_light_data.empty() ? 0 : &m_light_data[0]};
+    const GLsizeiptr sizes[NUM_LIGHT_BUFFERS] = {
+        (GLsizeiptr) (clusters.size() * sizeof(uint)),
+        (GLsizeiptr) (light_indices.size() * sizeof(uint)),
+        (GLsizeiptr) (m_light_data.size() * sizeof(GLfloat))};
+    if (m_light_buffer_ranges) {
+        streamLightBuffers(data, sizes);
+    } else {
+        for (uint i = 0; i < NUM_LIGHT_BUFFERS; i++) {
+            uploadLightBuffer(i, sizes[i], data[i]);
+        }
+    }
+    return m_light_grid.getNumLights();
+}
+
+void Renderer::streamLightBuffers(const void* data[], const GLsizeiptr sizes[])
+{
+    // One allocation carved into the three buffers, like the instance data.
+    // The geometry has been drawn, so growing the ring buffer is safe. Empty
+    // buffers still get a texel, texture buffer ranges can't be empty.
+    const GLsizeiptr alignment = m_ring_buffer->getAlignment();
+    GLsizeiptr offsets[NUM_LIGHT_BUFFERS];
+    GLsizeiptr total_size = 0;
+    for (uint i = 0; i < NUM_LIGHT_BUFFERS; i++) {
+        offsets[i] = total_size;
+        total_size = alignOffset(total_size + std::max(sizes[i], LIGHT_TEXEL_SIZE),
+                                 alignment);
+    }
+    RingBuffer::Allocation allocation = m_ring_buffer->allocate(total_size);
+    for (uint i = 0; i < NUM_LIGHT_BUFFERS; i++) {
+        if (sizes[i] > 0) {
+            memcpy((char*) allocation.data + offsets[i], data[i], sizes[i]);
+        }
+    }
+    m_ring_buffer->flush(allocation);
+
+    for (uint i = 0; i < NUM_LIGHT_BUFFERS; i++) {
+        m_state.bindTexture(LIGHT_BUFFER_UNIT + i, GL_TEXTURE_BUFFER,
+                            m_light_textures[i]);
+        glTexBufferRange(GL_TEXTURE_BUFFER, LIGHT_BUFFER_FORMATS[i],
+                         m_ring_buffer->getBufferID(),
+                         allocation.offset + offsets[i],
+                         std::max(sizes[i], LIGHT_TEXEL_SIZE));
+    }
+}
+
+void Renderer::uploadLightBuffer(const uint index, const GLsizeiptr size,
+                                 const void* data)
+{
+    // Orphaned first, so the upload doesn't wait for the previous frame's
+    // reads.
+    glBindBuffer(GL_TEXTURE_BUFFER, m_light_buffers[index]);
+    if (size > m_light_buffer_sizes[index]) {
+        m_light_buffer_sizes[index] = std::max(size, 2 * m_light_buffer_sizes[index]);
+    }
+    glBufferData(GL_TEXTURE_BUFFER, m_light_buffer_sizes[index], 0,
+                 GL_STREAM_DRAW);
+    if (size > 0) {
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void Renderer::bindLightClusters(const GLuint program_id)
+{
+    for (uint i = 0; i < NUM_LIGHT_BUFFERS; i++) {
+        m_state.bindTexture(LIGHT_BUFFER_UNIT + i, GL_TEXTURE_BUFFER,
+                            m_light_textures[i]);
+        glUniform1i(glGetUniformLocation(program_id, LIGHT_BUFFER_UNIFORMS[i]),
+                    LIGHT_BUFFER_UNIT + i);
+    }
+
+    glUniformMatrix4fv(glGetUniformLocation(program_id, "view"), 1, GL_FALSE,
+                       &m_view[0][0]);
+    glUniform3i(glGetUniformLocation(program_id, "cluster_size"),
+                m_light_grid.getSizeX(), m_light_grid.getSizeY(),
+                m_light_grid.getSizeZ());
+    glUniform1f(glGetUniformLocation(program_id, "cluster_slice_scale"),
+                m_light_grid.getSliceScale());
+    glUniform1f(glGetUniformLocation(program_id, "cluster_slice_bias"),
+                m_light_grid.getSliceBias());
 }
 
+void Renderer::bindGBufferDepth(const GLuint program_id)
+{
+    m_state.bindTexture(GBUFFER_DEPTH_UNIT, GL_TEXTURE_2D,
+                        m_render_graph.getTexture(m_targets.sampled_depth));
+    glUniform1i(glGetUniformLocation(program_id, "gbuffer_depth"),
+                GBUFFER_DEPTH_UNIT);
+
+    glm::mat4 inverse_viewprojection = glm::inverse(m_projection * m_view);
+    glUniformMatrix4fv(glGetUniformLocation(program_id, "inverse_viewprojection"),
+                       1, GL_FALSE, &inverse_viewprojection[0][0]);
+}
+
+void Renderer::copyDepth()
+{
+    const GLint width = scaledSize(m_display_width, m_render_scale);
+    const GLint height = scaledSize(m_display_height, m_render_scale);
+    m_state.bindFramebuffer(GL_READ_FRAMEBUFFER,
+                            m_render_graph.getFramebuffer(m_passes.gbuffer));
+    m_render_graph.bindFramebuffer(m_passes.depth_copy, m_state);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height,
+                      GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    m_state.bindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+}
 
 void Renderer::renderPBuffers()
 {
-    uint num_pointlights = loadLightsIntoUniformBlocks();
+    loadLightsIntoClusters();
+    if (m_passes.depth_copy != RenderGraph::CULLED) {
+        copyDepth();
+    }
 
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_fbo.pbuffer);
+    // With light volumes the depth is the G-buffer's, tested against.
+    m_render_graph.bindFramebuffer(m_passes.lighting, m_state);
     glClearColor(0.0, 0.0, 0.0, 1.0);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+    // With light volumes the clusters are empty, so this only lays down the
+    // unlit pixels the volumes add onto.
     GLuint program_id = m_gbuffer.getRenderJob()->getShaderProgramID();
-    glUseProgram(program_id);
-    glUniform1i(glGetUniformLocation(program_id, "num_pointlights"),
-                num_pointlights);
+    m_state.useProgram(program_id);
+    bindLightClusters(program_id);
+    bindGBufferDepth(program_id);
     renderEntity(m_gbuffer);
 
+    if (m_lighting_mode == LIGHT_VOLUMES) {
+        renderLightVolumes();
+    }
+}
+
+void Renderer::renderLightVolumes()
+{
+    shared_ptr<RenderJob> renderjob = m_light_volume.getRenderJob();
+    GLuint program_id = renderjob->getShaderProgramID();
+    bindRenderJob(*renderjob);
+    bindLightClusters(program_id);
+    bindGBufferDepth(program_id);
+    GLint location_light_index = glGetUniformLocation(program_id, "light_index");
+
+    // Only diffuse and specular are lit, leave the edges alone.
+    const GLenum draw_buffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glDrawBuffers(2, draw_buffers);
+
+    m_state.setEnabled(GL_STENCIL_TEST, true);
+    glBlendFunc(GL_ONE, GL_ONE);
+    glDepthMask(GL_FALSE);
+
+    const uint num_lights = m_light_data.size() / LIGHT_DATA_STRIDE;
+    for (uint i = 0; i < num_lights; i++) {
+        const GLfloat* light = &m_light_data[i * LIGHT_DATA_STRIDE];
+        glm::mat4 model = glm::scale(
+            glm::translate(glm::mat4(1.0f), glm::vec3(light[0], light[1], light[2])),
+            glm::vec3(light[3] * LIGHT_VOLUME_SCALE));
+        // The instance attributes aren't enabled, so every vertex reads
+        // these constant values.
+        for (uint column = 0; column < 4; column++) {
+            glVertexAttrib4fv(renderjob_enums::INSTANCE_MODEL + column,
+                              &model[column][0]);
+        }
+        glUniform1i(location_light_index, i);
+
+        // Stencil pass: mark pixels whose surface lies inside the volume,
+        // where the back face is behind the surface and the front face is
+        // not. Works with the camera inside the volume as well.
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        m_state.setEnabled(GL_DEPTH_TEST, true);
+        m_state.setEnabled(GL_CULL_FACE, false);
+        m_state.setEnabled(GL_BLEND, false);
+        glStencilFunc(GL_ALWAYS, 0, 0);
+        glStencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
+        glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
+        glDrawElements(GL_TRIANGLES, renderjob->m_vertex_count,
+                       GL_UNSIGNED_SHORT, 0);
+        m_statistics.draw_calls++;
+
+        // Lighting pass: shade the marked pixels once, resetting the stencil
+        // for the next light. The back faces cover the volume even when the
+        // camera is inside it.
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        m_state.setEnabled(GL_DEPTH_TEST, false);
+        m_state.setEnabled(GL_CULL_FACE, true);
+        glCullFace(GL_FRONT);
+        m_state.setEnabled(GL_BLEND, true);
+        glStencilFunc(GL_NOTEQUAL, 0, 0xFF);
+        glStencilOp(GL_KEEP, GL_KEEP, GL_ZERO);
+        glDrawElements(GL_TRIANGLES, renderjob->m_vertex_count,
+                       GL_UNSIGNED_SHORT, 0);
+        m_statistics.draw_calls++;
+    }
+
+    // Cleanup.
+    glCullFace(GL_BACK);
+    m_state.setEnabled(GL_CULL_FACE, false);
+    m_state.setEnabled(GL_BLEND, false);
+    m_state.setEnabled(GL_STENCIL_TEST, false);
+    glDepthMask(GL_TRUE);
+    m_render_graph.bindFramebuffer(m_passes.lighting, m_state); // All draw buffers.
 }
 
 
 void gamefw::Renderer::renderPPBuffers()
 {
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_fbo.ppbuffer);
+    m_render_graph.bindFramebuffer(m_passes.antialiasing, m_state);
     glClearColor(0.0, 0.0, 0.0, 1.0);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    glClear(GL_COLOR_BUFFER_BIT);
     renderEntity(m_pbuffer);
 }
 
+void Renderer::initBloom()
+{
+    m_bloom_prefilter = *Locator::getFileService().createEntity("bloomprefilter");
+    m_bloom_downsample = *Locator::getFileService().createEntity("bloomdownsample");
+    m_bloom_upsample = *Locator::getFileService().createEntity("bloomupsample");
+}
+
+void Renderer::renderBloom()
+{
+    // Lit specular, antialiased if enabled.
+    GLuint specular = m_render_graph.getTexture(m_targets.final[1]);
+    renderBloomPass(m_bloom_prefilter, m_passes.bloom_prefilter, specular,
+                    m_display_width, m_display_height, 0);
+
+    for (uint level = 1; level < m_bloom_levels; level++) {
+        renderBloomPass(m_bloom_downsample, m_passes.bloom_downsample[level],
+                        m_render_graph.getTexture(m_targets.bloom[level - 1]),
+                        bloomLevelSize(m_display_width, level - 1),
+                        bloomLevelSize(m_display_height, level - 1), level);
+    }
+
+    // Back up the chain, each level gets the blurred sum of the smaller ones.
+    m_state.setEnabled(GL_BLEND, true);
+    glBlendFunc(GL_ONE, GL_ONE);
+    for (int level = (int) m_bloom_levels - 2; level >= 0; level--) {
+        renderBloomPass(m_bloom_upsample, m_passes.bloom_upsample[level],
+                        m_render_graph.getTexture(m_targets.bloom[level + 1]),
+                        bloomLevelSize(m_display_width, level + 1),
+                        bloomLevelSize(m_display_height, level + 1), level);
+    }
+    m_state.setEnabled(GL_BLEND, false);
+}
+
+void Renderer::renderBloomPass(const Entity& pass, const uint graph_pass,
+                               const GLuint source, const GLuint source_width,
+                               const GLuint source_height,
+                               const uint target_level)
+{
+    m_render_graph.bindFramebuffer(graph_pass, m_state);
+    // The levels are scaled with the scene, like the targets they are from.
+    glViewport(0, 0,
+               scaledSize(bloomLevelSize(m_display_width, target_level), m_render_scale),
+               scaledSize(bloomLevelSize(m_display_height, target_level), m_render_scale));
+
+    shared_ptr<RenderJob> renderjob = pass.getRenderJob();
+    GLuint program_id = renderjob->getShaderProgramID();
+    bindRenderJob(*renderjob);
+
+    m_state.bindTexture(0, GL_TEXTURE_2D, source);
+    glUniform1i(glGetUniformLocation(program_id, "texture0"), 0);
+    glUniform2f(glGetUniformLocation(program_id, "source_pixel_size"),
+                1.0f / source_width, 1.0f / source_height);
+    glm::vec2 texcoord_max = scaledTexcoordMax(source_width, source_height,
+                                               m_render_scale);
+    glUniform2fv(glGetUniformLocation(program_id, "render_texcoord_max"), 1,
+                 &texcoord_max[0]);
+    glUniform1f(glGetUniformLocation(program_id, "bloom_threshold"),
+                m_bloom_threshold);
+
+    glDrawElements(GL_TRIANGLES, renderjob->m_vertex_count, GL_UNSIGNED_SHORT, 0);
+    m_statistics.draw_calls++;
+}
+
+void Renderer::bindBloom(const GLuint program_id)
+{
+    // Without bloom the specular light is added as is.
+    uint target = m_bloom ? m_targets.bloom[0] : m_targets.final[1];
+    m_state.bindTexture(BLOOM_UNIT, GL_TEXTURE_2D, m_render_graph.getTexture(target));
+    glUniform1i(glGetUniformLocation(program_id, "bloom"), BLOOM_UNIT);
+    glm::vec2 texcoord_max = m_bloom ?
+        scaledTexcoordMax(bloomLevelSize(m_display_width, 0),
+                          bloomLevelSize(m_display_height, 0), m_render_scale) :
+        scaledTexcoordMax(m_display_width, m_display_height, m_render_scale);
+    glUniform2fv(glGetUniformLocation(program_id, "bloom_texcoord_max"), 1,
+                 &texcoord_max[0]);
+
+    // Every level adds its own copy of the light, keep the total unchanged.
+    glUniform1f(glGetUniformLocation(program_id, "bloom_intensity"),
+                m_bloom ? 1.0f / m_bloom_levels : 1.0f);
+}
+
 void gamefw::Renderer::changeCamera(shared_ptr< Entity > camera)
 {
     m_camera = camera;
@@ -2,19 +2,75 @@
 #ifndef RENDERER_H
 #define RENDERER_H
 
-#include <queue>
-
 #include "entity.h"
 #include "openglversion.h"
+#include "frustumculler.h"
+#include "boundingvolumehierarchy.h"
+#include "commandbuffer.h"
+#include "ringbuffer.h"
+#include "transformstore.h"
+#include "lightgrid.h"
+#include "resolutionscaler.h"
+#include "gputimer.h"
+#include "occlusionculler.h"
+#include "rendergraph.h"
+#include "framesnapshot.h"
+#include "statecache.h"
+#include "gpuculler.h"
+#include "workerpool.h"
 
 namespace gamefw {
 
+/**
+ * @brief Work submitted by the renderer during one frame.
+ **/
+struct RenderStatistics
+{
+    /// A multi-draw counts once, however many meshes it draws.
+    uint draw_calls;
+    /// Shader programs, textures and meshes bound. Redundant binds skipped
+    /// by the state cache don't count.
+    uint state_changes;
+    /// OpenGL calls issued and skipped by the state cache.
+    StateCache::Counters gl_calls;
+    /// CPU time spent culling the render queue, in milliseconds.
+    float cull_ms;
+};
+
 /**
  * @brief Where the magic happens.
  */
 class Renderer
 {
 public:
+    /// How point lights are applied to the G-buffer.
+    enum LightingMode {
+        /// One fullscreen pass looping over the lights of each pixel's cluster.
+        CLUSTERED_LIGHTING,
+        /// A stencil tested sphere per light, blended additively. Cheaper when
+        /// there are few lights covering small parts of the screen.
+        LIGHT_VOLUMES
+    };
+
+    /// Passes of a frame, as timed on the GPU.
+    enum RenderPass {
+        /// Culling the instances in a compute shader, when enabled.
+        CULLING_PASS,
+        /// Depth of the scene alone, when enabled.
+        DEPTH_PREPASS,
+        /// Drawing the scene into the G-buffer, and the depth pyramid of GPU
+        /// occlusion culling.
+        GBUFFER_PASS,
+        /// Shading the G-buffer with the lights.
+        LIGHTING_PASS,
+        /// Antialiasing.
+        POSTPROCESSING_PASS,
+        BLOOM_PASS,
+        /// Upscaling and combining everything into the window.
+        COMPOSITE_PASS,
+        NUM_RENDER_PASSES
+    };
+
     /**
      * @brief Creates renderer for screen with given dimensions.
      *
@@ -32,6 +88,15 @@ public:
      */
     void addToRenderQueue(shared_ptr< Entity > entity);
 
+    /**
+     * @brief Adds every entity of a hierarchy to the rendering pipeline.
+     *
+     * The hierarchy is culled as a whole, rejecting subtrees outside the view.
+     *
+     * @param hierarchy ditto.
+     */
+    void addToRenderQueue(shared_ptr<BoundingVolumeHierarchy> hierarchy);
+
     /**
      * @brief Adds pointlight to the rendering pipeline.
      *
@@ -51,6 +116,186 @@ public:
      * @brief Renders the scene consisting of everything in the render queue.
      */
     void render();
+
+    /**
+     * @brief Renders a snapshot taken by takeSnapshot(), on the thread owning
+     * the OpenGL context.
+     *
+     * @param snapshot ditto.
+     **/
+    void render(const FrameSnapshot& snapshot);
+
+    /**
+     * @brief Moves the render queue and the camera into a snapshot, copying
+     * the entities and lights, so they can change while a render thread
+     * draws the snapshot. Makes no OpenGL calls.
+     *
+     * @param snapshot ditto.
+     **/
+    void takeSnapshot(FrameSnapshot& snapshot);
+
+    /**
+     * @return Number of entities rejected by frustum culling in the last
+     *         rendered frame. With GPU culling only those rejected on the CPU,
+     *         a hierarchy's subtree at a time, are counted.
+     **/
+    uint getNumCulled() const;
+
+    /**
+     * @return Draw calls, state changes and culling time of the last frame.
+     **/
+    const RenderStatistics& getStatistics() const;
+
+    /**
+     * @brief Culls entities hidden behind occluders, meshes marked with an
+     * occluder element in their entity file, on the CPU. With GPU culling
+     * entities are tested against the last frame's depth instead. Enabled by
+     * default.
+     *
+     * @param enabled ditto.
+     **/
+    void setOcclusionCulling(const bool enabled);
+
+    /**
+     * @brief Draws the depth of the scene before the G-buffer pass, with
+     * cheap position-only shaders, so the G-buffer pass shades each pixel
+     * once. Pays off when overdraw is high. Disabled by default.
+     *
+     * @param enabled ditto.
+     **/
+    void setDepthPrepass(const bool enabled);
+
+    /**
+     * @brief Selects how point lights are shaded. Defaults to
+     * CLUSTERED_LIGHTING.
+     *
+     * @param mode ditto.
+     **/
+    void setLightingMode(const LightingMode mode);
+
+    /**
+     * @brief Sets how far bloom spreads.
+     *
+     * @param num_levels Number of levels in the bloom chain, each one reaching
+     *        twice as far as the previous one. Clamped to [1, 8], defaults
+     *        to 5.
+     **/
+    void setBloomRadius(const uint num_levels);
+
+    /**
+     * @brief Sets the brightness below which specular light doesn't bloom.
+     *
+     * @param threshold ditto. Defaults to 0, blooming everything.
+     **/
+    void setBloomThreshold(const float threshold);
+
+    /**
+     * @brief Spreads bright specular light around. Enabled by default.
+     *
+     * @param enabled ditto.
+     **/
+    void setBloom(const bool enabled);
+
+    /**
+     * @brief Smooths edges found in the G-buffer. Enabled by default.
+     *
+     * @param enabled ditto.
+     **/
+    void setAntialiasing(const bool enabled);
+
+    /**
+     * @brief Antialiases in the composite pass instead of a pass of its own,
+     * saving the write and read back of two full-screen targets. The image is
+     * the same. Enabled by default.
+     *
+     * @param enabled ditto.
+     **/
+    void setFusedPostProcessing(const bool enabled);
+
+    /**
+     * @brief Draws each run of scene meshes sharing a program and textures
+     * with one glMultiDrawElementsIndirect, so the CPU cost of drawing no
+     * longer grows with the number of meshes. Enabled by default when
+     * supported.
+     *
+     * @param enabled Ignored without isMultiDrawSupported().
+     **/
+    void setMultiDraw(const bool enabled);
+
+    /**
+     * @return Whether the context has GL_ARB_multi_draw_indirect and
+     *         GL_ARB_base_instance.
+     **/
+    bool isMultiDrawSupported() const;
+
+    /**
+     * @brief Culls the instances of the multi-draws in a compute shader,
+     * which writes the instance counts of the draw commands itself. The CPU
+     * then only culls hierarchies a subtree at a time. Enabled by default
+     * when supported.
+     *
+     * @param enabled Ignored without isGpuCullingSupported(). Only takes
+     *        effect with multi-draws.
+     **/
+    void setGpuCulling(const bool enabled);
+
+    /**
+     * @return Whether multi-draws are supported, and the context has
+     *         GL_ARB_compute_shader and GL_ARB_shader_storage_buffer_object.
+     **/
+    bool isGpuCullingSupported() const;
+
+    /**
+     * @brief Scales the resolution the scene is rendered at, so the GPU frame
+     * time stays under a target. The final pass upscales it to the display.
+     * Enabled by default, targeting 60 Hz.
+     *
+     * @param target_frame_time Frame time in milliseconds. 0 disables the
+     *        scaling and always renders at full resolution.
+     **/
+    void setTargetFrameTime(const float target_frame_time);
+
+    /**
+     * @return Fraction of the display width and height the last frame was
+     *         rendered at.
+     **/
+    float getRenderScale() const;
+
+    /**
+     * @brief GPU times of a pass over the last frames.
+     *
+     * Results lag a few frames behind. Nothing is timed without OpenGL 3.3.
+     *
+     * @param pass ditto.
+     * @return Times in milliseconds.
+     **/
+    const TimingStats& getPassTimings(const RenderPass pass) const;
+
+    /**
+     * @return GPU times of whole frames over the last frames in milliseconds.
+     **/
+    const TimingStats& getFrameTimings() const;
+
+    /**
+     * @return Human readable name of the pass.
+     **/
+    static const char* getPassName(const RenderPass pass);
+
+    /**
+     * @brief Renders the final image into an offscreen framebuffer instead of
+     * the window's, for contexts without a window. Only with OpenGL 3.3.
+     **/
+    void enableOffscreenOutput();
+
+    /**
+     * @brief Reads back the last rendered frame.
+     *
+     * Stalls until the GPU has finished the frame.
+     *
+     * @param rgba Resized to the display size, 4 bytes per pixel, rows from
+     *        top to bottom.
+     **/
+    void readOutput(vector<unsigned char>& rgba) const;
     
 private:
     uint m_display_width, m_display_height;
@@ -58,41 +303,164 @@ private:
     const OpenGLVersion m_opengl_version;
     
     struct {
-        GLuint gbuffer, pbuffer, ppbuffer;
+        /// Final image, 0 for the window's framebuffer.
+        GLuint output;
     } m_fbo;
+    /// Color and depth-stencil of an offscreen output.
+    GLuint m_output_renderbuffers[2];
 
+    /// Render targets and the passes between them, rebuilt when a setting
+    /// adds or removes passes.
+    RenderGraph m_render_graph;
+    bool m_render_graph_dirty;
     struct {
-        GLuint gbuffer, pbuffer;
-    } m_depth_stencil_buffers;
+        uint depth_prepass, gbuffer, depth_copy, lighting, antialiasing;
+        uint bloom_prefilter;
+        /// Indexed by the level drawn into.
+        vector<uint> bloom_downsample, bloom_upsample;
+        uint composite;
+    } m_passes;
+    struct {
+        uint depth;
+        /// The depth as sampled by the lighting pass, a copy when the pass
+        /// also has the depth attached.
+        uint sampled_depth;
+        /// Inputs of the lighting pass, the post-processing and composite.
+        uint gbuffer[3], lit[3], final[2];
+        vector<uint> bloom;
+    } m_targets;
 
     struct {
-        GLuint pointlights, spotlights;
+        GLuint spotlights;
     } m_uniform_blocks;
 
-    std::queue<shared_ptr<Entity> > m_render_queue;
-    std::queue<shared_ptr<PointLight> > m_pointlight_queue;
+    /// Every binding and enable of a frame goes through it.
+    StateCache m_state;
+
+    /// Per frame data: instance transforms and lights.
+    shared_ptr<RingBuffer> m_ring_buffer;
+    /// This frame's instance data in m_ring_buffer.
+    RingBuffer::Allocation m_instances;
+    /// This frame's indirect draw commands in m_ring_buffer, one per
+    /// DRAW_INSTANCES command for the full meshes, then one each for their
+    /// position-only streams.
+    RingBuffer::Allocation m_draw_commands;
+    uint m_num_draws;
+    bool m_multi_draw;
+    bool m_multi_draw_supported;
+    /// This frame's GpuCuller::DrawBounds in m_ring_buffer, one per draw,
+    /// with GPU culling.
+    RingBuffer::Allocation m_draw_bounds;
+    /// Set when supported.
+    shared_ptr<GpuCuller> m_gpu_culler;
+    bool m_gpu_culling;
+
+    /// One command buffer per recording thread.
+    vector<CommandBuffer> m_command_buffers;
+    uint m_num_command_buffers;
+    /// Record all command buffers but the first.
+    WorkerPool m_recording_workers;
+
+    /// Everything added since the last frame.
+    FrameSnapshot m_render_queue;
+    /// The snapshot being rendered, set during render().
+    const FrameSnapshot* m_frame;
     
     Entity m_gbuffer;
     Entity m_pbuffer;
     Entity m_ppbuffer;
+    /// m_ppbuffer antialiasing the lit diffuse as it reads it.
+    Entity m_fused_composite;
+    /// Bounding sphere drawn for each light with LIGHT_VOLUMES.
+    Entity m_light_volume;
+
+    /// Bloom chain, each level half the size of the previous one, the first
+    /// half the size of the display.
+    Entity m_bloom_prefilter;
+    Entity m_bloom_downsample;
+    Entity m_bloom_upsample;
+    bool m_bloom;
+    uint m_bloom_levels;
+    float m_bloom_threshold;
+    bool m_antialiasing;
+    bool m_fused_postprocessing;
+
+    /// Fraction of the display the scene is rendered to. The render targets
+    /// keep their full size, only the viewport shrinks.
+    float m_render_scale;
+    ResolutionScaler m_resolution_scaler;
+    bool m_dynamic_resolution;
+    /// Times every RenderPass, also driving the resolution scale.
+    shared_ptr<GpuTimer> m_gpu_timer;
 
     shared_ptr<Entity> m_camera;
+
+    glm::mat4 m_view;
+    glm::mat4 m_projection;
+
+    /// Texture buffers of the clustered lighting.
+    enum { LIGHT_CLUSTERS, LIGHT_INDICES, LIGHT_DATA, NUM_LIGHT_BUFFERS };
+    GLuint m_light_textures[NUM_LIGHT_BUFFERS];
+    /// Whether the textures view ranges of m_ring_buffer, otherwise they
+    /// have the buffers below.
+    bool m_light_buffer_ranges;
+    GLuint m_light_buffers[NUM_LIGHT_BUFFERS];
+    GLsizeiptr m_light_buffer_sizes[NUM_LIGHT_BUFFERS];
+    LightGrid m_light_grid;
+    vector<GLfloat> m_light_data;
+    LightingMode m_lighting_mode;
+
+    TransformStore m_transforms;
+    FrustumCuller m_frustum_culler;
+    OcclusionCuller m_occlusion_culler;
+    bool m_occlusion_culling;
+    bool m_depth_prepass;
+    vector<shared_ptr<Entity> > m_visible_entities;
+    uint m_num_culled;
+    RenderStatistics m_statistics;
     
-    void initBuffers(const GLuint width, const GLuint height);
+    void initBuffers();
+    void renderDepthPrepass();
     void renderGBuffers();
     void renderEntity(const gamefw::Entity& entity);
-    void texParametersForRenderTargets() const;
-    bool checkFramebuffer() const;
-    void createDepthStencilBuffer(GLuint* buffer, const GLuint width,
-                                  const GLuint height);
-    void createTexturesForFBO(shared_ptr<RenderJob> renderjob,
-                              const GLuint num_textures,
-                              const GLenum internalformats[],
-                              const GLuint size_divisor[],
-                              const GLenum types[]);
+    void bindRenderJob(const RenderJob& renderjob);
+    void useProgram(const GLuint program_id);
+    void bindTextures(const GLuint program_id, const RenderJob& renderjob);
+    void bindMesh(const RenderJob& renderjob, const bool depth_only = false);
+    void setInstanceAttributes(const bool enabled);
+    void setInstanceBuffer(const GLuint buffer, const GLintptr offset);
+    void drawInstances(const RenderJob& renderjob, const uint first_instance,
+                       const uint num_instances, const bool depth_only);
+    bool isGpuCulling() const;
+    void recordCommandBuffers();
+    void writeDrawCommands();
+    void executeCommandBuffers(const bool depth_only = false);
+    void executeMultiDraw(const bool depth_only);
+    void multiDraw(const GLintptr commands_offset, const uint first_draw,
+                   const uint num_draws);
+    void buildRenderGraph();
+    void setRenderTargets(const Entity& entity, const uint targets[],
+                          const uint num_targets);
     void renderPBuffers();
     void renderPPBuffers();
-    uint loadLightsIntoUniformBlocks();
+    void initBloom();
+    void renderBloom();
+    void renderBloomPass(const Entity& pass, const uint graph_pass,
+                         const GLuint source, const GLuint source_width,
+                         const GLuint source_height, const uint target_level);
+    void bindBloom(const GLuint program_id);
+    void updateRenderScale(const float frame_time);
+    void copyDepth();
+    uint loadLightsIntoClusters();
+    void streamLightBuffers(const void* data[], const GLsizeiptr sizes[]);
+    void uploadLightBuffer(const uint index, const GLsizeiptr size,
+                           const void* data);
+    void bindLightClusters(const GLuint program_id);
+    void bindGBufferDepth(const GLuint program_id);
+    void renderLightVolumes();
+    void updateCameraTransforms();
+    void cullRenderQueue();
+    uint cullOccluded();
     void renderRenderQueue();
 };
 
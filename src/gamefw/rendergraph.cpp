@@ -0,0 +1,355 @@
+#include "rendergraph.h"
+
+#include "gamefw.h"
+#include "debugoutput.h"
+
+#include <algorithm>
+
+using namespace gamefw;
+
+/// OpenGL formats and sizes of RenderGraph::Format.
+struct FormatInfo {
+    GLenum internalformat, format, type;
+    /// Formats of the same family hold each other's channels.
+    uint family;
+    uint channels;
+    uint bytes_per_texel;
+};
+
+const uint UNORM8 = 0, UNORM16 = 1, PACKED_FLOAT = 2, DEPTH = 3;
+
+// Drivers store RGB8 as four bytes.
+const FormatInfo FORMATS[RenderGraph::NUM_FORMATS] = {
+    {GL_R8, GL_RED, GL_UNSIGNED_BYTE, UNORM8, 1, 1},
+    {GL_RG8, GL_RG, GL_UNSIGNED_BYTE, UNORM8, 2, 2},
+    {GL_RGB8, GL_RGB, GL_UNSIGNED_BYTE, UNORM8, 3, 4},
+    {GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, UNORM8, 4, 4},
+    {GL_RG16, GL_RG, GL_UNSIGNED_SHORT, UNORM16, 2, 4},
+    {GL_R11F_G11F_B10F, GL_RGB, GL_FLOAT, PACKED_FLOAT, 3, 4},
+    {GL_DEPTH32F_STENCIL8, GL_DEPTH_STENCIL, GL_FLOAT_32_UNSIGNED_INT_24_8_REV,
+     DEPTH, 2, 8}
+};
+
+static GLuint shiftedSize(const GLuint size, const uint shift)
+{
+    return std::max(size >> shift, 1u);
+}
+
+RenderGraph::RenderGraph()
+{
+}
+
+RenderGraph::~RenderGraph()
+{
+    deleteResources();
+}
+
+void RenderGraph::clear()
+{
+    deleteResources();
+    m_textures.clear();
+    m_passes.clear();
+    m_physical_textures.clear();
+}
+
+uint RenderGraph::addTexture(const string& name, const Format format,
+                             const uint size_shift)
+{
+    Texture texture;
+    texture.name = name;
+    texture.format = format;
+    texture.size_shift = size_shift;
+    texture.physical = CULLED;
+    texture.first_use = texture.last_use = CULLED;
+    m_textures.push_back(texture);
+    return m_textures.size() - 1;
+}
+
+uint RenderGraph::addPass(const string& name, const bool output)
+{
+    Pass pass;
+    pass.name = name;
+    pass.output = output;
+    pass.culled = false;
+    pass.framebuffer = 0;
+    m_passes.push_back(pass);
+    return m_passes.size() - 1;
+}
+
+void RenderGraph::read(const uint pass, const uint texture)
+{
+    m_passes[pass].reads.push_back(texture);
+}
+
+void RenderGraph::write(const uint pass, const uint texture)
+{
+    m_passes[pass].writes.push_back(texture);
+}
+
+void RenderGraph::compile()
+{
+    cullPasses();
+    computeLifetimes();
+    assignPhysicalTextures();
+}
+
+void RenderGraph::cullPasses()
+{
+    // Walk back from the outputs, keeping passes writing what a kept pass
+    // reads.
+    vector<bool> needed(m_textures.size(), false);
+    for (int i = (int) m_passes.size() - 1; i >= 0; i--) {
+        Pass& pass = m_passes[i];
+        bool keep = pass.output;
+        foreach (uint texture, pass.writes) {
+            keep = keep || needed[texture];
+        }
+        pass.culled = !keep;
+        if (keep) {
+            foreach (uint texture, pass.reads) {
+                needed[texture] = true;
+            }
+        }
+    }
+}
+
+void RenderGraph::computeLifetimes()
+{
+    vector<bool> is_read(m_textures.size(), false);
+    for (uint i = 0; i < m_passes.size(); i++) {
+        if (m_passes[i].culled) {
+            continue;
+        }
+        foreach (uint texture, m_passes[i].reads) {
+            is_read[texture] = true;
+        }
+    }
+
+    foreach (Texture& texture, m_textures) {
+        texture.first_use = texture.last_use = CULLED;
+    }
+    for (uint i = 0; i < m_passes.size(); i++) {
+        if (m_passes[i].culled) {
+            continue;
+        }
+        vector<uint> used(m_passes[i].reads);
+        used.insert(used.end(), m_passes[i].writes.begin(),
+                    m_passes[i].writes.end());
+        foreach (uint index, used) {
+            Texture& texture = m_textures[index];
+            // Depth is kept for testing even when nothing samples it.
+            if (!is_read[index] && FORMATS[texture.format].family != DEPTH) {
+                continue;
+            }
+            if (texture.first_use == CULLED) {
+                texture.first_use = i;
+            }
+            texture.last_use = i;
+        }
+    }
+}
+
+void RenderGraph::assignPhysicalTextures()
+{
+    m_physical_textures.clear();
+    vector<bool> is_free;
+    foreach (Texture& texture, m_textures) {
+        texture.physical = CULLED;
+    }
+
+    for (uint i = 0; i < m_passes.size(); i++) {
+        if (m_passes[i].culled) {
+            continue;
+        }
+        foreach (Texture& texture, m_textures) {
+            if (texture.first_use != i) {
+                continue;
+            }
+            uint physical = findPhysicalTexture(texture, is_free);
+            if (physical == CULLED) {
+                PhysicalTexture new_texture;
+                new_texture.format = texture.format;
+                new_texture.size_shift = texture.size_shift;
+                new_texture.texture = 0;
+                m_physical_textures.push_back(new_texture);
+                is_free.push_back(false);
+                physical = m_physical_textures.size() - 1;
+            }
+            is_free[physical] = false;
+            // Widen to hold both, wider formats of a family come later.
+            m_physical_textures[physical].format = std::max(
+                m_physical_textures[physical].format, texture.format);
+            texture.physical = physical;
+        }
+        // Released after the pass, so its inputs and outputs never share.
+        foreach (const Texture& texture, m_textures) {
+            if (texture.last_use == i) {
+                is_free[texture.physical] = true;
+            }
+        }
+    }
+}
+
+uint RenderGraph::findPhysicalTexture(const Texture& texture,
+                                      const vector<bool>& is_free) const
+{
+    const FormatInfo& info = FORMATS[texture.format];
+    uint best = CULLED;
+    size_t best_cost = 0;
+    for (uint i = 0; i < m_physical_textures.size(); i++) {
+        const PhysicalTexture& physical = m_physical_textures[i];
+        const FormatInfo& physical_info = FORMATS[physical.format];
+        if (!is_free[i] || physical.size_shift != texture.size_shift ||
+            physical_info.family != info.family) {
+            continue;
+        }
+        // Prefer the texture growing the least.
+        size_t cost = std::max(info.bytes_per_texel, physical_info.bytes_per_texel) -
+                      physical_info.bytes_per_texel;
+        if (best == CULLED || cost < best_cost) {
+            best = i;
+            best_cost = cost;
+        }
+    }
+    return best;
+}
+
+void RenderGraph::createResources(const GLuint width, const GLuint height)
+{
+    deleteResources();
+
+    glActiveTexture(GL_TEXTURE0);
+    for (uint i = 0; i < m_physical_textures.size(); i++) {
+        PhysicalTexture& physical = m_physical_textures[i];
+        const FormatInfo& info = FORMATS[physical.format];
+        glGenTextures(1, &physical.texture);
+        glBindTexture(GL_TEXTURE_2D, physical.texture);
+        GLint filter = info.family == DEPTH ? GL_NEAREST : GL_LINEAR;
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        if (info.family == DEPTH) {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+        }
+        glTexImage2D(GL_TEXTURE_2D, 0, info.internalformat,
+                     shiftedSize(width, physical.size_shift),
+                     shiftedSize(height, physical.size_shift),
+                     0, info.format, info.type, 0);
+        // Named after the textures sharing it.
+        string label;
+        foreach (const Texture& texture, m_textures) {
+            if (texture.physical == i) {
+                label += (label.empty() ? "" : "/") + texture.name;
+            }
+        }
+        DebugOutput::label(GL_TEXTURE, physical.texture, label);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    foreach (Pass& pass, m_passes) {
+        if (pass.culled || pass.writes.empty()) {
+            continue;
+        }
+        glGenFramebuffers(1, &pass.framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, pass.framebuffer);
+        DebugOutput::label(GL_FRAMEBUFFER, pass.framebuffer, pass.name);
+        pass.draw_buffers.clear();
+        foreach (uint index, pass.writes) {
+            const Texture& texture = m_textures[index];
+            GLuint texture_id = getTexture(index);
+            if (FORMATS[texture.format].family == DEPTH) {
+                glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                                     texture_id, 0);
+                continue;
+            }
+            // Culled targets keep their slot, so shader outputs stay put.
+            GLenum attachment = GL_COLOR_ATTACHMENT0 + pass.draw_buffers.size();
+            glFramebufferTexture(GL_FRAMEBUFFER, attachment, texture_id, 0);
+            pass.draw_buffers.push_back(texture_id != 0 ? attachment : GL_NONE);
+        }
+        if (pass.draw_buffers.empty()) {
+            glDrawBuffer(GL_NONE);
+        } else {
+            glDrawBuffers(pass.draw_buffers.size(), &pass.draw_buffers[0]);
+        }
+        if (!checkFramebuffer()) {
+            LOG(logERROR) << "Incomplete framebuffer for the pass " << pass.name << ".";
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    checkOpenGLError();
+}
+
+void RenderGraph::deleteResources()
+{
+    foreach (PhysicalTexture& physical, m_physical_textures) {
+        if (physical.texture != 0) {
+            glDeleteTextures(1, &physical.texture);
+            physical.texture = 0;
+        }
+    }
+    foreach (Pass& pass, m_passes) {
+        if (pass.framebuffer != 0) {
+            glDeleteFramebuffers(1, &pass.framebuffer);
+            pass.framebuffer = 0;
+        }
+    }
+}
+
+bool RenderGraph::isCulled(const uint pass) const
+{
+    return m_passes[pass].culled;
+}
+
+void RenderGraph::bindFramebuffer(const uint pass, StateCache& state) const
+{
+    const Pass& render_pass = m_passes[pass];
+    state.bindFramebuffer(GL_DRAW_FRAMEBUFFER, render_pass.framebuffer);
+    if (!render_pass.draw_buffers.empty()) {
+        glDrawBuffers(render_pass.draw_buffers.size(),
+                      &render_pass.draw_buffers[0]);
+    }
+}
+
+GLuint RenderGraph::getFramebuffer(const uint pass) const
+{
+    return m_passes[pass].framebuffer;
+}
+
+GLuint RenderGraph::getTexture(const uint texture) const
+{
+    uint physical = m_textures[texture].physical;
+    if (physical == CULLED) {
+        return 0;
+    }
+    return m_physical_textures[physical].texture;
+}
+
+uint RenderGraph::getPhysicalTexture(const uint texture) const
+{
+    return m_textures[texture].physical;
+}
+
+uint RenderGraph::getNumPhysicalTextures() const
+{
+    return m_physical_textures.size();
+}
+
+RenderGraph::Format RenderGraph::getPhysicalFormat(const uint texture) const
+{
+    return m_physical_textures[m_textures[texture].physical].format;
+}
+
+size_t RenderGraph::getMemoryUsage(const GLuint width, const GLuint height) const
+{
+    size_t bytes = 0;
+    foreach (const PhysicalTexture& physical, m_physical_textures) {
+        bytes += (size_t) shiftedSize(width, physical.size_shift) *
+                 shiftedSize(height, physical.size_shift) *
+                 FORMATS[physical.format].bytes_per_texel;
+    }
+    return bytes;
+}
@@ -0,0 +1,184 @@
+#ifndef RENDERGRAPH_H
+#define RENDERGRAPH_H
+
+#include "../common.h"
+#include "../ogl.h"
+
+#include "statecache.h"
+
+namespace gamefw {
+
+/**
+ * @brief Render targets and the passes reading and writing them.
+ *
+ * Passes are added in the order they run and declare the textures they read
+ * and write. compile() then culls passes whose results are never read, works
+ * out when each texture is first and last used and assigns textures whose
+ * lifetimes don't overlap to the same physical texture. A texture can land
+ * in a free physical texture of the same size and a wider format of the same
+ * kind, R8 in RGBA8 for example, which is then widened to fit. This way
+ * transient targets share memory, and passes can be added or dropped without
+ * rewiring the others.
+ *
+ * Usage:
+ * \code
+ * uint color = graph.addTexture("Color", RenderGraph::RGBA8);
+ * uint scene = graph.addPass("Scene");
+ * graph.write(scene, color);
+ * uint output = graph.addPass("Output", true);
+ * graph.read(output, color);
+ * graph.compile();
+ * graph.createResources(width, height);
+ * ...
+ * graph.bindFramebuffer(scene, state);
+ * \endcode
+ **/
+class RenderGraph
+{
+public:
+    enum Format {
+        R8,
+        RG8,
+        RGB8,
+        RGBA8,
+        RG16,
+        R11F_G11F_B10F,
+        DEPTH32F_STENCIL8,
+        NUM_FORMATS
+    };
+
+    /// Marks passes and textures left out by compile().
+    static const uint CULLED = ~0u;
+
+    RenderGraph();
+    ~RenderGraph();
+
+    /**
+     * @brief Removes every pass and texture, deleting the OpenGL objects.
+     **/
+    void clear();
+
+    /**
+     * @param name For logging.
+     * @param format ditto.
+     * @param size_shift The texture is the size of the display shifted right
+     *        by this, at least 1x1.
+     * @return Handle of the texture.
+     **/
+    uint addTexture(const string& name, const Format format,
+                    const uint size_shift = 0);
+
+    /**
+     * @param name For logging.
+     * @param output Whether the pass has effects outside the graph, drawing
+     *        into the window for example. Output passes are never culled.
+     * @return Handle of the pass.
+     **/
+    uint addPass(const string& name, const bool output = false);
+
+    /**
+     * @brief Declares that a pass samples a texture.
+     **/
+    void read(const uint pass, const uint texture);
+
+    /**
+     * @brief Declares that a pass renders into a texture.
+     *
+     * Color textures are attached in the order they are written, the first
+     * to GL_COLOR_ATTACHMENT0. A depth texture becomes the depth-stencil
+     * attachment.
+     **/
+    void write(const uint pass, const uint texture);
+
+    /**
+     * @brief Culls passes, computes lifetimes and assigns physical textures.
+     **/
+    void compile();
+
+    /**
+     * @brief Creates the physical textures and a framebuffer for every
+     * remaining pass writing any, replacing those created before.
+     *
+     * @param width Display width.
+     * @param height Display height.
+     **/
+    void createResources(const GLuint width, const GLuint height);
+
+    bool isCulled(const uint pass) const;
+
+    /**
+     * @brief Binds the framebuffer of a pass for drawing, with the draw
+     * buffers of its color attachments.
+     *
+     * @param pass ditto.
+     * @param state Binds through it.
+     **/
+    void bindFramebuffer(const uint pass, StateCache& state) const;
+
+    GLuint getFramebuffer(const uint pass) const;
+
+    /**
+     * @return OpenGL texture, 0 if the texture was culled.
+     **/
+    GLuint getTexture(const uint texture) const;
+
+    /**
+     * @return Index of the physical texture, CULLED if the texture isn't
+     *         needed. Color textures nothing reads aren't.
+     **/
+    uint getPhysicalTexture(const uint texture) const;
+
+    uint getNumPhysicalTextures() const;
+
+    /**
+     * @return Format of the physical texture a texture was assigned to.
+     **/
+    Format getPhysicalFormat(const uint texture) const;
+
+    /**
+     * @return Memory taken by the physical textures at the given display
+     *         size, in bytes.
+     **/
+    size_t getMemoryUsage(const GLuint width, const GLuint height) const;
+
+private:
+    struct Texture {
+        string name;
+        Format format;
+        uint size_shift;
+        uint physical;
+        /// First and last pass using the texture, ignoring culled passes.
+        uint first_use, last_use;
+    };
+
+    struct Pass {
+        string name;
+        bool output;
+        bool culled;
+        vector<uint> reads;
+        vector<uint> writes;
+        GLuint framebuffer;
+        vector<GLenum> draw_buffers;
+    };
+
+    struct PhysicalTexture {
+        Format format;
+        uint size_shift;
+        GLuint texture;
+    };
+
+    void cullPasses();
+    void computeLifetimes();
+    void assignPhysicalTextures();
+    uint findPhysicalTexture(const Texture& texture,
+                             const vector<bool>& is_free) const;
+    void deleteResources();
+
+    vector<Texture> m_textures;
+    vector<Pass> m_passes;
+    vector<PhysicalTexture> m_physical_textures;
+};
+
+}
+
+#endif // RENDERGRAPH_H
@@ -6,13 +6,21 @@ using namespace gamefw;
 
 RenderJob::RenderJob()
 :
-m_num_textures(0)
+m_num_textures(0),
+m_cullable(true),
+m_occluder(false),
+m_alpha_tested(false)
 {
     m_buffer_objects.element_buffer = 0;
     m_buffer_objects.vao = 0;
     m_buffer_objects.vertex_buffer = 0;
     m_buffer_objects.vertex_extra_buffer = 0;
-    m_uniforms.materials = 0;
+    m_buffer_objects.depth_vao = 0;
+    m_buffer_objects.position_buffer = 0;
+    m_buffer_objects.depth_element_buffer = 0;
+    m_mesh_range.first_index = m_depth_mesh_range.first_index = 0;
+    m_mesh_range.num_indices = m_depth_mesh_range.num_indices = 0;
+    m_mesh_range.base_vertex = m_depth_mesh_range.base_vertex = 0;
 }
 
 RenderJob::~RenderJob()
@@ -20,16 +28,26 @@ RenderJob::~RenderJob()
     if (m_num_textures > 0) {
         delete [] m_textures;
     }
+    if (m_buffer_objects.vao == 0) { // Never uploaded or pooled.
+        return;
+    }
     glDeleteVertexArrays(1, &m_buffer_objects.vao);
     glDeleteBuffers(1, &m_buffer_objects.element_buffer);
     glDeleteBuffers(1, &m_buffer_objects.vertex_buffer);
     glDeleteBuffers(1, &m_buffer_objects.vertex_extra_buffer);
-    glDeleteBuffers(1, &m_uniforms.materials);
+    if (m_buffer_objects.depth_vao != 0) {
+        glDeleteVertexArrays(1, &m_buffer_objects.depth_vao);
+        glDeleteBuffers(1, &m_buffer_objects.position_buffer);
+        glDeleteBuffers(1, &m_buffer_objects.depth_element_buffer);
+    }
 }
 
 
-GLuint RenderJob::getShaderProgramID()
+GLuint RenderJob::getShaderProgramID() const
 {
+    if (!m_shaderprogram) {
+        return 0;
+    }
     return m_shaderprogram->getProgramID();
 }
 
@@ -38,6 +56,41 @@ void RenderJob::setShaderProgram(shared_ptr< ShaderProgram > shaderprogram)
     m_shaderprogram = shaderprogram;
 }
 
+GLuint RenderJob::getDepthShaderProgramID() const
+{
+    if (!m_depth_shaderprogram) {
+        return 0;
+    }
+    return m_depth_shaderprogram->getProgramID();
+}
+
+void RenderJob::setDepthShaderProgram(shared_ptr<ShaderProgram> shaderprogram)
+{
+    m_depth_shaderprogram = shaderprogram;
+}
+
+GLuint RenderJob::getVertexArray(const bool depth_only) const
+{
+    if (depth_only && m_depth_mesh_pool) {
+        return m_depth_mesh_pool->getVertexArray();
+    }
+    if (depth_only && m_buffer_objects.depth_vao != 0) {
+        return m_buffer_objects.depth_vao;
+    }
+    if (m_mesh_pool) {
+        return m_mesh_pool->getVertexArray();
+    }
+    return m_buffer_objects.vao;
+}
+
+const MeshPool::Range& RenderJob::getMeshRange(const bool depth_only) const
+{
+    if (depth_only && (m_depth_mesh_pool || m_buffer_objects.depth_vao != 0)) {
+        return m_depth_mesh_range;
+    }
+    return m_mesh_range;
+}
+
     
 
 
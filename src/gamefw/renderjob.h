@@ -5,13 +5,16 @@
 #include <boost/preprocessor.hpp>
 
 #include "shaderprogram.h"
+#include "boundingvolume.h"
+#include "meshpool.h"
+#include "materialregistry.h"
 
 namespace gamefw {
 
 #define T_VERTEX (POSITION)(NORMAL)(TEXCOORD)(MATERIAL_IDX)
 #define T_VERTEX_EXTRA (TANGENT)(BITANGENT)
 #define UNIFORM_BLOCKS (MATERIAL)
-#define OUT_GBUFFERS (OUTG_DIFFUSE)(OUTG_SPECULAR)(OUTG_NORMAL)(OUTG_POSITION)(OUTG_EXTRA)
+#define OUT_GBUFFERS (OUTG_DIFFUSE)(OUTG_SPECULAR)(OUTG_NORMAL)
 #define OUT_PBUFFERS (OUTP_DIFFUSE)(OUTP_SPECULAR)(OUTP_EDGES)(OUTP_BLOOM)
 #define OUT_POSTPROCBUFFERS (OUTPP_DIFFUSE)(OUTPP_SPECULAR)
 
@@ -31,6 +34,15 @@ namespace renderjob_enums {
     static const char* out_gbuffers_strings[] = {BOOST_PP_SEQ_FOR_EACH(TO_STR,~,OUT_GBUFFERS)};
     static const char* out_pbuffers_strings[] = {BOOST_PP_SEQ_FOR_EACH(TO_STR,~,OUT_PBUFFERS)};
     static const char* out_ppbuffers_strings[] = {BOOST_PP_SEQ_FOR_EACH(TO_STR,~,OUT_POSTPROCBUFFERS)};
+
+    // Per instance attributes. Each matrix takes four consecutive locations
+    // after the vertex attributes.
+    enum instance_attribs {
+        INSTANCE_MODEL = MATERIAL_IDX + 1,
+        INSTANCE_NORMALMATRIX = INSTANCE_MODEL + 4
+    };
+    static const char* instance_strings[] = {"INSTANCE_MODEL", "INSTANCE_NORMALMATRIX"};
+    static const int instance_locations[] = {INSTANCE_MODEL, INSTANCE_NORMALMATRIX};
 }
 
 #undef T_VERTEX 
@@ -48,31 +60,84 @@ public:
     ~RenderJob();
 
     void setShaderProgram(shared_ptr<ShaderProgram> m_shaderprogram);
-    GLuint getShaderProgramID();
+    GLuint getShaderProgramID() const;
+
+    /**
+     * @brief Sets the program drawing only depth, for the depth pre-pass.
+     **/
+    void setDepthShaderProgram(shared_ptr<ShaderProgram> shaderprogram);
+
+    /**
+     * @return The depth-only program, 0 if there is none.
+     **/
+    GLuint getDepthShaderProgramID() const;
+
+    /**
+     * @param depth_only Whether the position-only stream is wanted. Meshes
+     *        without one, like alpha tested ones, give their full vertex
+     *        array.
+     * @return The vertex array drawing the mesh.
+     **/
+    GLuint getVertexArray(const bool depth_only = false) const;
+
+    /**
+     * @return Where the mesh lies in the buffers of getVertexArray().
+     **/
+    const MeshPool::Range& getMeshRange(const bool depth_only = false) const;
 
     /// OpenGL buffer objects.
     struct {
         GLuint vao, vertex_buffer,
                vertex_extra_buffer, element_buffer;
+        /// Position-only stream for depth-only drawing, indexed separately
+        /// so shared positions are transformed once.
+        GLuint depth_vao, position_buffer, depth_element_buffer;
     } m_buffer_objects;
 
+    /// Buffers shared with other meshes holding the mesh and its
+    /// position-only stream, instead of m_buffer_objects. Null for meshes with
+    /// buffers of their own.
+    shared_ptr<MeshPool> m_mesh_pool, m_depth_mesh_pool;
+    /// Where the mesh lies in its buffers, shared or not.
+    MeshPool::Range m_mesh_range, m_depth_mesh_range;
+
     /// Array of textures.
     GLuint* m_textures;
 
     /// Number of textures. The destructor uses this value to deallocate m_textures.
     GLuint m_num_textures;
 
-    /// The shader program uniforms.
-    struct {
-        GLuint materials;
-    } m_uniforms;
+    /// Materials the vertices' material indices refer to, shared by all
+    /// meshes. Null for meshes without materials.
+    shared_ptr<MaterialRegistry> m_materials;
 
 
     /// Number of vertices in the model.
     int m_vertex_count;
+
+    /// Model space bounds, computed when the model is loaded.
+    BoundingVolume m_bounds;
+
+    /// False for meshes that must never be culled, such as the skybox.
+    bool m_cullable;
+
+    /// True for large meshes hiding what's behind them, drawn into the
+    /// renderer's occlusion buffer. Their vertices must not be displaced in
+    /// the shaders.
+    bool m_occluder;
+
+    /// True for meshes discarding their transparent texels, whose depth-only
+    /// program reads their albedo through the full vertex array and textures.
+    bool m_alpha_tested;
+
+    /// CPU copy of an occluder's triangles, x, y and z of each vertex and
+    /// three indices per triangle. Empty for other meshes.
+    vector<GLfloat> m_occluder_positions;
+    vector<GLushort> m_occluder_indices;
     
 private:
     shared_ptr<ShaderProgram> m_shaderprogram;
+    shared_ptr<ShaderProgram> m_depth_shaderprogram;
 };
 
 }
@@ -0,0 +1,60 @@
+#include "resolutionscaler.h"
+
+#include <algorithm>
+
+using namespace gamefw;
+
+/// Fraction of the target aimed for, leaving room for the CPU and noise.
+const float HEADROOM = 0.9f;
+/// Fraction of the way to the ideal scale moved per frame when going down.
+const float DECREASE_RATE = 0.5f;
+/// Fraction of the way to the ideal scale moved per frame when going up.
+const float INCREASE_RATE = 0.1f;
+/// Relative changes below this are ignored to keep the scale steady.
+const float DEAD_ZONE = 0.02f;
+
+ResolutionScaler::ResolutionScaler(const float target_frame_time,
+                                   const float min_scale,
+                                   const float max_scale)
+:
+m_target_frame_time(target_frame_time),
+m_min_scale(min_scale),
+m_max_scale(max_scale),
+m_scale(max_scale)
+{
+}
+
+float ResolutionScaler::update(const float frame_time)
+{
+    if (frame_time <= 0.0f) {
+        return m_scale;
+    }
+
+    float ideal = m_scale * glm::sqrt(m_target_frame_time * HEADROOM / frame_time);
+    ideal = std::max(m_min_scale, std::min(ideal, m_max_scale));
+    if (glm::abs(ideal - m_scale) < m_scale * DEAD_ZONE) {
+        return m_scale;
+    }
+
+    float rate = ideal < m_scale ? DECREASE_RATE : INCREASE_RATE;
+    m_scale += (ideal - m_scale) * rate;
+    if (glm::abs(ideal - m_scale) < m_scale * DEAD_ZONE) { // Close enough.
+        m_scale = ideal;
+    }
+    return m_scale;
+}
+
+void ResolutionScaler::setTargetFrameTime(const float milliseconds)
+{
+    m_target_frame_time = milliseconds;
+}
+
+float ResolutionScaler::getTargetFrameTime() const
+{
+    return m_target_frame_time;
+}
+
+float ResolutionScaler::getScale() const
+{
+    return m_scale;
+}
@@ -0,0 +1,58 @@
+#ifndef RESOLUTIONSCALER_H
+#define RESOLUTIONSCALER_H
+
+#include "../common.h"
+
+namespace gamefw {
+
+/**
+ * @brief Picks the fraction of the display resolution to render at, so the
+ * measured GPU frame time stays under a target.
+ *
+ * The frame time is assumed to grow with the number of pixels, that is with
+ * the square of the scale. The scale drops quickly when frames get slow and
+ * recovers slowly, so load spikes are absorbed without oscillating.
+ **/
+class ResolutionScaler
+{
+public:
+    /**
+     * @param target_frame_time Frame time to stay under in milliseconds.
+     * @param min_scale Smallest scale, as a fraction of the display size.
+     * @param max_scale Largest scale, as a fraction of the display size.
+     **/
+    ResolutionScaler(const float target_frame_time = 1000.0f / 60.0f,
+                     const float min_scale = 0.5f,
+                     const float max_scale = 1.0f);
+
+    /**
+     * @brief Adjusts the scale to a measured frame.
+     *
+     * @param frame_time GPU time of a frame rendered at the current scale in
+     *        milliseconds.
+     * @return The new scale.
+     **/
+    float update(const float frame_time);
+
+    /**
+     * @param milliseconds Frame time to stay under.
+     **/
+    void setTargetFrameTime(const float milliseconds);
+
+    float getTargetFrameTime() const;
+
+    /**
+     * @return Fraction of the display width and height to render at.
+     **/
+    float getScale() const;
+
+private:
+    float m_target_frame_time;
+    float m_min_scale;
+    float m_max_scale;
+    float m_scale;
+};
+
+}
+
+#endif // RESOLUTIONSCALER_H
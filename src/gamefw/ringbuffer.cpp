@@ -0,0 +1,168 @@
+#include "ringbuffer.h"
+
+#include "debugoutput.h"
+
+using namespace gamefw;
+
+/// Nanoseconds to wait for a fence before logging a warning and waiting again.
+const GLuint64 FENCE_TIMEOUT = 1000000000;
+
+RingBuffer::RingBuffer(const GLsizeiptr frame_size, const uint num_frames)
+:
+m_num_frames(num_frames),
+m_persistent(GLEW_ARB_buffer_storage),
+m_alignment(1),
+m_buffer(0),
+m_frame_size(0),
+m_data(0),
+m_fences(num_frames, (GLsync) 0),
+m_frame(0),
+m_head(0)
+{
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &m_alignment);
+    if (GLEW_ARB_shader_storage_buffer_object) {
+        GLint storage_alignment = 1;
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT,
+                      &storage_alignment);
+        m_alignment = std::max(m_alignment, storage_alignment);
+    }
+    if (GLEW_ARB_texture_buffer_range) {
+        GLint texture_alignment = 1;
+        glGetIntegerv(GL_TEXTURE_BUFFER_OFFSET_ALIGNMENT, &texture_alignment);
+        m_alignment = std::max(m_alignment, texture_alignment);
+    }
+    m_alignment = std::max(m_alignment, (GLint) 16);
+    create(frame_size);
+}
+
+RingBuffer::~RingBuffer()
+{
+    destroy();
+}
+
+void RingBuffer::beginFrame()
+{
+    m_frame = (m_frame + 1) % m_num_frames;
+    m_head = 0;
+    waitForFence(m_frame);
+}
+
+void RingBuffer::endFrame()
+{
+    if (m_fences[m_frame]) {
+        glDeleteSync(m_fences[m_frame]);
+    }
+    m_fences[m_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+RingBuffer::Allocation RingBuffer::allocate(const GLsizeiptr size)
+{
+    GLsizeiptr aligned_size = (size + m_alignment - 1) / m_alignment * m_alignment;
+
+    if (m_head + aligned_size > m_frame_size) {
+        // Out of space. Replace the buffer with a larger one. Draws already
+        // issued keep reading the old buffer, the driver frees it afterwards.
+        GLsizeiptr frame_size = m_frame_size;
+        while (frame_size < m_head + aligned_size) {
+            frame_size *= 2;
+        }
+        LOG(logINFO) << "Growing ring buffer sections to " << frame_size
+                     << " bytes.";
+        destroy();
+        create(frame_size);
+        m_head = 0;
+    }
+
+    Allocation allocation;
+    allocation.offset = m_frame * m_frame_size + m_head;
+    allocation.size = size;
+    allocation.data = m_data + allocation.offset;
+    m_head += aligned_size;
+    return allocation;
+}
+
+void RingBuffer::flush(const Allocation& allocation)
+{
+    if (m_persistent) {
+        return;
+    }
+    // The section is past its fence, so this doesn't wait on the GPU.
+    glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+    glBufferSubData(GL_ARRAY_BUFFER, allocation.offset, allocation.size,
+                    allocation.data);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+GLsizeiptr RingBuffer::getAlignment() const
+{
+    return m_alignment;
+}
+
+GLuint RingBuffer::getBufferID() const
+{
+    return m_buffer;
+}
+
+bool RingBuffer::isPersistent() const
+{
+    return m_persistent;
+}
+
+void RingBuffer::create(const GLsizeiptr frame_size)
+{
+    m_frame_size = (frame_size + m_alignment - 1) / m_alignment * m_alignment;
+    const GLsizeiptr total_size = m_frame_size * m_num_frames;
+
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+    DebugOutput::label(GL_BUFFER, m_buffer, "Ring buffer");
+    if (m_persistent) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+                                 GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, total_size, 0, flags);
+        m_data = (char*) glMapBufferRange(GL_ARRAY_BUFFER, 0, total_size, flags);
+        assert(m_data);
+    } else {
+        glBufferData(GL_ARRAY_BUFFER, total_size, 0, GL_STREAM_DRAW);
+        m_shadow.resize(total_size);
+        m_data = &m_shadow[0];
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void RingBuffer::destroy()
+{
+    for (uint i = 0; i < m_num_frames; i++) {
+        if (m_fences[i]) {
+            glDeleteSync(m_fences[i]);
+            m_fences[i] = 0;
+        }
+    }
+    if (m_persistent && m_data) {
+        glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &m_buffer);
+    m_buffer = 0;
+    m_data = 0;
+}
+
+void RingBuffer::waitForFence(const uint frame)
+{
+    GLsync fence = m_fences[frame];
+    if (!fence) {
+        return;
+    }
+    GLenum result = glClientWaitSync(fence, 0, 0);
+    while (result == GL_TIMEOUT_EXPIRED) {
+        // Flush so the fence is guaranteed to signal.
+        result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                  FENCE_TIMEOUT);
+        if (result == GL_TIMEOUT_EXPIRED) {
+            LOG(logWARNING) << "GPU still reading ring buffer frame " << frame;
+        }
+    }
+    glDeleteSync(fence);
+    m_fences[frame] = 0;
+}
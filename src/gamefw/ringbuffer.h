@@ -0,0 +1,114 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include "../common.h"
+#include "../ogl.h"
+
+namespace gamefw {
+
+/**
+ * @brief Buffer object streaming per frame data to the GPU without
+ * reallocations.
+ *
+ * The buffer is split into one section per frame in flight. Each frame writes
+ * into its own section and fences it, and the section is only reused once the
+ * GPU has passed the fence. With ARB_buffer_storage the buffer is mapped
+ * persistently and coherently so data is written straight into it, otherwise
+ * writes go to a shadow copy that flush() uploads to the section.
+ *
+ * Sections grow when a frame runs out of space. Growing replaces the buffer,
+ * so getBufferID() must be read after allocating, and earlier allocations of
+ * the frame must already be flushed and drawn with.
+ **/
+class RingBuffer
+{
+public:
+    /// A range of the current frame's section.
+    struct Allocation {
+        /// Where the data is written.
+        void* data;
+        /// Offset of the range in the buffer object.
+        GLintptr offset;
+        GLsizeiptr size;
+    };
+
+    /**
+     * @brief Creates the buffer object. Requires a current OpenGL context.
+     *
+     * @param frame_size Initial size in bytes of each frame's section.
+     * @param num_frames Number of frames the GPU may lag behind.
+     **/
+    RingBuffer(const GLsizeiptr frame_size, const uint num_frames = 3);
+    ~RingBuffer();
+
+    /**
+     * @brief Moves to the next frame's section, waiting for the GPU if it
+     * still reads it.
+     **/
+    void beginFrame();
+
+    /**
+     * @brief Fences the current frame's section.
+     **/
+    void endFrame();
+
+    /**
+     * @brief Reserves space for this frame's data.
+     *
+     * Offsets are aligned so ranges can be bound as uniform blocks, and as
+     * shader storage blocks and texture buffers when supported.
+     *
+     * @param size Size in bytes.
+     **/
+    Allocation allocate(const GLsizeiptr size);
+
+    /**
+     * @brief Makes the data written to the allocation visible to the GPU.
+     *
+     * Does nothing when the buffer is persistently mapped.
+     **/
+    void flush(const Allocation& allocation);
+
+    /**
+     * @return Alignment of allocated offsets in bytes. Ranges carved out of
+     *         one allocation must start at multiples of it to be bound.
+     **/
+    GLsizeiptr getAlignment() const;
+
+    /**
+     * @return The buffer object.
+     **/
+    GLuint getBufferID() const;
+
+    /**
+     * @return Whether the buffer is persistently mapped.
+     **/
+    bool isPersistent() const;
+
+private:
+    RingBuffer(const RingBuffer&);
+    RingBuffer& operator=(const RingBuffer&);
+
+    void create(const GLsizeiptr frame_size);
+    void destroy();
+    void waitForFence(const uint frame);
+
+    const uint m_num_frames;
+    const bool m_persistent;
+    GLint m_alignment;
+
+    GLuint m_buffer;
+    GLsizeiptr m_frame_size;
+    /// Persistent mapping of the whole buffer, or the shadow copy.
+    char* m_data;
+    vector<char> m_shadow;
+    vector<GLsync> m_fences;
+
+    uint m_frame;
+    /// Next free byte in the current frame's section.
+    GLsizeiptr m_head;
+};
+
+}
+
+#endif // RINGBUFFER_H
@@ -0,0 +1,77 @@
+#include "semaphore.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+using namespace gamefw;
+
+#ifdef _WIN32
+Semaphore::Semaphore(const uint count)
+:
+m_handle(CreateSemaphore(0, count, LONG_MAX, 0))
+{
+}
+
+Semaphore::~Semaphore()
+{
+    CloseHandle((HANDLE) m_handle);
+}
+
+void Semaphore::wait()
+{
+    WaitForSingleObject((HANDLE) m_handle, INFINITE);
+}
+
+void Semaphore::post()
+{
+    ReleaseSemaphore((HANDLE) m_handle, 1, 0);
+}
+#else
+// POSIX semaphores are missing on OS X, build one from a condition variable.
+struct SemaphoreState {
+    pthread_mutex_t mutex;
+    pthread_cond_t condition;
+    uint count;
+};
+
+Semaphore::Semaphore(const uint count)
+:
+m_handle(new SemaphoreState)
+{
+    SemaphoreState* state = (SemaphoreState*) m_handle;
+    pthread_mutex_init(&state->mutex, 0);
+    pthread_cond_init(&state->condition, 0);
+    state->count = count;
+}
+
+Semaphore::~Semaphore()
+{
+    SemaphoreState* state = (SemaphoreState*) m_handle;
+    pthread_cond_destroy(&state->condition);
+    pthread_mutex_destroy(&state->mutex);
+    delete state;
+}
+
+void Semaphore::wait()
+{
+    SemaphoreState* state = (SemaphoreState*) m_handle;
+    pthread_mutex_lock(&state->mutex);
+    while (state->count == 0) {
+        pthread_cond_wait(&state->condition, &state->mutex);
+    }
+    state->count--;
+    pthread_mutex_unlock(&state->mutex);
+}
+
+void Semaphore::post()
+{
+    SemaphoreState* state = (SemaphoreState*) m_handle;
+    pthread_mutex_lock(&state->mutex);
+    state->count++;
+    pthread_cond_signal(&state->condition);
+    pthread_mutex_unlock(&state->mutex);
+}
+#endif
@@ -0,0 +1,42 @@
+#ifndef SEMAPHORE_H
+#define SEMAPHORE_H
+
+#include "../common.h"
+
+namespace gamefw {
+
+/**
+ * @brief Counting semaphore, for handing work between threads without
+ * polling. SFML has no condition variables.
+ **/
+class Semaphore
+{
+public:
+    /**
+     * @param count Initial count.
+     **/
+    Semaphore(const uint count = 0);
+    ~Semaphore();
+
+    /**
+     * @brief Waits until the count is above zero and decrements it.
+     **/
+    void wait();
+
+    /**
+     * @brief Increments the count, waking up a waiting thread.
+     **/
+    void post();
+
+private:
+    Semaphore(const Semaphore&);
+    Semaphore& operator=(const Semaphore&);
+
+    // Platform handle, kept opaque so system headers stay out of the
+    // interface.
+    void* m_handle;
+};
+
+}
+
+#endif // SEMAPHORE_H
@@ -60,6 +60,7 @@ void ShaderFactory::loadSources()
 
 void ShaderFactory::reloadShaders()
 {
+    PROFILE_ZONE("ShaderFactory::reloadShaders");
     deallocateSources();
     loadSources();
 
@@ -73,6 +74,7 @@ void ShaderFactory::reloadShaders()
 
 shared_ptr<ShaderProgram> ShaderFactory::makeShader(const set< string >& defines)
 {
+    PROFILE_ZONE("ShaderFactory::makeShader");
     vector<GLuint> possible_programs;
 
     if (defines.empty()) { // Defines not allowed to be empty.
@@ -1,6 +1,7 @@
 #include "shaderprogram.h"
 
 #include "renderjob.h"
+#include "debugoutput.h"
 
 #include <sstream>
 
@@ -17,11 +18,31 @@ ShaderProgram::ShaderProgram(char const* vertex_source,
                              const set< string >& defines,
                              const OpenGLVersion opengl_version)
 :
-m_defines(defines),
+m_compute_shader(0),
 m_vertex_source(vertex_source),
 m_geometry_source(geometry_source),
 m_fragment_source(fragment_source),
-m_opengl_version(opengl_version)
+m_compute_source(0),
+m_opengl_version(opengl_version),
+m_defines(defines)
+{
+    m_program_id = glCreateProgram();
+    makeProgram(m_program_id);
+}
+
+ShaderProgram::ShaderProgram(char const* compute_source,
+                             const set<string>& defines)
+:
+m_vertex_shader(0),
+m_geometry_shader(0),
+m_fragment_shader(0),
+m_compute_shader(0),
+m_vertex_source(0),
+m_geometry_source(0),
+m_fragment_source(0),
+m_compute_source(compute_source),
+m_opengl_version(OGL_3_3),
+m_defines(defines)
 {
     m_program_id = glCreateProgram();
     makeProgram(m_program_id);
@@ -41,6 +62,11 @@ ShaderProgram::~ShaderProgram()
 
 void ShaderProgram::deleteShaders()
 {
+    if (m_compute_source) {
+        glDetachShader(m_program_id, m_compute_shader);
+        glDeleteShader(m_compute_shader);
+        return;
+    }
     glDetachShader(m_program_id, m_vertex_shader);
     glDetachShader(m_program_id, m_fragment_shader);
     // TODO: Detach & delete geometry shader.
@@ -74,11 +100,23 @@ const set< string >& ShaderProgram::getDefines() const
 GLuint ShaderProgram::compileShader(GLenum type, const set<string>& defines,
                                     char const* source)
 {
+    PROFILE_ZONE("ShaderProgram::compileShader");
     GLuint shader = glCreateShader(type);
 
     // Create char** consisting of given defines and lastly the shader source.
     vector<char const*> compiler_input;
 
+    // The version directive must stay on the first line, ahead of the defines.
+    if (strncmp(source, "#version", 8) == 0) {
+        const char* end_of_line = strchr(source, '\n');
+        size_t length = end_of_line ? end_of_line + 1 - source : strlen(source);
+        char* line = new char[length + 1];
+        strncpy(line, source, length);
+        line[length] = '\0';
+        compiler_input.push_back(line);
+        source += length;
+    }
+
     foreach (string define, defines) {
         string s = "#define ";
         s += define;
@@ -133,6 +171,16 @@ GLuint ShaderProgram::compileShader(GLenum type, const set<string>& defines,
 
 void ShaderProgram::makeProgram(const GLuint program_id)
 {
+    PROFILE_ZONE("ShaderProgram::makeProgram");
+    if (m_compute_source) {
+        GLuint compute_shader = compileShader(GL_COMPUTE_SHADER, m_defines,
+                                              m_compute_source);
+        glAttachShader(program_id, compute_shader);
+        linkProgram(program_id);
+        m_compute_shader = compute_shader;
+        return;
+    }
+
     GLuint vertex_shader = compileShader(GL_VERTEX_SHADER, m_defines, m_vertex_source);
     GLuint fragment_shader = compileShader(GL_FRAGMENT_SHADER, m_defines, m_fragment_source);
 
@@ -147,6 +195,13 @@ void ShaderProgram::makeProgram(const GLuint program_id)
         glBindAttribLocation(program_id, renderjob_enums::NORMAL, "in_normal");
         glBindAttribLocation(program_id, renderjob_enums::TEXCOORD, "in_texcoord");
     }
+    linkProgram(program_id);
+    m_vertex_shader = vertex_shader;
+    m_fragment_shader = fragment_shader;
+}
+
+void ShaderProgram::linkProgram(const GLuint program_id)
+{
     glLinkProgram(program_id);
 
     GLint status_ok;
@@ -156,8 +211,13 @@ void ShaderProgram::makeProgram(const GLuint program_id)
         glDeleteProgram(program_id);
         throw ShaderProgramCreationError();
     }
-    m_vertex_shader = vertex_shader;
-    m_fragment_shader = fragment_shader;
+
+    // Programs are told apart by their defines.
+    string label;
+    foreach (const string& define, m_defines) {
+        label += (label.empty() ? "" : " ") + define;
+    }
+    DebugOutput::label(GL_PROGRAM, program_id, label);
 }
 
 
@@ -43,6 +43,16 @@ public:
                   const set<string>& defines,
                   const OpenGLVersion opengl_version);
 
+    /**
+     * Compiles and links a compute program from the given source code.
+     *
+     * @throw ShaderProgramCreationError When compile or linking errors occur.
+     *
+     * @param compute_source Buffer to compute shader source.
+     * @param defines Set of defines used when compiling. Empty set not allowed.
+     */
+    ShaderProgram(char const* compute_source, const set<string>& defines);
+
     /**
      * @return The object ID of the shader program.
      */
@@ -72,12 +82,17 @@ private:
 
     void makeProgram(const GLuint program_id);
 
+    void linkProgram(const GLuint program_id);
+
     void logErrors(GLuint object_id, PFNGLGETSHADERIVPROC shader_iv,
                    PFNGLGETSHADERINFOLOGPROC shader_infolog);
 
     GLuint m_vertex_shader, m_geometry_shader, m_fragment_shader, m_program_id;
+    GLuint m_compute_shader;
 
     char const* m_vertex_source, *m_geometry_source, *m_fragment_source;
+    /// Set for compute programs only, which have no other stages.
+    char const* m_compute_source;
     
     const OpenGLVersion m_opengl_version;
 
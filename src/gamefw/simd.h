@@ -0,0 +1,48 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include "../common.h"
+
+/*
+ * Thin wrappers over the widest SIMD instruction set enabled at compile time,
+ * so loops over structure of arrays data are written once. GAMEFW_SIMD is
+ * defined when one is available, otherwise callers use their scalar path.
+ */
+
+#if defined(__AVX__)
+#    include <immintrin.h>
+#    define GAMEFW_SIMD
+namespace gamefw {
+typedef __m256 simd_float;
+const uint SIMD_WIDTH = 8;
+inline simd_float simdSet(float f) { return _mm256_set1_ps(f); }
+inline simd_float simdLoad(const float* p) { return _mm256_loadu_ps(p); }
+inline void simdStore(float* p, simd_float a) { _mm256_storeu_ps(p, a); }
+inline simd_float simdAdd(simd_float a, simd_float b) { return _mm256_add_ps(a, b); }
+inline simd_float simdSub(simd_float a, simd_float b) { return _mm256_sub_ps(a, b); }
+inline simd_float simdMul(simd_float a, simd_float b) { return _mm256_mul_ps(a, b); }
+inline simd_float simdMin(simd_float a, simd_float b) { return _mm256_min_ps(a, b); }
+inline simd_float simdOr(simd_float a, simd_float b) { return _mm256_or_ps(a, b); }
+inline simd_float simdLess(simd_float a, simd_float b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+inline int simdMoveMask(simd_float a) { return _mm256_movemask_ps(a); }
+}
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#    include <xmmintrin.h>
+#    define GAMEFW_SIMD
+namespace gamefw {
+typedef __m128 simd_float;
+const uint SIMD_WIDTH = 4;
+inline simd_float simdSet(float f) { return _mm_set1_ps(f); }
+inline simd_float simdLoad(const float* p) { return _mm_loadu_ps(p); }
+inline void simdStore(float* p, simd_float a) { _mm_storeu_ps(p, a); }
+inline simd_float simdAdd(simd_float a, simd_float b) { return _mm_add_ps(a, b); }
+inline simd_float simdSub(simd_float a, simd_float b) { return _mm_sub_ps(a, b); }
+inline simd_float simdMul(simd_float a, simd_float b) { return _mm_mul_ps(a, b); }
+inline simd_float simdMin(simd_float a, simd_float b) { return _mm_min_ps(a, b); }
+inline simd_float simdOr(simd_float a, simd_float b) { return _mm_or_ps(a, b); }
+inline simd_float simdLess(simd_float a, simd_float b) { return _mm_cmplt_ps(a, b); }
+inline int simdMoveMask(simd_float a) { return _mm_movemask_ps(a); }
+}
+#endif
+
+#endif // SIMD_H
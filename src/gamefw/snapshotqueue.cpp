@@ -0,0 +1,50 @@
+#include "snapshotqueue.h"
+
+using namespace gamefw;
+
+SnapshotQueue::SnapshotQueue(const uint num_snapshots)
+:
+m_snapshots(num_snapshots),
+m_slots(num_snapshots, 0),
+m_num_written(0),
+m_num_read(0),
+m_free(num_snapshots),
+m_ready(0)
+{
+}
+
+FrameSnapshot* SnapshotQueue::beginWrite()
+{
+    m_free.wait();
+    uint slot = m_num_written % m_slots.size();
+    m_slots[slot] = &m_snapshots[slot];
+    return m_slots[slot];
+}
+
+void SnapshotQueue::endWrite()
+{
+    m_num_written++;
+    m_ready.post();
+}
+
+FrameSnapshot* SnapshotQueue::beginRead()
+{
+    // The semaphore orders the writer's updates of the slot before this.
+    m_ready.wait();
+    return m_slots[m_num_read % m_slots.size()];
+}
+
+void SnapshotQueue::endRead()
+{
+    m_num_read++;
+    m_free.post();
+}
+
+void SnapshotQueue::close()
+{
+    // Queued behind the frames written before, like one more frame.
+    m_free.wait();
+    m_slots[m_num_written % m_slots.size()] = 0;
+    m_num_written++;
+    m_ready.post();
+}
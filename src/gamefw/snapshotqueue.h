@@ -0,0 +1,82 @@
+#ifndef SNAPSHOTQUEUE_H
+#define SNAPSHOTQUEUE_H
+
+#include "../common.h"
+
+#include "framesnapshot.h"
+#include "semaphore.h"
+
+namespace gamefw {
+
+/**
+ * @brief Hands frame snapshots from a simulation thread to a render thread.
+ *
+ * A ring of snapshots, each either being written, waiting to be rendered or
+ * being rendered. The writer waits when every snapshot is still in use, so
+ * with two the simulation runs at most one frame ahead of rendering.
+ *
+ * Usage:
+ * \code
+ * // Simulation thread.
+ * FrameSnapshot* snapshot = queue.beginWrite();
+ * ...
+ * queue.endWrite();
+ * // Render thread.
+ * while (FrameSnapshot* snapshot = queue.beginRead()) {
+ *     ...
+ *     queue.endRead();
+ * }
+ * \endcode
+ **/
+class SnapshotQueue
+{
+public:
+    /**
+     * @param num_snapshots 2 for double buffering, 3 for triple.
+     **/
+    SnapshotQueue(const uint num_snapshots = 2);
+
+    /**
+     * @brief Waits for a snapshot the reader is done with.
+     **/
+    FrameSnapshot* beginWrite();
+
+    /**
+     * @brief Passes the snapshot from beginWrite() on to the reader.
+     **/
+    void endWrite();
+
+    /**
+     * @brief Waits for the oldest written snapshot.
+     *
+     * @return 0 once the queue is closed and every snapshot has been read.
+     **/
+    FrameSnapshot* beginRead();
+
+    /**
+     * @brief Gives the snapshot from beginRead() back to the writer.
+     **/
+    void endRead();
+
+    /**
+     * @brief Tells the reader that nothing more will be written, once it has
+     * read what was. Called by the writer instead of beginWrite().
+     **/
+    void close();
+
+private:
+    vector<FrameSnapshot> m_snapshots;
+    /// Snapshot of each slot in the order written, 0 where the writer closed
+    /// the queue.
+    vector<FrameSnapshot*> m_slots;
+    /// Slots written and read so far, each only touched by its own side.
+    uint m_num_written;
+    uint m_num_read;
+    /// Counts snapshots free for writing and snapshots ready to be read.
+    Semaphore m_free;
+    Semaphore m_ready;
+};
+
+}
+
+#endif // SNAPSHOTQUEUE_H
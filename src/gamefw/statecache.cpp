@@ -0,0 +1,191 @@
+#include "statecache.h"
+
+using namespace gamefw;
+
+/// Shadowed value of state that is not known.
+const GLuint UNKNOWN = ~0u;
+
+const char* CALL_NAMES[] = {"glUseProgram", "glBindVertexArray",
+                            "glActiveTexture", "glBindTexture",
+                            "glBindBufferBase", "glBindFramebuffer",
+                            "glEnable", "glEnableVertexAttribArray"};
+
+const GLenum CAPABILITIES[] = {GL_DEPTH_TEST, GL_STENCIL_TEST, GL_BLEND,
+                               GL_CULL_FACE};
+
+/// Attribute arrays shadowed per vertex array, one bit each.
+const GLuint MAX_VERTEX_ATTRIBS = 32;
+
+static int textureTargetIndex(const GLenum target)
+{
+    switch (target) {
+    case GL_TEXTURE_2D:
+        return 0;
+    case GL_TEXTURE_BUFFER:
+        return 1;
+    default:
+        return -1;
+    }
+}
+
+StateCache::StateCache()
+{
+    invalidate();
+    resetCounters();
+}
+
+void StateCache::invalidate()
+{
+    m_program = UNKNOWN;
+    m_vertex_array = UNKNOWN;
+    m_active_texture = UNKNOWN;
+    for (uint unit = 0; unit < MAX_TEXTURE_UNITS; unit++) {
+        for (uint target = 0; target < NUM_TEXTURE_TARGETS; target++) {
+            m_textures[unit][target] = UNKNOWN;
+        }
+    }
+    for (uint i = 0; i < MAX_UNIFORM_BUFFERS; i++) {
+        m_uniform_buffers[i] = UNKNOWN;
+    }
+    m_draw_framebuffer = m_read_framebuffer = UNKNOWN;
+    for (uint i = 0; i < NUM_CAPABILITIES; i++) {
+        m_capabilities[i] = UNKNOWN;
+    }
+    m_attribs_known.assign(m_attribs_known.size(), 0);
+}
+
+void StateCache::resetCounters()
+{
+    for (uint call = 0; call < NUM_CALLS; call++) {
+        m_counters.issued[call] = m_counters.elided[call] = 0;
+    }
+}
+
+const StateCache::Counters& StateCache::getCounters() const
+{
+    return m_counters;
+}
+
+const char* StateCache::getCallName(const Call call)
+{
+    return CALL_NAMES[call];
+}
+
+bool StateCache::update(const Call call, GLuint& shadow, const GLuint value)
+{
+    if (shadow == value) {
+        m_counters.elided[call]++;
+        return false;
+    }
+    shadow = value;
+    m_counters.issued[call]++;
+    return true;
+}
+
+void StateCache::useProgram(const GLuint program)
+{
+    if (update(USE_PROGRAM, m_program, program)) {
+        glUseProgram(program);
+    }
+}
+
+void StateCache::bindVertexArray(const GLuint vertex_array)
+{
+    if (update(BIND_VERTEX_ARRAY, m_vertex_array, vertex_array)) {
+        glBindVertexArray(vertex_array);
+    }
+}
+
+void StateCache::bindTexture(const GLuint unit, const GLenum target,
+                             const GLuint texture)
+{
+    int target_index = textureTargetIndex(target);
+    GLuint untracked = UNKNOWN;
+    GLuint& shadow = unit < MAX_TEXTURE_UNITS && target_index >= 0 ?
+                     m_textures[unit][target_index] : untracked;
+    if (update(BIND_TEXTURE, shadow, texture)) {
+        if (update(ACTIVE_TEXTURE, m_active_texture, unit)) {
+            glActiveTexture(GL_TEXTURE0 + unit);
+        }
+        glBindTexture(target, texture);
+    }
+}
+
+void StateCache::bindUniformBuffer(const GLuint index, const GLuint buffer)
+{
+    GLuint untracked = UNKNOWN;
+    GLuint& shadow = index < MAX_UNIFORM_BUFFERS ? m_uniform_buffers[index]
+                                                 : untracked;
+    if (update(BIND_UNIFORM_BUFFER, shadow, buffer)) {
+        glBindBufferBase(GL_UNIFORM_BUFFER, index, buffer);
+    }
+}
+
+void StateCache::bindFramebuffer(const GLenum target, const GLuint framebuffer)
+{
+    bool changed;
+    switch (target) {
+    case GL_DRAW_FRAMEBUFFER:
+        changed = update(BIND_FRAMEBUFFER, m_draw_framebuffer, framebuffer);
+        break;
+    case GL_READ_FRAMEBUFFER:
+        changed = update(BIND_FRAMEBUFFER, m_read_framebuffer, framebuffer);
+        break;
+    default:
+        changed = m_draw_framebuffer != framebuffer ||
+                  m_read_framebuffer != framebuffer;
+        m_draw_framebuffer = m_read_framebuffer = framebuffer;
+        if (changed) {
+            m_counters.issued[BIND_FRAMEBUFFER]++;
+        } else {
+            m_counters.elided[BIND_FRAMEBUFFER]++;
+        }
+    }
+    if (changed) {
+        glBindFramebuffer(target, framebuffer);
+    }
+}
+
+void StateCache::setEnabled(const GLenum capability, const bool enabled)
+{
+    GLuint untracked = UNKNOWN;
+    GLuint* shadow = &untracked;
+    for (uint i = 0; i < NUM_CAPABILITIES; i++) {
+        if (CAPABILITIES[i] == capability) {
+            shadow = &m_capabilities[i];
+        }
+    }
+    if (update(ENABLE, *shadow, enabled ? 1 : 0)) {
+        if (enabled) {
+            glEnable(capability);
+        } else {
+            glDisable(capability);
+        }
+    }
+}
+
+void StateCache::setVertexAttribArray(const GLuint index, const bool enabled)
+{
+    // Only shadowed while the bound vertex array is known.
+    if (m_vertex_array != UNKNOWN && index < MAX_VERTEX_ATTRIBS) {
+        if (m_vertex_array >= m_attribs_known.size()) {
+            m_attribs_known.resize(m_vertex_array + 1, 0);
+            m_attribs_enabled.resize(m_vertex_array + 1, 0);
+        }
+        unsigned int bit = 1u << index;
+        unsigned int& known = m_attribs_known[m_vertex_array];
+        unsigned int& enabled_mask = m_attribs_enabled[m_vertex_array];
+        if ((known & bit) && ((enabled_mask & bit) != 0) == enabled) {
+            m_counters.elided[ENABLE_VERTEX_ATTRIB_ARRAY]++;
+            return;
+        }
+        known |= bit;
+        enabled_mask = enabled ? enabled_mask | bit : enabled_mask & ~bit;
+    }
+    m_counters.issued[ENABLE_VERTEX_ATTRIB_ARRAY]++;
+    if (enabled) {
+        glEnableVertexAttribArray(index);
+    } else {
+        glDisableVertexAttribArray(index);
+    }
+}
@@ -0,0 +1,121 @@
+#ifndef STATECACHE_H
+#define STATECACHE_H
+
+#include "../common.h"
+#include "../ogl.h"
+
+namespace gamefw {
+
+/**
+ * @brief Shadows OpenGL binding and enable state, skipping calls that
+ * wouldn't change it.
+ *
+ * Covers the program, the vertex array, the textures of each unit, indexed
+ * uniform buffers, framebuffers, capabilities and the vertex attribute
+ * arrays enabled in each vertex array. State changed around the cache makes
+ * its shadow stale, invalidate() forgets it so the next call of each kind is
+ * issued. Issued and elided calls are counted to measure driver overhead.
+ **/
+class StateCache
+{
+public:
+    /// Calls going through the cache.
+    enum Call {
+        USE_PROGRAM,
+        BIND_VERTEX_ARRAY,
+        ACTIVE_TEXTURE,
+        BIND_TEXTURE,
+        BIND_UNIFORM_BUFFER,
+        BIND_FRAMEBUFFER,
+        ENABLE,
+        ENABLE_VERTEX_ATTRIB_ARRAY,
+        NUM_CALLS
+    };
+
+    /// Calls of each kind since the counters were reset.
+    struct Counters {
+        uint issued[NUM_CALLS];
+        uint elided[NUM_CALLS];
+    };
+
+    StateCache();
+
+    /**
+     * @brief Forgets the shadowed state, after OpenGL calls made around the
+     * cache.
+     **/
+    void invalidate();
+
+    void resetCounters();
+    const Counters& getCounters() const;
+
+    /**
+     * @return Name of the OpenGL function behind the call.
+     **/
+    static const char* getCallName(const Call call);
+
+    void useProgram(const GLuint program);
+    void bindVertexArray(const GLuint vertex_array);
+
+    /**
+     * @brief Binds a texture to a unit, making the unit active if needed.
+     *
+     * @param unit Index of the unit, from 0.
+     * @param target GL_TEXTURE_2D or GL_TEXTURE_BUFFER. Other targets aren't
+     *        shadowed and always bind.
+     * @param texture ditto.
+     **/
+    void bindTexture(const GLuint unit, const GLenum target, const GLuint texture);
+
+    /**
+     * @brief Binds a buffer to an indexed uniform buffer binding point.
+     **/
+    void bindUniformBuffer(const GLuint index, const GLuint buffer);
+
+    /**
+     * @param target GL_FRAMEBUFFER binds both the draw and the read
+     *        framebuffer, like OpenGL.
+     * @param framebuffer ditto.
+     **/
+    void bindFramebuffer(const GLenum target, const GLuint framebuffer);
+
+    /**
+     * @brief glEnable() or glDisable().
+     *
+     * @param capability GL_DEPTH_TEST, GL_STENCIL_TEST, GL_BLEND or
+     *        GL_CULL_FACE. Others aren't shadowed.
+     * @param enabled ditto.
+     **/
+    void setEnabled(const GLenum capability, const bool enabled);
+
+    /**
+     * @brief Enables or disables a vertex attribute array of the bound
+     * vertex array, where OpenGL keeps it.
+     **/
+    void setVertexAttribArray(const GLuint index, const bool enabled);
+
+private:
+    enum { MAX_TEXTURE_UNITS = 16, NUM_TEXTURE_TARGETS = 2,
+           MAX_UNIFORM_BUFFERS = 16, NUM_CAPABILITIES = 4 };
+
+    /// Updates a shadowed value, counting the call.
+    /// @return Whether the call has to be issued.
+    bool update(const Call call, GLuint& shadow, const GLuint value);
+
+    GLuint m_program;
+    GLuint m_vertex_array;
+    GLuint m_active_texture;
+    GLuint m_textures[MAX_TEXTURE_UNITS][NUM_TEXTURE_TARGETS];
+    GLuint m_uniform_buffers[MAX_UNIFORM_BUFFERS];
+    GLuint m_draw_framebuffer, m_read_framebuffer;
+    GLuint m_capabilities[NUM_CAPABILITIES];
+    /// Attribute arrays known and enabled in each vertex array, as bit masks
+    /// indexed by the vertex array.
+    vector<unsigned int> m_attribs_known, m_attribs_enabled;
+
+    Counters m_counters;
+};
+
+}
+
+#endif // STATECACHE_H
@@ -0,0 +1,396 @@
+#include "../../common.h"
+
+#include "../gamefw.h"
+#include "../igamestate.h"
+#include "../timingstats.h"
+
+#include "../convenience/camerapath.h"
+#include "../convenience/stresslevel.h"
+
+#include "../../util/json.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <physfs.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace gamefw;
+
+/**
+ * @brief Moves the camera along a path, one fixed step per frame, so every
+ * run renders the same frames however fast they are.
+ **/
+class ReplayGameState
+:
+public IGameState
+{
+public:
+    ReplayGameState(const CameraPath& path, shared_ptr<Entity> camera,
+                    const uint num_frames)
+    :
+    m_path(path),
+    m_camera(camera),
+    m_num_frames(num_frames),
+    m_frame(0)
+    {
+    }
+
+    UpdateStatus update()
+    {
+        float time = m_path.getDuration() * m_frame / std::max(m_num_frames - 1, 1u);
+        m_path.sample(time, *m_camera);
+        m_frame++;
+        return m_frame >= m_num_frames ? UPDATE_QUIT : UPDATE_NORMAL;
+    }
+
+private:
+    CameraPath m_path;
+    shared_ptr<Entity> m_camera;
+    uint m_num_frames;
+    uint m_frame;
+};
+
+/// Volumes in the frustum culler case, which should be culled well under a
+/// millisecond.
+const uint NUM_CULLER_VOLUMES = 100000;
+/// Times the case is run.
+const uint NUM_CULLER_RUNS = 100;
+
+/// Sum and maximum of a per frame counter.
+struct Counter
+{
+    Counter() : sum(0), max(0) {}
+
+    void add(const uint value)
+    {
+        sum += value;
+        max = std::max(max, value);
+    }
+
+    unsigned long long sum;
+    uint max;
+};
+
+static void printUsage(const char* program)
+{
+    cerr << "Usage: " << program << " [options]\n"
+         << "  --level NAME          Level to load, defaults to lvl01.\n"
+         << "  --stress N M          Generate a level with N entities and M lights.\n"
+         << "  --seed S              Layout of the generated level.\n"
+         << "  --path FILE           Camera path to replay, defaults to an orbit.\n"
+         << "  --frames N            Frames measured, defaults to 600.\n"
+         << "  --warmup N            Frames rendered first, defaults to 60.\n"
+         << "  --size W H            Resolution, defaults to 1280 720.\n"
+         << "  --windowed            Render to a window, vsynced, instead of offscreen.\n"
+         << "  --depth-prepass       Draw the depth of the scene first.\n"
+         << "  --unfused             Antialias in a pass of its own.\n"
+         << "  --no-multi-draw       Draw each mesh with a call of its own.\n"
+         << "  --no-gpu-culling      Cull on the CPU.\n"
+         << "  --pipelined           Render on a thread of its own. Only CPU frame\n"
+         << "                        times and pass averages are measured.\n"
+         << "  --output FILE         Write the report here instead of stdout.\n";
+}
+
+/**
+ * @brief Times FrustumCuller on NUM_CULLER_VOLUMES cubes in a grid around the
+ * camera, transformed and tested as the renderer does every frame.
+ *
+ * @param add_times Time each run took to add the volumes, transforming them.
+ * @param cull_times Time each run took to test them.
+ **/
+static void timeFrustumCuller(TimingStats& add_times, TimingStats& cull_times)
+{
+    float positions[] = {-1.0f, -1.0f, -1.0f,
+                          1.0f,  1.0f,  1.0f};
+    BoundingVolume bounds(positions, 2, sizeof(float) * 3);
+    vector<glm::mat4> models;
+    const uint side = (uint) std::ceil(std::sqrt((float) NUM_CULLER_VOLUMES));
+    for (uint i = 0; i < NUM_CULLER_VOLUMES; i++) {
+        glm::vec3 position(((float) (i % side) - side / 2.0f) * 5.0f, 0.0f,
+                           ((float) (i / side) - side / 2.0f) * 5.0f);
+        models.push_back(glm::translate(glm::mat4(1.0f), position));
+    }
+
+    FrustumCuller culler;
+    culler.setFrustum(Frustum(glm::perspective(60.0f, 16.0f / 9.0f, 1.0f, 500.0f)));
+    vector<uint> visible;
+    visible.reserve(NUM_CULLER_VOLUMES);
+    sf::Clock clock;
+    for (uint run = 0; run < NUM_CULLER_RUNS; run++) {
+        clock.restart();
+        culler.clear();
+        foreach (const glm::mat4& model, models) {
+            culler.add(bounds, model);
+        }
+        add_times.add(clock.restart().asMicroseconds() / 1000.0f);
+        visible.clear();
+        culler.cull(visible);
+        cull_times.add(clock.getElapsedTime().asMicroseconds() / 1000.0f);
+    }
+}
+
+static void writeTimings(ostream& out, const char* name, const TimingStats& stats)
+{
+    out << "  \"" << name << "\": {"
+        << "\"min\": " << stats.getPercentile(0.0f) << ", "
+        << "\"avg\": " << stats.getAverage() << ", "
+        << "\"p95\": " << stats.getPercentile(95.0f) << ", "
+        << "\"p99\": " << stats.getPercentile(99.0f) << ", "
+        << "\"max\": " << stats.getPercentile(100.0f) << "}";
+}
+
+static void writeCounter(ostream& out, const char* name, const Counter& counter,
+                         const uint num_frames)
+{
+    out << "  \"" << name << "\": {"
+        << "\"avg\": " << (double) counter.sum / std::max(num_frames, 1u) << ", "
+        << "\"max\": " << counter.max << "}";
+}
+
+int main(int argc, char* argv[])
+{
+    string level_name("lvl01");
+    bool stress = false;
+    uint num_entities = 0, num_lights = 0, seed = 1;
+    string camera_path_file, output_file;
+    uint num_frames = 600, num_warmup = 60;
+    uint width = 1280, height = 720;
+    WindowMode window_mode = HEADLESS;
+    bool depth_prepass = false;
+    bool fused_postprocessing = true;
+    bool multi_draw = true;
+    bool gpu_culling = true;
+    bool pipelined = false;
+
+    for (int i = 1; i < argc; i++) {
+        string arg(argv[i]);
+        int remaining = argc - i - 1;
+        if (arg == "--level" && remaining >= 1) {
+            level_name = argv[++i];
+        } else if (arg == "--stress" && remaining >= 2) {
+            stress = true;
+            num_entities = atoi(argv[++i]);
+            num_lights = atoi(argv[++i]);
+        } else if (arg == "--seed" && remaining >= 1) {
+            seed = atoi(argv[++i]);
+        } else if (arg == "--path" && remaining >= 1) {
+            camera_path_file = argv[++i];
+        } else if (arg == "--frames" && remaining >= 1) {
+            num_frames = std::max(atoi(argv[++i]), 1);
+        } else if (arg == "--warmup" && remaining >= 1) {
+            num_warmup = std::max(atoi(argv[++i]), 0);
+        } else if (arg == "--size" && remaining >= 2) {
+            width = std::max(atoi(argv[++i]), 1);
+            height = std::max(atoi(argv[++i]), 1);
+        } else if (arg == "--windowed") {
+            window_mode = WINDOWED;
+        } else if (arg == "--depth-prepass") {
+            depth_prepass = true;
+        } else if (arg == "--unfused") {
+            fused_postprocessing = false;
+        } else if (arg == "--no-multi-draw") {
+            multi_draw = false;
+        } else if (arg == "--no-gpu-culling") {
+            gpu_culling = false;
+        } else if (arg == "--pipelined") {
+            pipelined = true;
+        } else if (arg == "--output" && remaining >= 1) {
+            output_file = argv[++i];
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    PHYSFS_init(argv[0]);
+
+    FileService fileservice(OGL_3_3);
+    Locator::registerFileService(fileservice);
+    ShaderFactory shaderfactory(OGL_3_3);
+    Locator::registerShaderFactory(shaderfactory);
+
+    Game game(width, height, OGL_3_3, window_mode);
+    shared_ptr<Renderer> renderer = game.getRenderer();
+    // Frames must cost the same work on every run.
+    renderer->setTargetFrameTime(0.0f);
+    renderer->setDepthPrepass(depth_prepass);
+    renderer->setFusedPostProcessing(fused_postprocessing);
+    renderer->setMultiDraw(multi_draw);
+    renderer->setGpuCulling(gpu_culling);
+
+    shared_ptr<LevelFile> level;
+    if (stress) {
+        level = generateStressLevel(num_entities, num_lights, seed);
+    } else {
+        level = Locator::getFileService().loadLevelFile(level_name);
+    }
+
+    CameraPath path;
+    if (camera_path_file.empty()) {
+        // Circle the level, looking at its center.
+        glm::vec3 level_min(FLT_MAX, FLT_MAX, FLT_MAX);
+        glm::vec3 level_max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        foreach (shared_ptr<Entity> entity, level->m_entities) {
+            level_min = glm::min(level_min, entity->m_position);
+            level_max = glm::max(level_max, entity->m_position);
+        }
+        if (level->m_entities.empty()) {
+            level_min = level_max = glm::vec3(0.0f);
+        }
+        glm::vec3 center = (level_min + level_max) * 0.5f;
+        float radius = glm::max(glm::length(level_max - level_min) * 0.5f, 10.0f);
+        path = CameraPath::makeOrbit(center, radius, radius * 0.5f, 10.0f);
+    } else if (!path.load(camera_path_file)) {
+        return 1;
+    }
+
+    shared_ptr<Entity> camera(new Entity());
+    renderer->changeCamera(camera);
+    shared_ptr<IGameState> gamestate(new ReplayGameState(path, camera,
+                                                         num_warmup + num_frames));
+    game.changeGameState(gamestate);
+    game.setPipelined(pipelined);
+
+    TimingStats cpu_times(num_frames);
+    TimingStats gpu_times(num_frames);
+    TimingStats cull_times(num_frames);
+    Counter draw_calls, state_changes, culled;
+    Counter gl_calls_issued[StateCache::NUM_CALLS];
+    Counter gl_calls_elided[StateCache::NUM_CALLS];
+    uint gpu_samples_seen = 0;
+
+    sf::Clock clock;
+    for (uint frame = 0; frame < num_warmup + num_frames; frame++) {
+        clock.restart();
+
+        renderer->addToRenderQueue(level->m_entity_hierarchy);
+        foreach (shared_ptr<PointLight> pointlight, level->m_pointlights) {
+            renderer->addToPointLightQueue(pointlight);
+            renderer->addToRenderQueue(pointlight);
+        }
+        UpdateStatus status = game.update();
+
+        float cpu_time = clock.getElapsedTime().asMicroseconds() / 1000.0f;
+        if (pipelined) {
+            // The render thread owns the statistics until it is stopped.
+            if (frame >= num_warmup) {
+                cpu_times.add(cpu_time);
+            }
+            if (status == UPDATE_QUIT) {
+                break;
+            }
+            continue;
+        }
+
+        // GPU results arrive a few frames late, only take new ones.
+        const TimingStats& gpu_frame = renderer->getFrameTimings();
+        bool new_gpu_sample = gpu_frame.getTotalSamples() != gpu_samples_seen;
+        gpu_samples_seen = gpu_frame.getTotalSamples();
+
+        if (frame >= num_warmup) {
+            cpu_times.add(cpu_time);
+            if (new_gpu_sample) {
+                gpu_times.add(gpu_frame.getLatest());
+            }
+            const RenderStatistics& statistics = renderer->getStatistics();
+            cull_times.add(statistics.cull_ms);
+            draw_calls.add(statistics.draw_calls);
+            state_changes.add(statistics.state_changes);
+            culled.add(renderer->getNumCulled());
+            for (uint call = 0; call < StateCache::NUM_CALLS; call++) {
+                gl_calls_issued[call].add(statistics.gl_calls.issued[call]);
+                gl_calls_elided[call].add(statistics.gl_calls.elided[call]);
+            }
+        }
+
+        if (status == UPDATE_QUIT) {
+            break;
+        }
+    }
+
+    game.setPipelined(false);
+
+    ofstream output_stream;
+    if (!output_file.empty()) {
+        output_stream.open(output_file.c_str());
+        if (!output_stream) {
+            LOG(logERROR) << "Couldn't write " << output_file << ".";
+            return 1;
+        }
+    }
+    ostream& out = output_file.empty() ? cout : output_stream;
+
+    const uint num_measured = cpu_times.getNumSamples();
+    out << "{\n"
+        << "  \"scenario\": {"
+        << "\"level\": ";
+    writeJsonString(out, stress ? "stress" : level_name.c_str());
+    out << ", "
+        << "\"entities\": " << level->m_entities.size() << ", "
+        << "\"lights\": " << level->m_pointlights.size() << ", "
+        << "\"seed\": " << seed << ", "
+        << "\"camera_path\": ";
+    writeJsonString(out, camera_path_file.empty() ? "orbit" :
+                                                       camera_path_file.c_str());
+    out << ", "
+        << "\"frames\": " << num_measured << ", "
+        << "\"warmup\": " << num_warmup << ", "
+        << "\"width\": " << width << ", "
+        << "\"height\": " << height << ", "
+        << "\"headless\": " << (game.isHeadless() ? "true" : "false") << ", "
+        << "\"depth_prepass\": " << (depth_prepass ? "true" : "false") << ", "
+        << "\"fused_postprocessing\": "
+        << (fused_postprocessing ? "true" : "false") << ", "
+        << "\"multi_draw\": "
+        << (multi_draw && renderer->isMultiDrawSupported() ? "true" : "false")
+        << ", "
+        << "\"gpu_culling\": "
+        << (gpu_culling && multi_draw && renderer->isGpuCullingSupported() ?
+            "true" : "false") << ", "
+        << "\"pipelined\": " << (pipelined ? "true" : "false") << ", "
+        << "\"gl_renderer\": ";
+    writeJsonString(out, (const char*) glGetString(GL_RENDERER));
+    out << "},\n";
+    writeTimings(out, "cpu_frame_ms", cpu_times);
+    out << ",\n";
+    writeTimings(out, "gpu_frame_ms", gpu_times);
+    out << ",\n";
+    writeTimings(out, "cpu_cull_ms", cull_times);
+    // The renderer's culling of a flat list of entities, without a level.
+    TimingStats culler_add_times(NUM_CULLER_RUNS);
+    TimingStats culler_cull_times(NUM_CULLER_RUNS);
+    timeFrustumCuller(culler_add_times, culler_cull_times);
+    out << ",\n";
+    writeTimings(out, "frustum_culler_100k_add_ms", culler_add_times);
+    out << ",\n";
+    writeTimings(out, "frustum_culler_100k_cull_ms", culler_cull_times);
+    // Averages over the renderer's own window of the last frames.
+    out << ",\n  \"gpu_pass_ms\": {";
+    for (uint pass = 0; pass < Renderer::NUM_RENDER_PASSES; pass++) {
+        Renderer::RenderPass render_pass = (Renderer::RenderPass) pass;
+        out << (pass == 0 ? "" : ", ") << "\""
+            << Renderer::getPassName(render_pass) << "\": "
+            << renderer->getPassTimings(render_pass).getAverage();
+    }
+    out << "},\n";
+    writeCounter(out, "draw_calls", draw_calls, num_measured);
+    out << ",\n";
+    writeCounter(out, "state_changes", state_changes, num_measured);
+    out << ",\n";
+    writeCounter(out, "culled", culled, num_measured);
+    // Average OpenGL calls per frame, issued and skipped as redundant.
+    out << ",\n  \"gl_calls\": {";
+    for (uint call = 0; call < StateCache::NUM_CALLS; call++) {
+        out << (call == 0 ? "" : ", ") << "\""
+            << StateCache::getCallName((StateCache::Call) call) << "\": {"
+            << "\"issued\": "
+            << (double) gl_calls_issued[call].sum / std::max(num_measured, 1u) << ", "
+            << "\"elided\": "
+            << (double) gl_calls_elided[call].sum / std::max(num_measured, 1u) << "}";
+    }
+    out << "}\n}\n";
+
+    return 0;
+}
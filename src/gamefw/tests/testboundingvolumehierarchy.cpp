@@ -0,0 +1,105 @@
+#include <UnitTest++.h>
+
+#include <set>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../boundingvolumehierarchy.h"
+#include "../renderjob.h"
+
+using namespace gamefw;
+
+struct BoundingVolumeHierarchyFixture
+{
+    BoundingVolumeHierarchyFixture()
+    :
+    renderjob(new RenderJob())
+    {
+        float positions[] = {-1.0f, -1.0f, -1.0f,
+                              1.0f,  1.0f,  1.0f};
+        renderjob->m_bounds = BoundingVolume(positions, 2, sizeof(float) * 3);
+
+        // Grid of cubes in front of and behind the camera.
+        for (int x = -20; x <= 20; x++) {
+            for (int z = -20; z <= 20; z++) {
+                shared_ptr<Entity> entity(new Entity());
+                entity->setRenderJob(renderjob);
+                entity->m_position = glm::vec3(x * 5.0f, 0.0f, z * 5.0f);
+                entities.push_back(entity);
+            }
+        }
+
+        glm::mat4 projection = glm::perspective(60.0f, 4.0f / 3.0f, 1.0f, 50.0f);
+        frustum = Frustum(projection);
+    }
+
+    // Reference result by testing every entity.
+    set<Entity*> bruteForce()
+    {
+        set<Entity*> visible;
+        foreach (shared_ptr<Entity> entity, entities) {
+            glm::vec3 center, half_extents;
+            renderjob->m_bounds.transform(entity->getModelMatrix(), center,
+                                          half_extents);
+            if (frustum.intersects(center, half_extents)) {
+                visible.insert(entity.get());
+            }
+        }
+        return visible;
+    }
+
+    shared_ptr<RenderJob> renderjob;
+    vector<shared_ptr<Entity> > entities;
+    Frustum frustum;
+};
+
+TEST_FIXTURE(BoundingVolumeHierarchyFixture, TestCullMatchesBruteForce)
+{
+    BoundingVolumeHierarchy hierarchy(entities);
+    CHECK_EQUAL(entities.size(), hierarchy.size());
+    CHECK(hierarchy.getNumNodes() < 2 * entities.size());
+
+    vector<shared_ptr<Entity> > visible;
+    uint num_culled = hierarchy.cull(frustum, visible);
+
+    set<Entity*> expected = bruteForce();
+    CHECK(!expected.empty());
+    CHECK_EQUAL(expected.size(), visible.size());
+    CHECK_EQUAL(entities.size(), visible.size() + num_culled);
+    foreach (shared_ptr<Entity> entity, visible) {
+        CHECK(expected.find(entity.get()) != expected.end());
+    }
+}
+
+TEST_FIXTURE(BoundingVolumeHierarchyFixture, TestRefit)
+{
+    BoundingVolumeHierarchy hierarchy(entities);
+
+    // Move everything behind the camera.
+    foreach (shared_ptr<Entity> entity, entities) {
+        entity->m_position.z = glm::abs(entity->m_position.z) + 10.0f;
+    }
+    hierarchy.refit();
+
+    vector<shared_ptr<Entity> > visible;
+    uint num_culled = hierarchy.cull(frustum, visible);
+    CHECK(visible.empty());
+    CHECK_EQUAL(entities.size(), num_culled);
+}
+
+TEST_FIXTURE(BoundingVolumeHierarchyFixture, TestUncullableAlwaysVisible)
+{
+    shared_ptr<RenderJob> skybox_renderjob(new RenderJob());
+    skybox_renderjob->m_cullable = false;
+    shared_ptr<Entity> skybox(new Entity());
+    skybox->setRenderJob(skybox_renderjob);
+    skybox->m_position = glm::vec3(0.0f, 0.0f, 1000.0f);
+
+    vector<shared_ptr<Entity> > scene;
+    scene.push_back(skybox);
+    BoundingVolumeHierarchy hierarchy(scene);
+
+    vector<shared_ptr<Entity> > visible;
+    CHECK_EQUAL(0u, hierarchy.cull(frustum, visible));
+    CHECK_EQUAL(1u, visible.size());
+    CHECK_EQUAL(0u, hierarchy.getNumNodes());
+}
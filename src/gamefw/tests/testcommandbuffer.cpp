@@ -0,0 +1,83 @@
+#include <UnitTest++.h>
+
+#include "../commandbuffer.h"
+#include "../renderjob.h"
+
+using namespace gamefw;
+
+typedef CommandBuffer::Command Command;
+
+struct CommandBufferFixture
+{
+    CommandBufferFixture()
+    :
+    tree(new RenderJob()),
+    rock(new RenderJob())
+    {
+        // Sorted by RenderJob, as the renderer records them.
+        for (int i = 0; i < 3; i++) {
+            entities.push_back(makeEntity(tree, (float) i));
+        }
+        for (int i = 0; i < 2; i++) {
+            entities.push_back(makeEntity(rock, (float) i));
+        }
+
+        foreach (shared_ptr<Entity> entity, entities) {
+            transforms.sync(*entity);
+        }
+        transforms.update();
+    }
+
+    shared_ptr<Entity> makeEntity(shared_ptr<RenderJob> renderjob, float x)
+    {
+        shared_ptr<Entity> entity(new Entity());
+        entity->setRenderJob(renderjob);
+        entity->m_position = glm::vec3(x, 0.0f, 0.0f);
+        return entity;
+    }
+
+    shared_ptr<RenderJob> tree;
+    shared_ptr<RenderJob> rock;
+    vector<shared_ptr<Entity> > entities;
+    TransformStore transforms;
+};
+
+TEST_FIXTURE(CommandBufferFixture, TestRecordGroupsInstances)
+{
+    vector<CommandBuffer::InstanceData> instances(entities.size());
+    CommandBuffer command_buffer;
+    command_buffer.record(&entities[0], entities.size(), transforms,
+                          &instances[0], 10);
+
+    // Both RenderJobs share the program, so it's bound only once.
+    const vector<Command>& commands = command_buffer.getCommands();
+    CHECK_EQUAL(5u, commands.size());
+    CHECK_EQUAL(Command::BIND_PROGRAM, commands[0].type);
+    CHECK_EQUAL(Command::BIND_MESH, commands[1].type);
+    CHECK(commands[1].renderjob == tree.get());
+    CHECK_EQUAL(Command::DRAW_INSTANCES, commands[2].type);
+    CHECK_EQUAL(10u, commands[2].first_instance);
+    CHECK_EQUAL(3u, commands[2].num_instances);
+    CHECK_EQUAL(Command::BIND_MESH, commands[3].type);
+    CHECK(commands[3].renderjob == rock.get());
+    CHECK_EQUAL(Command::DRAW_INSTANCES, commands[4].type);
+    CHECK_EQUAL(13u, commands[4].first_instance);
+    CHECK_EQUAL(2u, commands[4].num_instances);
+}
+
+TEST_FIXTURE(CommandBufferFixture, TestRecordInstanceData)
+{
+    vector<CommandBuffer::InstanceData> instances(entities.size());
+    CommandBuffer command_buffer;
+    command_buffer.record(&entities[0], entities.size(), transforms,
+                          &instances[0], 0);
+
+    for (uint i = 0; i < instances.size(); i++) {
+        // Translation is the last column of the model matrix.
+        CHECK_CLOSE(entities[i]->m_position.x, instances[i].model[12], 1e-6f);
+        CHECK_CLOSE(1.0f, instances[i].normalmatrix[0], 1e-6f);
+    }
+
+    command_buffer.clear();
+    CHECK(command_buffer.getCommands().empty());
+}
@@ -0,0 +1,88 @@
+#include <UnitTest++.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../boundingvolume.h"
+#include "../frustumculler.h"
+
+using namespace gamefw;
+
+struct FrustumCullerFixture
+{
+    FrustumCullerFixture()
+    {
+        // Camera at the origin looking down -z.
+        glm::mat4 projection = glm::perspective(60.0f, 4.0f / 3.0f, 1.0f, 100.0f);
+        culler.setFrustum(Frustum(projection));
+
+        // Unit cube around the origin.
+        float positions[] = {-1.0f, -1.0f, -1.0f,
+                              1.0f,  1.0f,  1.0f,
+                              0.0f,  0.5f,  0.0f};
+        cube = BoundingVolume(positions, 3, sizeof(float) * 3);
+    }
+
+    glm::mat4 translation(float x, float y, float z)
+    {
+        return glm::translate(glm::mat4(1.0f), glm::vec3(x, y, z));
+    }
+
+    FrustumCuller culler;
+    BoundingVolume cube;
+};
+
+TEST(TestBoundingVolumeFromPositions)
+{
+    // Stride of four floats, the fourth is ignored.
+    float positions[] = {1.0f, 2.0f, 3.0f, 99.0f,
+                         -1.0f, 0.0f, 1.0f, 99.0f};
+    BoundingVolume bounds(positions, 2, sizeof(float) * 4);
+
+    CHECK_CLOSE(-1.0f, bounds.m_aabb_min.x, 0.0001f);
+    CHECK_CLOSE(0.0f, bounds.m_aabb_min.y, 0.0001f);
+    CHECK_CLOSE(3.0f, bounds.m_aabb_max.z, 0.0001f);
+    CHECK_CLOSE(1.0f, bounds.getCenter().y, 0.0001f);
+    CHECK_CLOSE(glm::sqrt(3.0f), bounds.m_sphere_radius, 0.0001f);
+}
+
+TEST_FIXTURE(FrustumCullerFixture, TestCullOutsideVolumes)
+{
+    culler.add(cube, translation(0.0f, 0.0f, -10.0f));   // In front.
+    culler.add(cube, translation(0.0f, 0.0f, 10.0f));    // Behind.
+    culler.add(cube, translation(100.0f, 0.0f, -10.0f)); // Right.
+    culler.add(cube, translation(0.0f, 0.0f, -200.0f));  // Past far plane.
+    culler.add(cube, translation(0.0f, 0.0f, -0.5f));    // Crosses near plane.
+
+    vector<uint> visible;
+    uint num_culled = culler.cull(visible);
+
+    CHECK_EQUAL(3u, num_culled);
+    CHECK_EQUAL(2u, visible.size());
+    CHECK_EQUAL(0u, visible[0]);
+    CHECK_EQUAL(4u, visible[1]);
+}
+
+TEST_FIXTURE(FrustumCullerFixture, TestCullManyVolumes)
+{
+    // More than one SIMD batch with an uneven tail, every third visible.
+    const uint num_volumes = 101;
+    for (uint i = 0; i < num_volumes; i++) {
+        float z = (i % 3 == 0) ? -10.0f : 10.0f;
+        culler.add(cube, translation(0.0f, 0.0f, z));
+    }
+
+    vector<uint> visible;
+    uint num_culled = culler.cull(visible);
+
+    CHECK_EQUAL(num_volumes, culler.size());
+    CHECK_EQUAL(34u, visible.size());
+    CHECK_EQUAL(num_volumes - 34u, num_culled);
+    for (uint i = 0; i < visible.size(); i++) {
+        CHECK_EQUAL(i * 3, visible[i]);
+    }
+
+    culler.clear();
+    visible.clear();
+    CHECK_EQUAL(0u, culler.cull(visible));
+    CHECK(visible.empty());
+}
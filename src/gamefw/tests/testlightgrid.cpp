@@ -0,0 +1,78 @@
+#include <UnitTest++.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../lightgrid.h"
+
+using namespace gamefw;
+
+struct LightGridFixture
+{
+    LightGridFixture()
+    :
+    grid(16, 9, 24)
+    {
+        // Camera at the origin looking down -z.
+        projection = glm::perspective(60.0f, 16.0f / 9.0f, 1.0f, 1000.0f);
+        grid.setView(glm::mat4(1.0f), projection, 1.0f, 1000.0f);
+    }
+
+    // Lights listed in the cluster containing the view space point.
+    vector<uint> lightsAt(const glm::vec3& point)
+    {
+        glm::vec4 clip = projection * glm::vec4(point, 1.0f);
+        int x = (int) ((clip.x / clip.w * 0.5f + 0.5f) * grid.getSizeX());
+        int y = (int) ((clip.y / clip.w * 0.5f + 0.5f) * grid.getSizeY());
+        int z = (int) (glm::log(-point.z) * grid.getSliceScale() +
+                       grid.getSliceBias());
+        uint cluster = (z * grid.getSizeY() + y) * grid.getSizeX() + x;
+
+        const vector<uint>& clusters = grid.getClusters();
+        const vector<uint>& indices = grid.getLightIndices();
+        uint offset = clusters[cluster * 2];
+        uint count = clusters[cluster * 2 + 1];
+        return vector<uint>(indices.begin() + offset,
+                            indices.begin() + offset + count);
+    }
+
+    glm::mat4 projection;
+    LightGrid grid;
+};
+
+TEST_FIXTURE(LightGridFixture, TestLightsOnlyInTheirClusters)
+{
+    uint left = grid.addLight(glm::vec3(-20.0f, 0.0f, -50.0f), 2.0f);
+    uint right = grid.addLight(glm::vec3(20.0f, 0.0f, -50.0f), 2.0f);
+    grid.build();
+    CHECK_EQUAL(2u, grid.getNumLights());
+
+    vector<uint> at_left = lightsAt(glm::vec3(-20.0f, 0.0f, -50.0f));
+    CHECK_EQUAL(1u, at_left.size());
+    CHECK_EQUAL(left, at_left[0]);
+
+    vector<uint> at_right = lightsAt(glm::vec3(20.0f, 0.0f, -50.0f));
+    CHECK_EQUAL(1u, at_right.size());
+    CHECK_EQUAL(right, at_right[0]);
+
+    CHECK(lightsAt(glm::vec3(0.0f, 0.0f, -50.0f)).empty());
+    CHECK(lightsAt(glm::vec3(-20.0f, 0.0f, -500.0f)).empty());
+}
+
+TEST_FIXTURE(LightGridFixture, TestLightsOutOfViewAreSkipped)
+{
+    grid.addLight(glm::vec3(0.0f, 0.0f, 50.0f), 10.0f); // Behind.
+    grid.addLight(glm::vec3(500.0f, 0.0f, -10.0f), 10.0f); // Far right.
+    grid.build();
+    CHECK_EQUAL(2u, grid.getNumLights());
+    CHECK(grid.getLightIndices().empty());
+}
+
+TEST_FIXTURE(LightGridFixture, TestLightAroundCameraCoversNearClusters)
+{
+    uint light = grid.addLight(glm::vec3(0.0f, 0.0f, 0.0f), 5.0f);
+    grid.build();
+
+    vector<uint> lights = lightsAt(glm::vec3(2.0f, -1.0f, -2.0f));
+    CHECK_EQUAL(1u, lights.size());
+    CHECK_EQUAL(light, lights[0]);
+}
@@ -0,0 +1,45 @@
+#include <UnitTest++.h>
+
+#include "../materialregistry.h"
+
+using namespace gamefw;
+
+static t_obj_mtl makeMaterial(const float red, const float shininess)
+{
+    t_obj_mtl material;
+    memset(&material, 0, sizeof(material));
+    material.diffuse[0] = red;
+    material.diffuse[3] = 1.0f;
+    material.specular[3] = 1.0f;
+    material.shininess = shininess;
+    return material;
+}
+
+TEST(TestMaterialRegistrySharesEqualMaterials)
+{
+    MaterialRegistry registry;
+    GLuint red = registry.add(makeMaterial(1.0f, 10.0f));
+    GLuint dull_red = registry.add(makeMaterial(1.0f, 2.0f));
+    CHECK_EQUAL(0u, red);
+    CHECK_EQUAL(1u, dull_red);
+
+    // The same material from another file, padding doesn't tell them apart.
+    t_obj_mtl other_red = makeMaterial(1.0f, 10.0f);
+    other_red.padding[0] = 5.0f;
+    CHECK_EQUAL(red, registry.add(other_red));
+    CHECK_EQUAL(2u, registry.size());
+    CHECK_EQUAL(2.0f, registry.getMaterial(dull_red).shininess);
+    CHECK_EQUAL(0u, registry.getBuffer());
+}
+
+TEST(TestMaterialRegistryFull)
+{
+    MaterialRegistry registry;
+    for (uint i = 0; i < MaterialRegistry::CAPACITY; i++) {
+        CHECK_EQUAL(i, registry.add(makeMaterial(0.5f, (float) i)));
+    }
+    // Existing materials are still found, new ones fall back to the first.
+    CHECK_EQUAL(7u, registry.add(makeMaterial(0.5f, 7.0f)));
+    CHECK_EQUAL(0u, registry.add(makeMaterial(0.25f, 1.0f)));
+    CHECK_EQUAL(MaterialRegistry::CAPACITY, registry.size());
+}
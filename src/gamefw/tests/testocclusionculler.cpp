@@ -0,0 +1,143 @@
+#include <UnitTest++.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../occlusionculler.h"
+
+using namespace gamefw;
+
+struct OcclusionCullerFixture
+{
+    OcclusionCullerFixture()
+    {
+        // Camera at the origin looking down -z, a 10x10 wall 10 units ahead.
+        glm::mat4 projection = glm::perspective(60.0f, 2.0f, 1.0f, 100.0f);
+        culler.beginFrame(projection);
+
+        const float wall_positions[] = {-5.0f, -5.0f, 0.0f,
+                                         5.0f, -5.0f, 0.0f,
+                                         5.0f,  5.0f, 0.0f,
+                                        -5.0f,  5.0f, 0.0f};
+        const unsigned short wall_indices[] = {0, 1, 2, 0, 2, 3};
+        glm::mat4 model = glm::translate(glm::mat4(1.0f),
+                                         glm::vec3(0.0f, 0.0f, -10.0f));
+        culler.addOccluder(wall_positions, wall_indices, 6, model);
+        culler.rasterize();
+    }
+
+    OcclusionCuller culler;
+};
+
+TEST_FIXTURE(OcclusionCullerFixture, TestHiddenBehindWall)
+{
+    CHECK_EQUAL(2u, culler.getNumTriangles());
+    CHECK(!culler.isVisible(glm::vec3(0.0f, 0.0f, -20.0f), glm::vec3(1.0f)));
+    CHECK(!culler.isVisible(glm::vec3(2.0f, -2.0f, -50.0f), glm::vec3(3.0f)));
+}
+
+TEST_FIXTURE(OcclusionCullerFixture, TestVisible)
+{
+    // In front of the wall.
+    CHECK(culler.isVisible(glm::vec3(0.0f, 0.0f, -5.0f), glm::vec3(1.0f)));
+    // Behind it but beside it.
+    CHECK(culler.isVisible(glm::vec3(15.0f, 0.0f, -20.0f), glm::vec3(1.0f)));
+    // Partly sticking out from behind it.
+    CHECK(culler.isVisible(glm::vec3(10.0f, 0.0f, -20.0f), glm::vec3(1.0f)));
+    // Crossing the near plane.
+    CHECK(culler.isVisible(glm::vec3(0.0f, 0.0f, -0.5f), glm::vec3(1.0f)));
+}
+
+TEST_FIXTURE(OcclusionCullerFixture, TestPyramid)
+{
+    const uint center_x = culler.getWidth() / 2, center_y = culler.getHeight() / 2;
+    CHECK(culler.getDepth(0, center_x, center_y) < 1.0f);
+    CHECK_EQUAL(1.0f, culler.getDepth(0, 0, 0));
+
+    // The wall doesn't cover the whole screen, so the top is empty.
+    const uint top = culler.getNumLevels() - 1;
+    CHECK_EQUAL(1.0f, culler.getDepth(top, 0, 0));
+
+    // Each level keeps the farthest of the texels below it.
+    for (uint level = 1; level < culler.getNumLevels(); level++) {
+        float finer = culler.getDepth(level - 1, (center_x >> level) * 2,
+                                      (center_y >> level) * 2);
+        CHECK(culler.getDepth(level, center_x >> level, center_y >> level) >= finer);
+    }
+}
+
+TEST_FIXTURE(OcclusionCullerFixture, TestTessellatedMatchesQuad)
+{
+    // Same wall as 20x20 quads, enough triangles to use several threads.
+    const uint n = 20;
+    vector<float> positions;
+    vector<unsigned short> indices;
+    for (uint y = 0; y <= n; y++) {
+        for (uint x = 0; x <= n; x++) {
+            positions.push_back(-5.0f + 10.0f * x / n);
+            positions.push_back(-5.0f + 10.0f * y / n);
+            positions.push_back(0.0f);
+        }
+    }
+    for (uint y = 0; y < n; y++) {
+        for (uint x = 0; x < n; x++) {
+            const uint corner = y * (n + 1) + x;
+            unsigned short quad[] = {
+                (unsigned short) corner, (unsigned short) (corner + 1),
+                (unsigned short) (corner + n + 2), (unsigned short) corner,
+                (unsigned short) (corner + n + 2), (unsigned short) (corner + n + 1)};
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+
+    OcclusionCuller tessellated;
+    tessellated.beginFrame(glm::perspective(60.0f, 2.0f, 1.0f, 100.0f));
+    glm::mat4 model = glm::translate(glm::mat4(1.0f),
+                                     glm::vec3(0.0f, 0.0f, -10.0f));
+    tessellated.addOccluder(&positions[0], &indices[0], indices.size(), model);
+    tessellated.rasterize();
+    CHECK_EQUAL(2 * n * n, tessellated.getNumTriangles());
+
+    // Shared edges may differ by a pixel, the interior must match.
+    for (uint y = 8; y < culler.getHeight() - 8; y += 4) {
+        for (uint x = 8; x < culler.getWidth() - 8; x += 4) {
+            bool covered = culler.getDepth(0, x, y) < 1.0f;
+            bool neighbours_covered = culler.getDepth(0, x - 1, y) < 1.0f &&
+                                      culler.getDepth(0, x + 1, y) < 1.0f &&
+                                      culler.getDepth(0, x, y - 1) < 1.0f &&
+                                      culler.getDepth(0, x, y + 1) < 1.0f;
+            if (covered && neighbours_covered) {
+                CHECK_CLOSE(culler.getDepth(0, x, y),
+                            tessellated.getDepth(0, x, y), 1e-4f);
+            }
+        }
+    }
+    CHECK(!tessellated.isVisible(glm::vec3(0.0f, 0.0f, -20.0f), glm::vec3(1.0f)));
+}
+
+TEST(TestOcclusionCullerEmpty)
+{
+    OcclusionCuller culler;
+    culler.beginFrame(glm::perspective(60.0f, 2.0f, 1.0f, 100.0f));
+    culler.rasterize();
+    CHECK(culler.isVisible(glm::vec3(0.0f, 0.0f, -20.0f), glm::vec3(1.0f)));
+}
+
+TEST(TestOccluderCrossingNearPlane)
+{
+    // A floor below the camera reaching from behind it into the distance.
+    OcclusionCuller culler;
+    culler.beginFrame(glm::perspective(60.0f, 2.0f, 1.0f, 100.0f));
+    const float floor_positions[] = {-50.0f, -1.0f,  10.0f,
+                                      50.0f, -1.0f,  10.0f,
+                                      50.0f, -1.0f, -90.0f,
+                                     -50.0f, -1.0f, -90.0f};
+    const unsigned short floor_indices[] = {0, 1, 2, 0, 2, 3};
+    culler.addOccluder(floor_positions, floor_indices, 6, glm::mat4(1.0f));
+    culler.rasterize();
+
+    // Clipped into at least a triangle each rather than dropped.
+    CHECK(culler.getNumTriangles() >= 2u);
+    CHECK(culler.getDepth(0, culler.getWidth() / 2, 0) < 1.0f);
+    CHECK(!culler.isVisible(glm::vec3(0.0f, -3.0f, -20.0f), glm::vec3(1.0f)));
+    CHECK(culler.isVisible(glm::vec3(0.0f, 1.0f, -20.0f), glm::vec3(1.0f)));
+}
@@ -0,0 +1,130 @@
+#include <UnitTest++.h>
+
+#include "../rendergraph.h"
+
+using namespace gamefw;
+
+TEST(TestRenderGraphCullsUnreadPasses)
+{
+    RenderGraph graph;
+    uint color = graph.addTexture("Color", RenderGraph::RGBA8);
+    uint unused = graph.addTexture("Unused", RenderGraph::RGBA8);
+    uint intermediate = graph.addTexture("Intermediate", RenderGraph::RGBA8);
+
+    uint scene = graph.addPass("Scene");
+    graph.write(scene, color);
+    uint first = graph.addPass("First");
+    graph.write(first, intermediate);
+    uint second = graph.addPass("Second");
+    graph.read(second, intermediate);
+    graph.write(second, unused);
+    uint output = graph.addPass("Output", true);
+    graph.read(output, color);
+    graph.compile();
+
+    CHECK(!graph.isCulled(scene));
+    CHECK(graph.isCulled(first));
+    CHECK(graph.isCulled(second));
+    CHECK(!graph.isCulled(output));
+    CHECK_EQUAL(RenderGraph::CULLED, graph.getPhysicalTexture(unused));
+    CHECK_EQUAL(RenderGraph::CULLED, graph.getPhysicalTexture(intermediate));
+    CHECK_EQUAL(1u, graph.getNumPhysicalTextures());
+}
+
+TEST(TestRenderGraphAliasesDisjointLifetimes)
+{
+    RenderGraph graph;
+    uint a = graph.addTexture("A", RenderGraph::RGBA8);
+    uint b = graph.addTexture("B", RenderGraph::RGBA8);
+    uint c = graph.addTexture("C", RenderGraph::RGBA8);
+
+    uint first = graph.addPass("First");
+    graph.write(first, a);
+    uint second = graph.addPass("Second");
+    graph.read(second, a);
+    graph.write(second, b);
+    uint third = graph.addPass("Third");
+    graph.read(third, b);
+    graph.write(third, c);
+    uint output = graph.addPass("Output", true);
+    graph.read(output, c);
+    graph.compile();
+
+    // A pass's inputs and outputs never share, A is free again for C.
+    CHECK(graph.getPhysicalTexture(a) != graph.getPhysicalTexture(b));
+    CHECK(graph.getPhysicalTexture(b) != graph.getPhysicalTexture(c));
+    CHECK_EQUAL(graph.getPhysicalTexture(a), graph.getPhysicalTexture(c));
+    CHECK_EQUAL(2u, graph.getNumPhysicalTextures());
+    CHECK_EQUAL(2u * 100 * 50 * 4, graph.getMemoryUsage(100, 50));
+}
+
+TEST(TestRenderGraphWidensFormats)
+{
+    RenderGraph graph;
+    uint narrow = graph.addTexture("Narrow", RenderGraph::R8);
+    uint middle = graph.addTexture("Middle", RenderGraph::RG16);
+    uint wide = graph.addTexture("Wide", RenderGraph::RGBA8);
+
+    uint first = graph.addPass("First");
+    graph.write(first, narrow);
+    uint second = graph.addPass("Second");
+    graph.read(second, narrow);
+    graph.write(second, middle);
+    uint third = graph.addPass("Third");
+    graph.read(third, middle);
+    graph.write(third, wide);
+    uint output = graph.addPass("Output", true);
+    graph.read(output, wide);
+    graph.compile();
+
+    // RG16 doesn't fit an 8 bit format, R8 grows to hold RGBA8.
+    CHECK_EQUAL(graph.getPhysicalTexture(narrow), graph.getPhysicalTexture(wide));
+    CHECK(graph.getPhysicalTexture(middle) != graph.getPhysicalTexture(wide));
+    CHECK_EQUAL(RenderGraph::RGBA8, graph.getPhysicalFormat(narrow));
+    CHECK_EQUAL(RenderGraph::RG16, graph.getPhysicalFormat(middle));
+}
+
+TEST(TestRenderGraphKeepsSizesApart)
+{
+    RenderGraph graph;
+    uint full = graph.addTexture("Full", RenderGraph::RGBA8);
+    uint half = graph.addTexture("Half", RenderGraph::RGBA8, 1);
+    uint other = graph.addTexture("Other", RenderGraph::RGBA8);
+
+    uint first = graph.addPass("First");
+    graph.write(first, full);
+    uint second = graph.addPass("Second");
+    graph.read(second, full);
+    graph.write(second, half);
+    uint third = graph.addPass("Third");
+    graph.read(third, half);
+    graph.write(third, other);
+    uint output = graph.addPass("Output", true);
+    graph.read(output, other);
+    graph.compile();
+
+    CHECK_EQUAL(graph.getPhysicalTexture(full), graph.getPhysicalTexture(other));
+    CHECK_EQUAL(2u, graph.getNumPhysicalTextures());
+    CHECK_EQUAL(100u * 50 * 4 + 50 * 25 * 4, graph.getMemoryUsage(100, 50));
+}
+
+TEST(TestRenderGraphKeepsUnsampledDepth)
+{
+    RenderGraph graph;
+    uint color = graph.addTexture("Color", RenderGraph::RGBA8);
+    uint edges = graph.addTexture("Edges", RenderGraph::R8);
+    uint depth = graph.addTexture("Depth", RenderGraph::DEPTH32F_STENCIL8);
+
+    uint scene = graph.addPass("Scene");
+    graph.write(scene, color);
+    graph.write(scene, edges);
+    graph.write(scene, depth);
+    uint output = graph.addPass("Output", true);
+    graph.read(output, color);
+    graph.compile();
+
+    // Depth is still needed for testing, unread color isn't.
+    CHECK(graph.getPhysicalTexture(depth) != RenderGraph::CULLED);
+    CHECK_EQUAL(RenderGraph::CULLED, graph.getPhysicalTexture(edges));
+    CHECK_EQUAL(2u, graph.getNumPhysicalTextures());
+}
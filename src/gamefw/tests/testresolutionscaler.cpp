@@ -0,0 +1,58 @@
+#include <UnitTest++.h>
+
+#include "../resolutionscaler.h"
+
+using namespace gamefw;
+
+// Frame time of a scene costing full_cost milliseconds at full resolution.
+static float frameTime(const float full_cost, const float scale)
+{
+    return full_cost * scale * scale;
+}
+
+TEST(TestResolutionScalerKeepsFullResolutionWhenFast)
+{
+    ResolutionScaler scaler(16.0f, 0.5f, 1.0f);
+    for (int i = 0; i < 100; i++) {
+        scaler.update(frameTime(8.0f, scaler.getScale()));
+    }
+    CHECK_EQUAL(1.0f, scaler.getScale());
+}
+
+TEST(TestResolutionScalerConvergesUnderTarget)
+{
+    ResolutionScaler scaler(16.0f, 0.5f, 1.0f);
+    for (int i = 0; i < 100; i++) {
+        scaler.update(frameTime(24.0f, scaler.getScale()));
+    }
+    float frame_time = frameTime(24.0f, scaler.getScale());
+    CHECK(scaler.getScale() < 1.0f);
+    CHECK(frame_time <= 16.0f);
+    CHECK(frame_time > 12.0f);
+
+    // Stays put once converged.
+    float scale = scaler.getScale();
+    scaler.update(frame_time);
+    CHECK_EQUAL(scale, scaler.getScale());
+}
+
+TEST(TestResolutionScalerRespondsToSpikes)
+{
+    ResolutionScaler scaler(16.0f, 0.5f, 1.0f);
+
+    // A single very slow frame drops the scale right away, clamped.
+    scaler.update(1000.0f);
+    CHECK(scaler.getScale() < 0.8f);
+    for (int i = 0; i < 10; i++) {
+        scaler.update(1000.0f);
+    }
+    CHECK_CLOSE(0.5f, scaler.getScale(), 1e-3f);
+
+    // Recovers gradually once the load is gone.
+    scaler.update(frameTime(8.0f, scaler.getScale()));
+    CHECK(scaler.getScale() < 0.6f);
+    for (int i = 0; i < 100; i++) {
+        scaler.update(frameTime(8.0f, scaler.getScale()));
+    }
+    CHECK_CLOSE(1.0f, scaler.getScale(), 1e-3f);
+}
@@ -0,0 +1,123 @@
+#include <UnitTest++.h>
+
+#include <algorithm>
+#include <SFML/System.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../snapshotqueue.h"
+#include "../renderjob.h"
+
+using namespace gamefw;
+
+TEST(TestFrameSnapshotCopiesRenderState)
+{
+    FrameSnapshot queue;
+    shared_ptr<Entity> entity(new Entity);
+    entity->m_position = glm::vec3(1.0f, 2.0f, 3.0f);
+    shared_ptr<PointLight> light(new PointLight);
+    light->m_color = glm::vec3(0.5f);
+    light->m_radius = 4.0f;
+    queue.setCamera(shared_ptr<Entity>(new Entity));
+    queue.addEntity(entity);
+    queue.addPointLight(light);
+
+    FrameSnapshot snapshot;
+    snapshot.copy(queue);
+    entity->m_position = glm::vec3(0.0f);
+    light->m_radius = 1.0f;
+
+    CHECK(snapshot.getEntities()[0] != entity);
+    CHECK_EQUAL(2.0f, snapshot.getEntities()[0]->m_position.y);
+    CHECK_EQUAL(4.0f, snapshot.getPointLights()[0]->m_radius);
+    CHECK_EQUAL(0.5f, snapshot.getPointLights()[0]->m_color.g);
+    CHECK(snapshot.getCamera());
+}
+
+TEST(TestFrameSnapshotReusesCopies)
+{
+    FrameSnapshot queue;
+    queue.addEntity(shared_ptr<Entity>(new Entity));
+    FrameSnapshot snapshot;
+    snapshot.copy(queue);
+    shared_ptr<Entity> first = snapshot.getEntities()[0];
+
+    queue.clear();
+    queue.addEntity(shared_ptr<Entity>(new Entity));
+    queue.addEntity(shared_ptr<Entity>(new Entity));
+    snapshot.copy(queue);
+
+    CHECK_EQUAL(2u, snapshot.getEntities().size());
+    CHECK(snapshot.getEntities()[0] == first);
+}
+
+TEST(TestFrameSnapshotCopiesHierarchies)
+{
+    shared_ptr<RenderJob> renderjob(new RenderJob);
+    float positions[] = {-1.0f, -1.0f, -1.0f,
+                          1.0f,  1.0f,  1.0f};
+    renderjob->m_bounds = BoundingVolume(positions, 2, sizeof(float) * 3);
+    vector<shared_ptr<Entity> > entities;
+    for (int i = 0; i < 8; i++) {
+        shared_ptr<Entity> entity(new Entity);
+        entity->setRenderJob(renderjob);
+        entity->m_position = glm::vec3(i * 4.0f, 0.0f, -10.0f);
+        entities.push_back(entity);
+    }
+    FrameSnapshot queue;
+    queue.addHierarchy(shared_ptr<BoundingVolumeHierarchy>(
+        new BoundingVolumeHierarchy(entities)));
+
+    FrameSnapshot snapshot;
+    snapshot.copy(queue);
+    entities[0]->m_position.y = 100.0f;
+    queue.getHierarchies()[0]->refit();
+
+    const BoundingVolumeHierarchy& copy = *snapshot.getHierarchies()[0];
+    CHECK(&copy != queue.getHierarchies()[0].get());
+    CHECK_EQUAL(8u, copy.size());
+    vector<shared_ptr<Entity> > visible;
+    copy.cull(Frustum(glm::ortho(-1.0f, 40.0f, -2.0f, 2.0f, 0.0f, 20.0f)), visible);
+    CHECK_EQUAL(8u, visible.size());
+    foreach (shared_ptr<Entity> entity, visible) {
+        CHECK(std::find(entities.begin(), entities.end(), entity) == entities.end());
+        CHECK_EQUAL(0.0f, entity->m_position.y);
+    }
+}
+
+struct Consumer {
+    SnapshotQueue* queue;
+    vector<float> positions;
+};
+
+static void consume(Consumer* consumer)
+{
+    while (FrameSnapshot* snapshot = consumer->queue->beginRead()) {
+        consumer->positions.push_back(snapshot->getEntities()[0]->m_position.x);
+        consumer->queue->endRead();
+    }
+}
+
+TEST(TestSnapshotQueueHandsOverFramesInOrder)
+{
+    SnapshotQueue queue(2);
+    Consumer consumer;
+    consumer.queue = &queue;
+    sf::Thread reader(&consume, &consumer);
+    reader.launch();
+
+    FrameSnapshot frame;
+    shared_ptr<Entity> entity(new Entity);
+    frame.addEntity(entity);
+    for (uint i = 0; i < 100; i++) {
+        entity->m_position.x = (float) i;
+        queue.beginWrite()->copy(frame);
+        queue.endWrite();
+    }
+    queue.close();
+    reader.wait();
+
+    CHECK_EQUAL(100u, consumer.positions.size());
+    for (uint i = 0; i < consumer.positions.size(); i++) {
+        CHECK_EQUAL((float) i, consumer.positions[i]);
+    }
+}
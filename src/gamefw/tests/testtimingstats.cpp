@@ -0,0 +1,50 @@
+#include <UnitTest++.h>
+
+#include "../timingstats.h"
+
+using namespace gamefw;
+
+TEST(TestTimingStatsEmpty)
+{
+    TimingStats stats(10);
+    CHECK_EQUAL(0u, stats.getNumSamples());
+    CHECK_EQUAL(0.0f, stats.getAverage());
+    CHECK_EQUAL(0.0f, stats.getPercentile(50.0f));
+    CHECK_EQUAL(0.0f, stats.getLatest());
+}
+
+TEST(TestTimingStatsAverageAndPercentiles)
+{
+    TimingStats stats(100);
+    // 1 to 100 in a scrambled order.
+    for (uint i = 0; i < 100; i++) {
+        stats.add((float) ((i * 37) % 100 + 1));
+    }
+    CHECK_EQUAL(100u, stats.getNumSamples());
+    CHECK_CLOSE(50.5f, stats.getAverage(), 1e-4f);
+    CHECK_EQUAL(50.0f, stats.getPercentile(50.0f));
+    CHECK_EQUAL(95.0f, stats.getPercentile(95.0f));
+    CHECK_EQUAL(100.0f, stats.getPercentile(100.0f));
+    CHECK_EQUAL(1.0f, stats.getPercentile(0.0f));
+    CHECK_EQUAL(64.0f, stats.getLatest()); // 99 * 37 % 100 + 1.
+}
+
+TEST(TestTimingStatsWindowDropsOldest)
+{
+    TimingStats stats(4);
+    stats.add(100.0f);
+    stats.add(100.0f);
+    for (uint i = 0; i < 4; i++) {
+        stats.add(2.0f);
+    }
+    CHECK_EQUAL(4u, stats.getNumSamples());
+    CHECK_EQUAL(6u, stats.getTotalSamples());
+    CHECK_CLOSE(2.0f, stats.getAverage(), 1e-6f);
+    CHECK_EQUAL(2.0f, stats.getPercentile(99.0f));
+
+    stats.clear();
+    CHECK_EQUAL(0u, stats.getNumSamples());
+    CHECK_EQUAL(0u, stats.getTotalSamples());
+    stats.add(3.0f);
+    CHECK_CLOSE(3.0f, stats.getAverage(), 1e-6f);
+}
@@ -0,0 +1,81 @@
+#include <UnitTest++.h>
+
+#include "../transformstore.h"
+
+using namespace gamefw;
+
+static void checkMatrixClose(const glm::mat4& expected, const glm::mat4& actual,
+                             const int size = 4)
+{
+    for (int column = 0; column < size; column++) {
+        for (int row = 0; row < size; row++) {
+            CHECK_CLOSE(expected[column][row], actual[column][row], 1e-5f);
+        }
+    }
+}
+
+struct TransformStoreFixture
+{
+    TransformStoreFixture()
+    {
+        // More than one batch.
+        for (int i = 0; i < 13; i++) {
+            shared_ptr<Entity> entity(new Entity());
+            entity->m_position = glm::vec3(i, 2.0f * i, -3.0f * i);
+            entity->m_orientation = glm::vec3(0.1f * i, 0.2f * i, 0.3f * i);
+            entities.push_back(entity);
+        }
+    }
+
+    uint syncAndUpdate()
+    {
+        foreach (shared_ptr<Entity> entity, entities) {
+            transforms.sync(*entity);
+        }
+        return transforms.update();
+    }
+
+    vector<shared_ptr<Entity> > entities;
+    TransformStore transforms;
+};
+
+TEST_FIXTURE(TransformStoreFixture, TestMatchesEntityMatrices)
+{
+    CHECK_EQUAL(entities.size(), syncAndUpdate());
+    CHECK_EQUAL(entities.size(), transforms.size());
+
+    foreach (shared_ptr<Entity> entity, entities) {
+        glm::mat4 model = entity->getModelMatrix();
+        checkMatrixClose(model, transforms.getModelMatrix(*entity));
+        // Normals have w = 0, so only the upper 3x3 part matters.
+        checkMatrixClose(glm::transpose(glm::inverse(model)),
+                         transforms.getNormalMatrix(*entity), 3);
+    }
+}
+
+TEST_FIXTURE(TransformStoreFixture, TestOnlyChangedAreRebuilt)
+{
+    syncAndUpdate();
+    CHECK_EQUAL(0u, syncAndUpdate());
+
+    entities[4]->m_position.y += 1.0f;
+    entities[9]->m_orientation.x += 1.0f;
+    CHECK_EQUAL(2u, syncAndUpdate());
+    checkMatrixClose(entities[4]->getModelMatrix(),
+                     transforms.getModelMatrix(*entities[4]));
+    checkMatrixClose(entities[9]->getModelMatrix(),
+                     transforms.getModelMatrix(*entities[9]));
+}
+
+TEST_FIXTURE(TransformStoreFixture, TestCopiedEntityGetsOwnSlot)
+{
+    syncAndUpdate();
+
+    Entity copy(*entities[0]);
+    copy.m_position.x = 100.0f;
+    transforms.sync(copy);
+    CHECK_EQUAL(1u, transforms.update());
+    CHECK_EQUAL(entities.size() + 1, transforms.size());
+    CHECK_CLOSE(100.0f, transforms.getModelMatrix(copy)[3].x, 1e-6f);
+    CHECK_CLOSE(0.0f, transforms.getModelMatrix(*entities[0])[3].x, 1e-6f);
+}
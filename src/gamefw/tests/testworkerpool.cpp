@@ -0,0 +1,36 @@
+#include <UnitTest++.h>
+
+#include "../workerpool.h"
+
+using namespace gamefw;
+
+static void square(uint* value)
+{
+    *value *= *value;
+}
+
+TEST(TestWorkerPoolRunsEveryTask)
+{
+    WorkerPool pool("Test worker", 3);
+    CHECK_EQUAL(3u, pool.getNumWorkers());
+    // Also more tasks than threads, and the pool reused.
+    for (uint num_tasks = 0; num_tasks < 10; num_tasks++) {
+        vector<uint> values;
+        for (uint i = 0; i < num_tasks; i++) {
+            values.push_back(i);
+        }
+        pool.run(&square, num_tasks == 0 ? 0 : &values[0], num_tasks);
+        for (uint i = 0; i < num_tasks; i++) {
+            CHECK_EQUAL(i * i, values[i]);
+        }
+    }
+}
+
+TEST(TestWorkerPoolWithoutWorkers)
+{
+    WorkerPool pool("Test worker", 0);
+    uint values[] = {2, 3};
+    pool.run(&square, values, 2);
+    CHECK_EQUAL(4u, values[0]);
+    CHECK_EQUAL(9u, values[1]);
+}
@@ -49,9 +49,7 @@ int main(int argc, char* argv[])
         if (time_since_draw >= 1.0f/60) {
             gameworld.update();
             clock.restart();
-            foreach(shared_ptr<Entity> entity, entitylist) {
-                renderer->addToRenderQueue(entity);
-            }
+            renderer->addToRenderQueue(level->m_entity_hierarchy);
             
             renderer->addToPointLightQueue(camera);
             foreach(shared_ptr<PointLight> pointlight, pointlightlist) {
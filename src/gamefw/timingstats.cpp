@@ -0,0 +1,79 @@
+#include "timingstats.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace gamefw;
+
+TimingStats::TimingStats(const uint window)
+:
+m_samples(std::max(window, 1u), 0.0f),
+m_next(0),
+m_num_samples(0),
+m_total_samples(0),
+m_sum(0.0)
+{
+}
+
+void TimingStats::add(const float milliseconds)
+{
+    if (m_num_samples == m_samples.size()) {
+        m_sum -= m_samples[m_next];
+    } else {
+        m_num_samples++;
+    }
+    m_samples[m_next] = milliseconds;
+    m_sum += milliseconds;
+    m_next = (m_next + 1) % m_samples.size();
+    m_total_samples++;
+}
+
+void TimingStats::clear()
+{
+    m_next = 0;
+    m_num_samples = 0;
+    m_total_samples = 0;
+    m_sum = 0.0;
+}
+
+float TimingStats::getAverage() const
+{
+    if (m_num_samples == 0) {
+        return 0.0f;
+    }
+    return (float) (m_sum / m_num_samples);
+}
+
+float TimingStats::getPercentile(const float percentile) const
+{
+    if (m_num_samples == 0) {
+        return 0.0f;
+    }
+
+    // Nearest rank. The window is small, sorting a copy is cheap enough for
+    // occasional queries.
+    vector<float> sorted(m_samples.begin(), m_samples.begin() + m_num_samples);
+    float clamped = std::max(0.0f, std::min(percentile, 100.0f));
+    uint rank = (uint) std::ceil(clamped / 100.0f * m_num_samples);
+    uint index = rank == 0 ? 0 : rank - 1;
+    std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+    return sorted[index];
+}
+
+float TimingStats::getLatest() const
+{
+    if (m_num_samples == 0) {
+        return 0.0f;
+    }
+    return m_samples[(m_next + m_samples.size() - 1) % m_samples.size()];
+}
+
+uint TimingStats::getNumSamples() const
+{
+    return m_num_samples;
+}
+
+uint TimingStats::getTotalSamples() const
+{
+    return m_total_samples;
+}
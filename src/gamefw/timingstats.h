@@ -0,0 +1,69 @@
+#ifndef TIMINGSTATS_H
+#define TIMINGSTATS_H
+
+#include "../common.h"
+
+namespace gamefw {
+
+/**
+ * @brief Rolling window of timing samples.
+ *
+ * Keeps the most recent samples, so the average and percentiles follow
+ * changes in load instead of being diluted by the whole session.
+ **/
+class TimingStats
+{
+public:
+    /**
+     * @param window Number of most recent samples kept.
+     **/
+    explicit TimingStats(const uint window = 120);
+
+    /**
+     * @brief Adds a sample, dropping the oldest one if the window is full.
+     *
+     * @param milliseconds ditto.
+     **/
+    void add(const float milliseconds);
+
+    /// Removes all samples.
+    void clear();
+
+    /**
+     * @return Mean of the samples, 0 if there are none.
+     **/
+    float getAverage() const;
+
+    /**
+     * @param percentile In [0, 100].
+     * @return Smallest sample that at least the given percentage of samples
+     *         are less than or equal to, 0 if there are none.
+     **/
+    float getPercentile(const float percentile) const;
+
+    /**
+     * @return The most recent sample, 0 if there are none.
+     **/
+    float getLatest() const;
+
+    uint getNumSamples() const;
+
+    /**
+     * @return Number of samples added since construction or clear(),
+     *         including the ones dropped from the window.
+     **/
+    uint getTotalSamples() const;
+
+private:
+    vector<float> m_samples;
+    /// Where the next sample goes, the oldest once the window is full.
+    uint m_next;
+    uint m_num_samples;
+    uint m_total_samples;
+    /// Running sum of the samples in the window.
+    double m_sum;
+};
+
+}
+
+#endif // TIMINGSTATS_H
@@ -0,0 +1,181 @@
+#include "transformstore.h"
+
+#include <cmath>
+
+#include "simd.h"
+
+using namespace gamefw;
+
+/// Slots not synced for this many frames may be given to other entities.
+const uint STALE_FRAMES = 120;
+
+/// Matrices rebuilt per batch. A multiple of every SIMD width.
+const uint BATCH_SIZE = 8;
+
+TransformStore::TransformStore()
+:
+m_frame(0)
+{
+}
+
+void TransformStore::sync(Entity& entity)
+{
+    uint slot = entity.m_transform_slot;
+    if (slot >= m_owners.size() || m_owners[slot] != &entity) {
+        slot = allocateSlot(entity);
+        entity.m_transform_slot = slot;
+    }
+    m_last_synced[slot] = m_frame;
+
+    const glm::vec3& position = entity.m_position;
+    const glm::vec3& orientation = entity.m_orientation;
+    if (m_position_x[slot] == position.x && m_position_y[slot] == position.y &&
+        m_position_z[slot] == position.z && m_yaw[slot] == orientation.x &&
+        m_pitch[slot] == orientation.y && m_roll[slot] == orientation.z) {
+        return;
+    }
+
+    m_position_x[slot] = position.x;
+    m_position_y[slot] = position.y;
+    m_position_z[slot] = position.z;
+    m_yaw[slot] = orientation.x;
+    m_pitch[slot] = orientation.y;
+    m_roll[slot] = orientation.z;
+    if (!m_dirty[slot]) {
+        m_dirty[slot] = true;
+        m_dirty_slots.push_back(slot);
+    }
+}
+
+uint TransformStore::update()
+{
+    const uint num_dirty = m_dirty_slots.size();
+    for (uint i = 0; i < num_dirty; i += BATCH_SIZE) {
+        buildMatrices(&m_dirty_slots[i], std::min(BATCH_SIZE, num_dirty - i));
+    }
+    foreach (uint slot, m_dirty_slots) {
+        m_dirty[slot] = false;
+    }
+    m_dirty_slots.clear();
+
+    // Recycle slots of entities that haven't been seen for a while.
+    m_frame++;
+    if (m_frame % STALE_FRAMES == 0) {
+        m_free_slots.clear();
+        for (uint slot = 0; slot < m_owners.size(); slot++) {
+            if (m_frame - m_last_synced[slot] >= STALE_FRAMES) {
+                m_owners[slot] = 0;
+                m_free_slots.push_back(slot);
+            }
+        }
+    }
+    return num_dirty;
+}
+
+const glm::mat4& TransformStore::getModelMatrix(const Entity& entity) const
+{
+    assert(entity.m_transform_slot < m_owners.size() &&
+           m_owners[entity.m_transform_slot] == &entity);
+    return m_model[entity.m_transform_slot];
+}
+
+glm::mat4 TransformStore::getNormalMatrix(const Entity& entity) const
+{
+    glm::mat4 normalmatrix = getModelMatrix(entity);
+    normalmatrix[3] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    return normalmatrix;
+}
+
+uint TransformStore::size() const
+{
+    return m_owners.size();
+}
+
+uint TransformStore::allocateSlot(const Entity& entity)
+{
+    uint slot;
+    if (!m_free_slots.empty()) {
+        slot = m_free_slots.back();
+        m_free_slots.pop_back();
+    } else {
+        slot = m_owners.size();
+        m_position_x.push_back(0.0f);
+        m_position_y.push_back(0.0f);
+        m_position_z.push_back(0.0f);
+        m_yaw.push_back(0.0f);
+        m_pitch.push_back(0.0f);
+        m_roll.push_back(0.0f);
+        m_model.push_back(glm::mat4(1.0f));
+        m_owners.push_back(0);
+        m_last_synced.push_back(0);
+        m_dirty.push_back(false);
+    }
+    m_owners[slot] = &entity;
+
+    // Queue the first build even if the entity sits at the origin.
+    m_dirty[slot] = true;
+    m_dirty_slots.push_back(slot);
+    return slot;
+}
+
+void TransformStore::buildMatrices(const uint* slots, const uint count)
+{
+    // Gather the batch and evaluate the angles.
+    float ch[BATCH_SIZE], sh[BATCH_SIZE], cp[BATCH_SIZE], sp[BATCH_SIZE],
+          cb[BATCH_SIZE], sb[BATCH_SIZE];
+    for (uint i = 0; i < BATCH_SIZE; i++) {
+        uint slot = slots[std::min(i, count - 1)]; // Pad with the last one.
+        ch[i] = std::cos(m_yaw[slot]);
+        sh[i] = std::sin(m_yaw[slot]);
+        cp[i] = std::cos(m_pitch[slot]);
+        sp[i] = std::sin(m_pitch[slot]);
+        cb[i] = std::cos(m_roll[slot]);
+        sb[i] = std::sin(m_roll[slot]);
+    }
+
+    // Rotation part as in glm::yawPitchRoll, element [column][row].
+    float r[3][3][BATCH_SIZE];
+#ifdef GAMEFW_SIMD
+    for (uint i = 0; i < BATCH_SIZE; i += SIMD_WIDTH) {
+        simd_float v_ch = simdLoad(ch + i), v_sh = simdLoad(sh + i);
+        simd_float v_cp = simdLoad(cp + i), v_sp = simdLoad(sp + i);
+        simd_float v_cb = simdLoad(cb + i), v_sb = simdLoad(sb + i);
+        simd_float sh_sp = simdMul(v_sh, v_sp);
+        simd_float ch_sp = simdMul(v_ch, v_sp);
+
+        simdStore(r[0][0] + i, simdAdd(simdMul(v_ch, v_cb), simdMul(sh_sp, v_sb)));
+        simdStore(r[0][1] + i, simdMul(v_sb, v_cp));
+        simdStore(r[0][2] + i, simdSub(simdMul(ch_sp, v_sb), simdMul(v_sh, v_cb)));
+        simdStore(r[1][0] + i, simdSub(simdMul(sh_sp, v_cb), simdMul(v_ch, v_sb)));
+        simdStore(r[1][1] + i, simdMul(v_cb, v_cp));
+        simdStore(r[1][2] + i, simdAdd(simdMul(v_sb, v_sh), simdMul(ch_sp, v_cb)));
+        simdStore(r[2][0] + i, simdMul(v_sh, v_cp));
+        simdStore(r[2][1] + i, simdSub(simdSet(0.0f), v_sp));
+        simdStore(r[2][2] + i, simdMul(v_ch, v_cp));
+    }
+#else
+    for (uint i = 0; i < BATCH_SIZE; i++) {
+        r[0][0][i] = ch[i] * cb[i] + sh[i] * sp[i] * sb[i];
+        r[0][1][i] = sb[i] * cp[i];
+        r[0][2][i] = ch[i] * sp[i] * sb[i] - sh[i] * cb[i];
+        r[1][0][i] = sh[i] * sp[i] * cb[i] - ch[i] * sb[i];
+        r[1][1][i] = cb[i] * cp[i];
+        r[1][2][i] = sb[i] * sh[i] + ch[i] * sp[i] * cb[i];
+        r[2][0][i] = sh[i] * cp[i];
+        r[2][1][i] = -sp[i];
+        r[2][2][i] = ch[i] * cp[i];
+    }
+#endif
+
+    // Scatter.
+    for (uint i = 0; i < count; i++) {
+        const uint slot = slots[i];
+        glm::mat4& model = m_model[slot];
+        for (int column = 0; column < 3; column++) {
+            model[column] = glm::vec4(r[column][0][i], r[column][1][i],
+                                      r[column][2][i], 0.0f);
+        }
+        model[3] = glm::vec4(m_position_x[slot], m_position_y[slot],
+                             m_position_z[slot], 1.0f);
+    }
+}
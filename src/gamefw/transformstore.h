@@ -0,0 +1,85 @@
+#ifndef TRANSFORMSTORE_H
+#define TRANSFORMSTORE_H
+
+#include "../common.h"
+
+#include "entity.h"
+
+namespace gamefw {
+
+/**
+ * @brief Caches entity model matrices, rebuilding only those that changed.
+ *
+ * Positions and orientations are copied into structure of arrays form by
+ * sync(), which marks an entity dirty when either differs from the last copy.
+ * update() then rebuilds the dirty matrices in SIMD batches. Static entities
+ * such as floor tiles cost a comparison per frame instead of a matrix build.
+ *
+ * Entities get a slot the first time they are synced. Slots of entities that
+ * haven't been synced for a while are reused, the entity gets a new slot if
+ * it shows up again.
+ **/
+class TransformStore
+{
+public:
+    TransformStore();
+
+    /**
+     * @brief Copies the entity's transform into the store.
+     *
+     * @param entity ditto.
+     **/
+    void sync(Entity& entity);
+
+    /**
+     * @brief Rebuilds the matrices of entities whose transform changed.
+     *
+     * @return Number of matrices rebuilt.
+     **/
+    uint update();
+
+    /**
+     * @brief The entity's model matrix as of the last update().
+     *
+     * @param entity An entity synced this frame.
+     **/
+    const glm::mat4& getModelMatrix(const Entity& entity) const;
+
+    /**
+     * @brief The entity's normal matrix as of the last update().
+     *
+     * Entities are only rotated and translated, so the inverse transpose of
+     * the model matrix is its rotation part.
+     *
+     * @param entity An entity synced this frame.
+     **/
+    glm::mat4 getNormalMatrix(const Entity& entity) const;
+
+    /**
+     * @return Number of slots, in use or free.
+     **/
+    uint size() const;
+
+private:
+    uint allocateSlot(const Entity& entity);
+    void buildMatrices(const uint* slots, const uint count);
+
+    // Inputs, as of the last sync().
+    vector<float> m_position_x, m_position_y, m_position_z;
+    vector<float> m_yaw, m_pitch, m_roll;
+
+    vector<glm::mat4> m_model;
+    /// Entity occupying each slot, used to detect stale slot indices.
+    vector<const Entity*> m_owners;
+    /// Frame each slot was last synced in.
+    vector<uint> m_last_synced;
+    vector<bool> m_dirty;
+    vector<uint> m_dirty_slots;
+    vector<uint> m_free_slots;
+
+    uint m_frame;
+};
+
+}
+
+#endif // TRANSFORMSTORE_H
@@ -0,0 +1,79 @@
+#include "workerpool.h"
+
+#include <SFML/System.hpp>
+
+using namespace gamefw;
+
+WorkerPool::WorkerPool(const char* name, const uint num_workers)
+:
+m_name(name),
+m_batch(0),
+m_num_tasks(0)
+{
+    for (uint i = 0; i < num_workers; i++) {
+        shared_ptr<Worker> worker(new Worker);
+        worker->pool = this;
+        worker->share = i + 1;
+        worker->thread.reset(new sf::Thread(&workerLoop, worker.get()));
+        m_workers.push_back(worker);
+    }
+    foreach (shared_ptr<Worker> worker, m_workers) {
+        worker->thread->launch();
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    m_batch = 0;
+    foreach (shared_ptr<Worker> worker, m_workers) {
+        worker->start.post();
+    }
+    foreach (shared_ptr<Worker> worker, m_workers) {
+        worker->thread->wait();
+    }
+}
+
+uint WorkerPool::getNumWorkers() const
+{
+    return m_workers.size();
+}
+
+void WorkerPool::runBatch(BatchBase& batch, const uint num_tasks)
+{
+    m_batch = &batch;
+    m_num_tasks = num_tasks;
+
+    // Only the workers with a share of the tasks are woken up.
+    const uint num_woken = std::min((uint) m_workers.size(),
+                                    num_tasks > 0 ? num_tasks - 1 : 0);
+    for (uint i = 0; i < num_woken; i++) {
+        m_workers[i]->start.post();
+    }
+    runShare(0);
+    for (uint i = 0; i < num_woken; i++) {
+        m_done.wait();
+    }
+    m_batch = 0;
+}
+
+void WorkerPool::runShare(const uint share)
+{
+    const uint stride = m_workers.size() + 1;
+    for (uint task = share; task < m_num_tasks; task += stride) {
+        m_batch->call(task);
+    }
+}
+
+void WorkerPool::workerLoop(Worker* worker)
+{
+    WorkerPool& pool = *worker->pool;
+    PROFILE_THREAD(pool.m_name);
+    for (;;) {
+        worker->start.wait();
+        if (pool.m_batch == 0) {
+            return;
+        }
+        pool.runShare(worker->share);
+        pool.m_done.post();
+    }
+}
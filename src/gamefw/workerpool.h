@@ -0,0 +1,112 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include "../common.h"
+
+#include "semaphore.h"
+
+namespace sf {
+class Thread;
+}
+
+namespace gamefw {
+
+/**
+ * @brief Threads kept waiting for work, so that work split over threads
+ * every frame doesn't pay for creating the threads every frame.
+ *
+ * run() hands the workers one batch of tasks at a time and returns once all
+ * of them are done. The calling thread takes its share of the tasks too.
+ **/
+class WorkerPool
+{
+public:
+    /**
+     * @brief Starts the workers, which wait for run().
+     *
+     * @param name Names the workers in profiles. String literal or otherwise
+     *        outliving the pool.
+     * @param num_workers Threads besides the one calling run().
+     **/
+    WorkerPool(const char* name, const uint num_workers);
+
+    /**
+     * @brief Waits for the workers to quit.
+     **/
+    ~WorkerPool();
+
+    uint getNumWorkers() const;
+
+    /**
+     * @brief Calls function once with each task, spread over the workers
+     * and the calling thread, and returns when all calls have returned.
+     *
+     * Not to be called from several threads at once.
+     *
+     * @param function Called concurrently.
+     * @param tasks num_tasks tasks.
+     * @param num_tasks ditto.
+     **/
+    template <typename Task>
+    void run(void (*function)(Task*), Task* tasks, const uint num_tasks)
+    {
+        Batch<Task> batch(function, tasks);
+        runBatch(batch, num_tasks);
+    }
+
+private:
+    WorkerPool(const WorkerPool&);
+    WorkerPool& operator=(const WorkerPool&);
+
+    /// Tasks of one run(), whatever their type.
+    struct BatchBase {
+        virtual ~BatchBase() {}
+        virtual void call(const uint task) = 0;
+    };
+
+    template <typename Task>
+    struct Batch : public BatchBase {
+        Batch(void (*function)(Task*), Task* tasks)
+        :
+        function(function),
+        tasks(tasks)
+        {
+        }
+
+        void call(const uint task)
+        {
+            function(&tasks[task]);
+        }
+
+        void (*function)(Task*);
+        Task* tasks;
+    };
+
+    struct Worker {
+        WorkerPool* pool;
+        /// Share of the tasks, 0 being the thread calling run().
+        uint share;
+        /// Posted when there is a batch, or when quitting.
+        Semaphore start;
+        shared_ptr<sf::Thread> thread;
+    };
+
+    void runBatch(BatchBase& batch, const uint num_tasks);
+
+    /// Calls every (num_workers + 1)th task of the batch from share on.
+    void runShare(const uint share);
+
+    static void workerLoop(Worker* worker);
+
+    const char* m_name;
+    vector<shared_ptr<Worker> > m_workers;
+    /// Posted by each worker when its share is done.
+    Semaphore m_done;
+    /// Batch being run, null tells the workers to quit.
+    BatchBase* m_batch;
+    uint m_num_tasks;
+};
+
+}
+
+#endif // WORKERPOOL_H
@@ -18,6 +18,60 @@ uniform sampler2D texture7;
 
 uniform float display_width, display_height;
 
+// Last texel centers of the part of the render targets drawn to, with
+// dynamic resolution. Fullscreen passes clamp their taps to them, bilinear
+// taps past them would blend in stale texels from outside it.
+uniform vec2 render_texcoord_max;
+
+vec4 texture_scaled(sampler2D sampler, vec2 texcoord)
+{
+    return texture(sampler, min(texcoord, render_texcoord_max));
+}
+
+
+// G-buffer layout: diffuse, specular with the packed attributes in alpha and
+// octahedral normals. Positions are reconstructed from the depth.
+//
+// The attribute byte holds the shininess in the high six bits, then whether
+// the surface is lit and whether it isn't the skybox. A cleared pixel is an
+// unlit skybox.
+const uint EXTRA_LIT = 1u;
+const uint EXTRA_NOT_SKYBOX = 2u;
+
+float pack_extra(float shininess, uint flags)
+{
+    uint quantized = uint(clamp(shininess, 0.0, 1.0) * 63.0 + 0.5);
+    return float(quantized * 4u + flags) / 255.0;
+}
+
+void unpack_extra(float encoded, out float shininess, out uint flags)
+{
+    uint bits = uint(encoded * 255.0 + 0.5);
+    shininess = float(bits >> 2u) / 63.0;
+    flags = bits & 3u;
+}
+
+// Octahedral normal encoding into [0, 1] for an unsigned normalized target.
+vec2 encode_normal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 folded = n.xy;
+    if (n.z < 0.0) {
+        folded = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0,
+                                          n.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return folded * 0.5 + 0.5;
+}
+
+vec3 decode_normal(vec2 encoded)
+{
+    vec2 f = encoded * 2.0 - 1.0;
+    vec3 n = vec3(f, 1.0 - abs(f.x) - abs(f.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
 
 #define INIT_DELTA vec2 delta[8];\
 delta[0] = vec2(-1.0,1.0);\
@@ -32,6 +86,20 @@ delta[7] = vec2(0.0,1.0);
 #ifdef GBUFFER
 uniform vec3 viewer_position;
 
+// Depth of the G-buffer, back projected to world space positions.
+uniform sampler2D gbuffer_depth;
+uniform mat4 inverse_viewprojection;
+// Fraction of the render targets the scene was rendered to.
+uniform float render_scale;
+
+vec3 reconstruct_position(vec2 texcoord)
+{
+    float depth = texture_scaled(gbuffer_depth, texcoord).r;
+    vec2 screen = texcoord / render_scale;
+    vec4 position = inverse_viewprojection * vec4(vec3(screen, depth) * 2.0 - 1.0, 1.0);
+    return position.xyz / position.w;
+}
+
 // Edge detection using normal map.
 float detect_edges(
     vec2 pixel_size,
@@ -39,10 +107,10 @@ float detect_edges(
 {
     INIT_DELTA
    
-    vec4 normal = texture(texture2, frag_texcoord);
+    vec3 normal = decode_normal(texture_scaled(texture2, frag_texcoord).rg);
     float factor = 0.0;
     for(int i = 0; i < 4; i++) {
-        vec4 t = texture(texture2, frag_texcoord + delta[i] * pixel_size);
+        vec3 t = decode_normal(texture_scaled(texture2, frag_texcoord + delta[i] * pixel_size).rg);
         t -= normal;
         factor += dot(t, t);
     }
@@ -50,48 +118,93 @@ float detect_edges(
     return factor;
 }
 
-#define POINTLIGHTS 10
-uniform int num_pointlights;
+// Clustered lighting. Each cluster has an offset and count into
+// light_indices, each light two texels in light_data: position and radius,
+// then color and intensity.
+uniform mat4 view;
+uniform usamplerBuffer light_clusters;
+uniform usamplerBuffer light_indices;
+uniform samplerBuffer light_data;
+uniform ivec3 cluster_size;
+uniform float cluster_slice_scale;
+uniform float cluster_slice_bias;
 
-struct PointLight {
-    vec4 position;
-    vec4 rgbcolor_and_intensity;
-};
-
-layout(std140) uniform pointlights {
-    PointLight PointLights[POINTLIGHTS];
-};
+#ifdef LIGHT_VOLUME
+// The light whose volume is being drawn.
+uniform int light_index;
+#endif // LIGHT_VOLUME
 
 #endif // GBUFFER
 
-#ifdef BLOOM
-// Blur used with bloom.
-vec3 blur(vec2 pixel_size)
+#if defined BLOOM_DOWNSAMPLE || defined BLOOM_UPSAMPLE
+#define BLOOM_PASS
+
+// Texel size of the level being read from texture0.
+uniform vec2 source_pixel_size;
+
+#ifdef BLOOM_THRESHOLD
+// Brightness below which nothing blooms.
+uniform float bloom_threshold;
+#endif // BLOOM_THRESHOLD
+
+// 13 tap downsample: a box of four bilinear taps in the middle and four
+// overlapping boxes around it, weighted to avoid flickering of small
+// bright features.
+vec3 downsample(vec2 texcoord)
 {
-    float pi = 3.14;
-    float sigma = 10.0;
+    const vec2 offsets[13] = vec2[13](
+        vec2(-2.0, -2.0), vec2(0.0, -2.0), vec2(2.0, -2.0),
+        vec2(-1.0, -1.0), vec2(1.0, -1.0),
+        vec2(-2.0,  0.0), vec2(0.0,  0.0), vec2(2.0,  0.0),
+        vec2(-1.0,  1.0), vec2(1.0,  1.0),
+        vec2(-2.0,  2.0), vec2(0.0,  2.0), vec2(2.0,  2.0));
+    const float weights[13] = float[13](
+        0.03125, 0.0625, 0.03125,
+        0.125, 0.125,
+        0.0625, 0.125, 0.0625,
+        0.125, 0.125,
+        0.03125, 0.0625, 0.03125);
+
     vec3 color = vec3(0.0, 0.0, 0.0);
-    int w = 7;
-    for(int i = 0; i < w; i++) {
-        #ifdef PBUFFER
-        vec2 coord = vec2(i, 0.0);
-        #endif // PBUFFER
-        #ifdef POSTPROC
-        vec2 coord = vec2(0.0, i);
-        #endif // POSTPROC
-        vec3 t_pos = texture(texture1, frag_texcoord + coord * pixel_size).rgb;
-        vec3 t_neg = texture(texture1, frag_texcoord - coord * pixel_size).rgb;
-        color += (t_pos + t_neg) *
-            (exp(-(i*i)/(2*sigma*sigma)) - exp(-(w*w)/(2*sigma*sigma)));
+    for (int i = 0; i < 13; i++) {
+        color += texture_scaled(texture0, texcoord + offsets[i] * source_pixel_size).rgb *
+                 weights[i];
     }
     return color;
 }
+
+// 3x3 tent filter, the smaller level is blurred as it is enlarged.
+vec3 upsample(vec2 texcoord)
+{
+    const float weights[3] = float[3](0.25, 0.5, 0.25);
+
+    vec3 color = vec3(0.0, 0.0, 0.0);
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            color += texture_scaled(texture0, texcoord + vec2(x, y) * source_pixel_size).rgb *
+                     weights[x + 1] * weights[y + 1];
+        }
+    }
+    return color;
+}
+#endif // BLOOM_DOWNSAMPLE || BLOOM_UPSAMPLE
+
+#ifdef POSTPROC
+#ifdef BLOOM
+// Largest level of the bloom chain and its weight in the composite.
+uniform sampler2D bloom;
+uniform float bloom_intensity;
+// render_texcoord_max of the level.
+uniform vec2 bloom_texcoord_max;
 #endif // BLOOM
+#endif // POSTPROC
 
 #ifdef PBUFFER
 layout(location = OUTP_DIFFUSE) out vec4 out_diffuse;
 layout(location = OUTP_SPECULAR) out vec4 out_specular;
+#endif // PBUFFER
 
+#if defined PBUFFER || (defined POSTPROC && defined ANTIALIAS)
 // Antialiasing using the edge detection factor.
 vec3 antialias(vec2 pixel_size,
                float factor)
@@ -100,29 +213,26 @@ vec3 antialias(vec2 pixel_size,
 
     vec3 color = vec3(0.0, 0.0, 0.0);
     for(int i = 0; i < 8; i++) {
-        color += texture(texture0,
-                         frag_texcoord + delta[i] * pixel_size * factor).rgb;
+        color += texture_scaled(texture0,
+                                frag_texcoord + delta[i] * pixel_size * factor).rgb;
     }
-    color += texture(texture0, frag_texcoord).rgb;
+    color += texture_scaled(texture0, frag_texcoord).rgb;
     color *= 1.0/9.0; // 8 + 1 terms.
     return color;
 }
+#endif // PBUFFER || (POSTPROC && ANTIALIAS)
 
-#endif // PBUFFER
-
-#ifndef PBUFFER
+#if !defined PBUFFER && !defined BLOOM_PASS && !defined DEPTH_ONLY
 layout(location = OUTG_DIFFUSE) out vec4 out_diffuse;
 layout(location = OUTG_SPECULAR) out vec4 out_specular;
 layout(location = OUTG_NORMAL) out vec4 out_normal;
-layout(location = OUTG_POSITION) out vec4 out_position;
-layout(location = OUTG_EXTRA) out vec4 out_extra;
 layout(location = OUTP_EDGES) out vec4 out_edges;
 layout(location = OUTP_BLOOM) out vec4 out_bloom;
 #endif // GBUFFER
 
-#ifdef POSTPROC
+#if defined POSTPROC || defined BLOOM_PASS
 layout(location = 0) out vec4 out_color;
-#endif // POSTPROC
+#endif // POSTPROC || BLOOM_PASS
 
 
 void main(void)
@@ -132,37 +242,74 @@ void main(void)
     
     #ifdef GBUFFER
     {
-        vec4 normal = texture(texture2, frag_texcoord);
-        vec3 diffuse = texture(texture0, frag_texcoord).rgb;
-        vec3 specular = texture(texture1, frag_texcoord).rgb;
-        vec3 position = texture(texture3, frag_texcoord).xyz;
-        vec3 extra = texture(texture4, frag_texcoord).xyz;
-        float shininess = extra.g * shin_encoder;
-        float is_lightsource = extra.r;
-        float is_skybox = extra.b;
+        #ifdef LIGHT_VOLUME
+        // Volumes cover any part of the screen, read the pixel under them.
+        vec2 texcoord = gl_FragCoord.xy * pixel_size;
+        #else
+        vec2 texcoord = frag_texcoord;
+        #endif // LIGHT_VOLUME
+        vec3 normal = decode_normal(texture_scaled(texture2, texcoord).rg);
+        vec3 diffuse = texture_scaled(texture0, texcoord).rgb;
+        vec4 specular_and_extra = texture_scaled(texture1, texcoord);
+        vec3 specular = specular_and_extra.rgb;
+        vec3 position = reconstruct_position(texcoord);
+        float shininess;
+        uint flags;
+        unpack_extra(specular_and_extra.a, shininess, flags);
+        shininess *= shin_encoder;
+        float is_lightsource = (flags & EXTRA_LIT) != 0u ? 1.0 : 0.0;
+        float is_skybox = (flags & EXTRA_NOT_SKYBOX) != 0u ? 1.0 : 0.0;
 
         vec3 to_viewer = viewer_position - position.xyz;
 
         vec3 diffuse_temp = vec3(0.0, 0.0, 0.0);
         vec3 specular_temp = vec3(0.0, 0.0, 0.0);
 
-        for (int i = 0; i < num_pointlights; i++) {
-            vec3 lightpos = PointLights[i].position.xyz;
-            vec3 color = PointLights[i].rgbcolor_and_intensity.rgb;
-            float intensity = PointLights[i].rgbcolor_and_intensity.a;
+        #ifdef LIGHT_VOLUME
+        uvec2 light_range = uvec2(0u, 1u);
+        #else
+        // Find the pixel's cluster.
+        float view_depth = max(-(view * vec4(position, 1.0)).z, 1e-4);
+        ivec3 cluster = ivec3(
+            gl_FragCoord.xy / (vec2(display_width, display_height) * render_scale) *
+                vec2(cluster_size.xy),
+            int(log(view_depth) * cluster_slice_scale + cluster_slice_bias));
+        cluster = clamp(cluster, ivec3(0), cluster_size - 1);
+        int cluster_index = (cluster.z * cluster_size.y + cluster.y) * cluster_size.x + cluster.x;
+        uvec2 light_range = texelFetch(light_clusters, cluster_index).rg;
+        #endif // LIGHT_VOLUME
+
+        for (uint i = 0u; i < light_range.y; i++) {
+            #ifdef LIGHT_VOLUME
+            int light = light_index;
+            #else
+            int light = int(texelFetch(light_indices, int(light_range.x + i)).r);
+            #endif // LIGHT_VOLUME
+            vec4 position_and_radius = texelFetch(light_data, 2 * light);
+            vec4 color_and_intensity = texelFetch(light_data, 2 * light + 1);
+            vec3 lightpos = position_and_radius.xyz;
+            float radius = position_and_radius.w;
+            vec3 color = color_and_intensity.rgb;
+            float intensity = color_and_intensity.a;
             vec3 to_light = lightpos - position.xyz;
             color *= intensity;
             float distance = length(to_light);
-            color /= distance * distance;
+            // Inverse square falloff windowed to reach zero at the radius.
+            float window = clamp(1.0 - pow(distance / radius, 4.0), 0.0, 1.0);
+            color *= window * window / (distance * distance);
             vec3 half_vector = to_viewer + to_light;
-            float norm_dot_half = clamp(dot(normal.xyz, normalize(half_vector)), 0.0, 1.0);
-            float cos_theta = clamp(dot(normalize(normal.xyz), normalize(to_light)), 0.0, 1.0);
+            float norm_dot_half = clamp(dot(normal, normalize(half_vector)), 0.0, 1.0);
+            float cos_theta = clamp(dot(normal, normalize(to_light)), 0.0, 1.0);
             diffuse_temp += diffuse * color * cos_theta;
             specular_temp += max(specular * color * pow(norm_dot_half, is_lightsource * shininess), 0.0);
         }
         out_diffuse = vec4(diffuse_temp * is_lightsource, 1.0);
         if (is_skybox <= 0.1) {
+            #ifdef LIGHT_VOLUME
+            out_diffuse = vec4(0.0); // Added once by the fullscreen pass.
+            #else
             out_diffuse = vec4(diffuse, 1.0);
+            #endif // LIGHT_VOLUME
         }
         out_specular = vec4(specular_temp, 1.0);
         #ifdef ANTIALIAS
@@ -174,36 +321,65 @@ void main(void)
 
     #ifdef PBUFFER
     {
-        #ifdef BLOOM
-        out_specular = vec4(blur(pixel_size), 1.0);
-        #else
-        out_specular = texture(texture1, frag_texcoord);
-        #endif // BLOOM
-        float factor = texture(texture2, frag_texcoord).r;
+        out_specular = texture_scaled(texture1, frag_texcoord);
+        float factor = texture_scaled(texture2, frag_texcoord).r;
         out_diffuse =
             #ifdef ANTIALIAS
             vec4(antialias(pixel_size, factor), 1.0);
             #else
-            texture(texture0, frag_texcoord);
+            texture_scaled(texture0, frag_texcoord);
             #endif // ANTIALIAS
     }
     #endif // PBUFFER
 
     #ifdef POSTPROC
     {
-        vec3 diffuse = texture(texture0, frag_texcoord).rgb;
+        #ifdef ANTIALIAS
+        // Fused with the antialiasing, the edges are in texture2.
+        vec3 diffuse = antialias(pixel_size, texture_scaled(texture2, frag_texcoord).r);
+        #else
+        vec3 diffuse = texture_scaled(texture0, frag_texcoord).rgb;
+        #endif // ANTIALIAS
         #ifdef BLOOM
-        vec3 specular = blur(pixel_size);
+        vec3 specular = texture(bloom, min(frag_texcoord, bloom_texcoord_max)).rgb *
+                        bloom_intensity;
         #else
-        vec3 specular = texture(texture1, frag_texcoord).rgb;
+        vec3 specular = texture_scaled(texture1, frag_texcoord).rgb;
         #endif // BLOOM
         out_color = vec4(diffuse + specular, 1.0);
     }
     #endif // POSTPROC
     
+    #ifdef BLOOM_DOWNSAMPLE
+    {
+        vec3 color = downsample(frag_texcoord);
+        #ifdef BLOOM_THRESHOLD
+        float brightness = max(color.r, max(color.g, color.b));
+        color *= max(brightness - bloom_threshold, 0.0) / max(brightness, 1e-4);
+        #endif // BLOOM_THRESHOLD
+        out_color = vec4(color, 1.0);
+    }
+    #endif // BLOOM_DOWNSAMPLE
+
+    #ifdef BLOOM_UPSAMPLE
+    {
+        out_color = vec4(upsample(frag_texcoord), 1.0);
+    }
+    #endif // BLOOM_UPSAMPLE
+
+    #if defined DEPTH_ONLY && defined ALBEDO_TEX
+    // Discards the texels the G-buffer pass does, which only draws where the
+    // depth written here passes.
+    if (texture(texture0, frag_texcoord).a <= 0.1) {
+        discard;
+    }
+    #endif // DEPTH_ONLY && ALBEDO_TEX
+
     #ifndef GBUFFER
     #ifndef PBUFFER
     #ifndef POSTPROC
+    #ifndef BLOOM_PASS
+    #ifndef DEPTH_ONLY
     {
         vec4 diffuse;
         float alpha = 1.0;
@@ -211,25 +387,30 @@ void main(void)
         diffuse = texture(texture0, frag_texcoord);
         alpha = diffuse.a;
         #endif ALBEDO_TEX
-        if (alpha > 0.1) {
-            #ifndef ALBEDO_TEX
-            diffuse = frag_diffuse;
-            #endif // not ALBEDO_TEX
-            out_diffuse = diffuse;
-            out_specular = vec4(frag_specular);
-            out_normal = vec4(normalize(frag_normal), 1.0);
-            out_position = vec4(frag_worldspace_pos, 1.0);
-            out_extra = vec4(1.0, frag_shininess / shin_encoder, 1.0, 1.0);
-
-            #ifdef LIGHTSOURCE
-            out_extra.r = 0.0;
-            #endif // LIGHTSOURCE
-
-            #ifdef SKYBOX
-            out_extra.b = 0.0;
-            #endif // SKYBOX
+        // Don't write to the G-buffer or the depth for transparent texels.
+        if (alpha <= 0.1) {
+            discard;
         }
+        #ifndef ALBEDO_TEX
+        diffuse = frag_diffuse;
+        #endif // not ALBEDO_TEX
+        uint flags = EXTRA_LIT | EXTRA_NOT_SKYBOX;
+
+        #ifdef LIGHTSOURCE
+        flags &= ~EXTRA_LIT;
+        #endif // LIGHTSOURCE
+
+        #ifdef SKYBOX
+        flags &= ~EXTRA_NOT_SKYBOX;
+        #endif // SKYBOX
+
+        out_diffuse = diffuse;
+        out_specular = vec4(frag_specular.rgb,
+                            pack_extra(frag_shininess / shin_encoder, flags));
+        out_normal = vec4(encode_normal(normalize(frag_normal)), 0.0, 1.0);
     }
+    #endif // not DEPTH_ONLY
+    #endif // not BLOOM_PASS
     #endif // not POSTPROC
     #endif // not PBUFFER
     #endif // not GBUFFER
@@ -6,13 +6,19 @@ layout (location = POSITION) in vec4 in_position;
 layout (location = NORMAL) in vec4 in_normal;
 layout (location = TEXCOORD) in vec2 in_texcoord;
 layout (location = MATERIAL_IDX) in unsigned int in_material_idx;
+// Per instance transforms, one matrix per instance.
+layout (location = INSTANCE_MODEL) in mat4 in_model;
+layout (location = INSTANCE_NORMALMATRIX) in mat4 in_normalmatrix;
 
-uniform mat4 model;
-uniform mat4 normalmatrix;
-uniform mat4 mvp;
+uniform mat4 viewprojection;
 uniform float near_z;
 uniform float far_z;
 uniform vec3 viewer_position;
+// Fraction of the render targets the scene was rendered to.
+uniform float render_scale;
+
+// The depth pre-pass and the G-buffer pass must agree on depth exactly.
+invariant gl_Position;
 
 #endif // POSITION
 
@@ -85,6 +91,8 @@ struct Material {
     float shininess;
 };
 
+// Materials of every model, deduplicated, see MaterialRegistry. MATERIALS is
+// its capacity, the same for every program.
 layout(std140) uniform materials {
     Material Materials[MATERIALS];
 };
@@ -93,7 +101,8 @@ layout(std140) uniform materials {
 
 void main(void)
 {
-    mat4 mvp = mvp; 
+    mat4 model = in_model;
+    mat4 mvp = viewprojection * model;
 
     #ifdef SKYBOX
     mvp[3] = vec4(0.0, 0.0, -2.0 * far_z * near_z / (far_z - near_z), 0.0);
@@ -124,12 +133,23 @@ void main(void)
     #ifdef ORTHO
     gl_Position = in_position;
     #endif // ORTHO
-    frag_normal = (normalmatrix * in_normal).xyz;
+
+    #if !defined DEPTH_ONLY || defined ALBEDO_TEX
+    // Alpha tested depth-only variants read the albedo too.
     frag_texcoord = in_texcoord;
+    #ifdef ORTHO
+    // Fullscreen passes read the part of their inputs that was rendered to.
+    frag_texcoord *= render_scale;
+    #endif // ORTHO
+    #endif // not DEPTH_ONLY || ALBEDO_TEX
+
+    #ifndef DEPTH_ONLY
+    frag_normal = (in_normalmatrix * in_normal).xyz;
     frag_worldspace_pos = (model * in_position).xyz;
     #ifdef MATERIALS
     frag_diffuse = Materials[in_material_idx].diffuse;
     frag_specular = Materials[in_material_idx].specular;
     frag_shininess = Materials[in_material_idx].shininess;
     #endif // MATERIALS
+    #endif // not DEPTH_ONLY
 }
@@ -0,0 +1,16 @@
+#include "json.h"
+
+void util::writeJsonString(ostream& out, const char* text)
+{
+    out << '"';
+    for (const char* c = text; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            out << '\\' << *c;
+        } else if ((unsigned char) *c < 0x20) {
+            out << ' ';
+        } else {
+            out << *c;
+        }
+    }
+    out << '"';
+}
@@ -0,0 +1,21 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <ostream>
+
+using namespace std;
+
+namespace util {
+
+/**
+ * @brief Writes a string as a quoted JSON string, escaping quotes and
+ * backslashes. Control characters are written as spaces.
+ *
+ * @param out Stream to write to.
+ * @param text ditto.
+ **/
+void writeJsonString(ostream& out, const char* text);
+
+}
+
+#endif // JSON_H
@@ -22,6 +22,7 @@ ObjFile::ObjFile(const std::string& path)
         m_num_triangles(0),
         m_num_materials(0)
 {
+    PROFILE_ZONE("ObjFile::ObjFile");
     ifstream file(path.c_str());
 
     assert(file.is_open());
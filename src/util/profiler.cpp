@@ -0,0 +1,302 @@
+#include "profiler.h"
+#include "json.h"
+#include "logger.h"
+
+#include <fstream>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#define THREAD_LOCAL __declspec(thread)
+#else
+#include <time.h>
+#define THREAD_LOCAL __thread
+#endif
+
+using namespace util;
+
+#ifdef _WIN32
+typedef unsigned __int64 Ticks;
+#else
+typedef unsigned long long Ticks;
+#endif
+
+const unsigned int Profiler::MAX_ZONES;
+/// Deepest nesting of zones.
+const unsigned int MAX_DEPTH = 64;
+
+struct Zone {
+    const char* name;
+    Ticks begin;
+    Ticks end;
+};
+
+struct ThreadBuffer {
+    /// Ring of the newest zones, zone i is at i % MAX_ZONES.
+    Zone zones[Profiler::MAX_ZONES];
+    /// Zones written so far, including the overwritten ones. Only increased
+    /// after the zone is complete.
+    volatile unsigned int num_zones;
+    /// Zones nested too deep to be recorded.
+    unsigned int num_dropped;
+
+    /// Names and start times of the zones still open.
+    const char* open_names[MAX_DEPTH];
+    Ticks open_begins[MAX_DEPTH];
+    unsigned int depth;
+
+    const char* name;
+    /// Thread id in the trace.
+    unsigned int id;
+    /// Whether a thread is recording into the buffer.
+    volatile long in_use;
+    /// Next buffer in the list of all buffers.
+    ThreadBuffer* next;
+};
+
+/// All buffers ever created, newest first. Only ever pushed to.
+static ThreadBuffer* volatile g_buffers = 0;
+static volatile long g_num_buffers = 0;
+static THREAD_LOCAL ThreadBuffer* t_buffer = 0;
+
+#ifdef _WIN32
+static bool compareAndSwap(volatile long* value, long expected, long desired)
+{
+    return InterlockedCompareExchange(value, desired, expected) == expected;
+}
+
+static bool compareAndSwap(ThreadBuffer* volatile* value,
+                           ThreadBuffer* expected, ThreadBuffer* desired)
+{
+    return InterlockedCompareExchangePointer((PVOID volatile*) value,
+                                             desired, expected) == expected;
+}
+
+static long increment(volatile long* value)
+{
+    return InterlockedIncrement(value);
+}
+
+static void memoryBarrier()
+{
+    MemoryBarrier();
+}
+
+static Ticks now()
+{
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart;
+}
+
+static double ticksPerMicrosecond()
+{
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return frequency.QuadPart / 1e6;
+}
+#else
+static bool compareAndSwap(volatile long* value, long expected, long desired)
+{
+    return __sync_bool_compare_and_swap(value, expected, desired);
+}
+
+static bool compareAndSwap(ThreadBuffer* volatile* value,
+                           ThreadBuffer* expected, ThreadBuffer* desired)
+{
+    return __sync_bool_compare_and_swap(value, expected, desired);
+}
+
+static long increment(volatile long* value)
+{
+    return __sync_add_and_fetch(value, 1);
+}
+
+static void memoryBarrier()
+{
+    __sync_synchronize();
+}
+
+static Ticks now()
+{
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (Ticks) time.tv_sec * 1000000000ull + time.tv_nsec;
+}
+
+static double ticksPerMicrosecond()
+{
+    return 1e3;
+}
+#endif // _WIN32
+
+/// Claims a released buffer, or creates one if there is none.
+static ThreadBuffer* claimBuffer()
+{
+    for (ThreadBuffer* buffer = g_buffers; buffer; buffer = buffer->next) {
+        if (compareAndSwap(&buffer->in_use, 0, 1)) {
+            buffer->depth = 0;
+            return buffer;
+        }
+    }
+
+    ThreadBuffer* buffer = new ThreadBuffer();
+    buffer->num_zones = 0;
+    buffer->num_dropped = 0;
+    buffer->depth = 0;
+    buffer->name = 0;
+    buffer->id = increment(&g_num_buffers);
+    buffer->in_use = 1;
+    do {
+        buffer->next = g_buffers;
+    } while (!compareAndSwap(&g_buffers, buffer->next, buffer));
+    return buffer;
+}
+
+/// Index of the oldest zone still kept in the buffer.
+static unsigned int firstKeptZone(const unsigned int num_zones)
+{
+    return num_zones > Profiler::MAX_ZONES ? num_zones - Profiler::MAX_ZONES : 0;
+}
+
+static ThreadBuffer* threadBuffer()
+{
+    if (!t_buffer) {
+        t_buffer = claimBuffer();
+    }
+    return t_buffer;
+}
+
+void Profiler::setThreadName(const char* name)
+{
+    threadBuffer()->name = name;
+}
+
+void Profiler::beginZone(const char* name)
+{
+    ThreadBuffer* buffer = threadBuffer();
+    if (buffer->depth < MAX_DEPTH) {
+        buffer->open_names[buffer->depth] = name;
+        buffer->open_begins[buffer->depth] = now();
+    }
+    buffer->depth++;
+}
+
+void Profiler::endZone()
+{
+    Ticks end = now();
+    ThreadBuffer* buffer = threadBuffer();
+    if (buffer->depth == 0) {
+        return;
+    }
+    buffer->depth--;
+    if (buffer->depth >= MAX_DEPTH) {
+        buffer->num_dropped++;
+        return;
+    }
+    Zone& zone = buffer->zones[buffer->num_zones % MAX_ZONES];
+    zone.name = buffer->open_names[buffer->depth];
+    zone.begin = buffer->open_begins[buffer->depth];
+    zone.end = end;
+    // The zone must be complete before it is counted.
+    memoryBarrier();
+    buffer->num_zones++;
+}
+
+void Profiler::releaseThread()
+{
+    if (!t_buffer) {
+        return;
+    }
+    ThreadBuffer* buffer = t_buffer;
+    t_buffer = 0;
+    memoryBarrier();
+    buffer->in_use = 0;
+}
+
+bool Profiler::exportChromeTrace(const string& path)
+{
+    ofstream file(path.c_str());
+    if (!file) {
+        return false;
+    }
+
+    // Timestamps relative to the earliest zone, in microseconds.
+    Ticks origin = 0;
+    bool has_origin = false;
+    for (ThreadBuffer* buffer = g_buffers; buffer; buffer = buffer->next) {
+        // Zones are stored as they end, an outer zone begins before the
+        // zones stored ahead of it.
+        const unsigned int num_zones = buffer->num_zones;
+        for (unsigned int i = firstKeptZone(num_zones); i < num_zones; i++) {
+            const Zone& zone = buffer->zones[i % MAX_ZONES];
+            if (!has_origin || zone.begin < origin) {
+                origin = zone.begin;
+                has_origin = true;
+            }
+        }
+    }
+    const double ticks_per_us = ticksPerMicrosecond();
+
+    file << "{\"traceEvents\":[";
+    bool first = true;
+    file.precision(3);
+    file << fixed;
+    for (ThreadBuffer* buffer = g_buffers; buffer; buffer = buffer->next) {
+        memoryBarrier();
+        const unsigned int num_zones = buffer->num_zones;
+
+        if (buffer->name) {
+            file << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\","
+                 << "\"pid\":1,\"tid\":" << buffer->id << ",\"args\":{\"name\":";
+            writeJsonString(file, buffer->name);
+            file << "}}";
+            first = false;
+        }
+
+        for (unsigned int i = firstKeptZone(num_zones); i < num_zones; i++) {
+            const Zone zone = buffer->zones[i % MAX_ZONES];
+            // Skip the zone if the thread has come round to overwriting it
+            // while it was copied.
+            memoryBarrier();
+            if (buffer->num_zones - i >= MAX_ZONES) {
+                continue;
+            }
+            file << (first ? "" : ",") << "\n{\"name\":";
+            writeJsonString(file, zone.name);
+            file << ",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id
+                 << ",\"ts\":" << (zone.begin - origin) / ticks_per_us
+                 << ",\"dur\":" << (zone.end - zone.begin) / ticks_per_us << "}";
+            first = false;
+        }
+
+        if (num_zones > MAX_ZONES) {
+            LOG(logWARNING) << num_zones - MAX_ZONES << " oldest zones of thread "
+                            << buffer->id << " overwritten, buffer full.";
+        }
+        if (buffer->num_dropped > 0) {
+            LOG(logWARNING) << buffer->num_dropped << " zones of thread "
+                            << buffer->id << " dropped, nested too deep.";
+        }
+    }
+    file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return file.good();
+}
+
+void Profiler::clear()
+{
+    for (ThreadBuffer* buffer = g_buffers; buffer; buffer = buffer->next) {
+        buffer->num_zones = 0;
+        buffer->num_dropped = 0;
+    }
+}
+
+unsigned int Profiler::getNumZones()
+{
+    unsigned int num_zones = 0;
+    for (ThreadBuffer* buffer = g_buffers; buffer; buffer = buffer->next) {
+        const unsigned int buffer_zones = buffer->num_zones;
+        num_zones += buffer_zones - firstKeptZone(buffer_zones);
+    }
+    return num_zones;
+}
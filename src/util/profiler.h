@@ -0,0 +1,122 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <string>
+
+using namespace std;
+
+namespace util {
+
+/**
+ * @brief Records nested CPU timing zones for viewing as flame charts.
+ *
+ * Every thread records into its own fixed size ring buffer without locking,
+ * so zones are cheap enough to leave around frame work. Once a thread's
+ * buffer is full its newest zones overwrite its oldest ones. Best used with the
+ * PROFILE_ZONE(name) and PROFILE_THREAD(name) macros, which compile to nothing
+ * unless ENABLE_PROFILING is defined.
+ *
+ * Example:
+ * @code
+ * #include "profiler.h"
+ * void update()
+ * {
+ *     PROFILE_ZONE("update");
+ *     ...
+ * }
+ * @endcode
+ *
+ * The recorded zones are exported as Chrome trace JSON, which can be opened
+ * in chrome://tracing or Perfetto.
+ **/
+class Profiler
+{
+public:
+    /// Zones kept for each thread.
+    static const unsigned int MAX_ZONES = 1 << 16;
+
+    /**
+     * @brief Names the calling thread in the exported trace.
+     *
+     * @param name String literal or otherwise outliving the profiler.
+     **/
+    static void setThreadName(const char* name);
+
+    /**
+     * @brief Starts a zone on the calling thread, nested in the zone started
+     * before it. Use of macro PROFILE_ZONE(name) recommended.
+     *
+     * @param name String literal or otherwise outliving the profiler.
+     **/
+    static void beginZone(const char* name);
+
+    /**
+     * @brief Ends the zone started last on the calling thread.
+     **/
+    static void endZone();
+
+    /**
+     * @brief Hands the calling thread's buffer to the next thread that
+     * records, keeping its zones. Called by short lived threads so that
+     * recreating them doesn't allocate new buffers.
+     **/
+    static void releaseThread();
+
+    /**
+     * @brief Writes every zone kept so far as Chrome trace JSON.
+     *
+     * Zones ended while exporting may be left out, as may the oldest zones
+     * they overwrite.
+     *
+     * @param path File to write.
+     * @return Whether the file could be written.
+     **/
+    static bool exportChromeTrace(const string& path);
+
+    /**
+     * @brief Drops all recorded zones. No thread may be recording.
+     **/
+    static void clear();
+
+    /**
+     * @return Number of zones kept for all threads.
+     **/
+    static unsigned int getNumZones();
+};
+
+/**
+ * @brief Zone lasting until the end of the scope.
+ **/
+class ProfileZone
+{
+public:
+    explicit ProfileZone(const char* name) { Profiler::beginZone(name); }
+    ~ProfileZone() { Profiler::endZone(); }
+};
+
+/**
+ * @brief Names the thread and releases its buffer at the end of the scope.
+ **/
+class ProfileThread
+{
+public:
+    explicit ProfileThread(const char* name) { Profiler::setThreadName(name); }
+    ~ProfileThread() { Profiler::releaseThread(); }
+};
+
+}
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+
+#ifdef ENABLE_PROFILING
+#define PROFILE_ZONE(name) \
+util::ProfileZone PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+#define PROFILE_THREAD(name) \
+util::ProfileThread PROFILE_CONCAT(profile_thread_, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_THREAD(name)
+#endif // ENABLE_PROFILING
+
+#endif // PROFILER_H
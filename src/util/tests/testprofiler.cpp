@@ -0,0 +1,84 @@
+#include <UnitTest++.h>
+
+#include <fstream>
+#include <sstream>
+#include <SFML/System.hpp>
+
+#include "../profiler.h"
+
+using namespace util;
+
+static string readFile(const string& path)
+{
+    ifstream file(path.c_str());
+    stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+static void recordWorkerZones(int* num_zones)
+{
+    ProfileThread thread("Worker");
+    for (int i = 0; i < *num_zones; i++) {
+        ProfileZone zone("Worker zone");
+    }
+}
+
+TEST(TestProfilerNestedZones)
+{
+    Profiler::clear();
+    Profiler::setThreadName("Main");
+    {
+        ProfileZone outer("Outer \"zone\"");
+        for (int i = 0; i < 3; i++) {
+            ProfileZone inner("Inner");
+        }
+    }
+    CHECK_EQUAL(4u, Profiler::getNumZones());
+
+    CHECK(Profiler::exportChromeTrace("testprofiler.json"));
+    string trace = readFile("testprofiler.json");
+    CHECK(trace.find("\"traceEvents\"") != string::npos);
+    CHECK(trace.find("\"name\":\"Outer \\\"zone\\\"\"") != string::npos);
+    CHECK(trace.find("\"name\":\"Inner\"") != string::npos);
+    CHECK(trace.find("\"args\":{\"name\":\"Main\"}") != string::npos);
+}
+
+TEST(TestProfilerThreadsReuseBuffers)
+{
+    Profiler::clear();
+    int num_zones = 5;
+    for (int i = 0; i < 3; i++) {
+        sf::Thread thread(&recordWorkerZones, &num_zones);
+        thread.launch();
+        thread.wait();
+    }
+    CHECK_EQUAL(15u, Profiler::getNumZones());
+
+    CHECK(Profiler::exportChromeTrace("testprofiler.json"));
+    string trace = readFile("testprofiler.json");
+    // All three threads recorded into the same released buffer.
+    size_t first = trace.find("\"args\":{\"name\":\"Worker\"}");
+    CHECK(first != string::npos);
+    CHECK(trace.find("\"args\":{\"name\":\"Worker\"}", first + 1) == string::npos);
+}
+
+TEST(TestProfilerKeepsNewestZones)
+{
+    Profiler::clear();
+    {
+        ProfileZone oldest("Oldest");
+    }
+    for (unsigned int i = 0; i < Profiler::MAX_ZONES; i++) {
+        ProfileZone zone("Zone");
+    }
+    {
+        ProfileZone newest("Newest");
+    }
+    CHECK_EQUAL(Profiler::MAX_ZONES, Profiler::getNumZones());
+
+    CHECK(Profiler::exportChromeTrace("testprofiler.json"));
+    string trace = readFile("testprofiler.json");
+    CHECK(trace.find("\"name\":\"Oldest\"") == string::npos);
+    CHECK(trace.find("\"name\":\"Newest\"") != string::npos);
+}